@@ -24,7 +24,13 @@
 int
 main (int argc, char **argv) {
 	int retval = 0;
-	MassifgApplication *app = massifg_application_new(&argc, &argv);
+	MassifgApplication *app = NULL;
+
+	/* Analysis functions use a thread pool */
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+
+	app = massifg_application_new(&argc, &argv);
 	retval = massifg_application_run(app);
 	massifg_application_free(app);
 	return retval;
@@ -0,0 +1,1040 @@
+/*
+ *  MassifG - massifg_analysis.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_analysis
+ * @short_description: Analysis passes over parsed massif output
+ * @title: MassifG Analysis
+ * @stability: Unstable
+ *
+ * Functions that answer questions about a #MassifgOutputData as a whole,
+ * instead of visualizing it.
+ *
+ * massifg_analysis_find_leaks() looks for call sites whose memory usage
+ * grows steadily over the run. It does a single sweep over the heap trees of
+ * all the detailed snapshots, and fits a straight line to the memory usage of
+ * each call site over time using running sums, so memory usage only depends
+ * on the number of distinct call sites.
+ *
+ * massifg_analysis_build_inverted_trees() merges every occurrence of a frame in
+ * the heap trees, so that frames reached from many callers can be examined
+ * as a whole. Each distinct label is mapped to the id of its frame once, before
+ * the heap trees are walked, so the nodes are merged by integer id without
+ * looking at their labels. The snapshots are split between the threads of a
+ * #GThreadPool, each of which builds the trees for its snapshots and a partially
+ * merged tree, and the partial trees are merged when all threads are done.
+ *
+ * massifg_analysis_group_usage() sums the heap usage of the allocation sites
+ * by function, shared object, source file or namespace. Each label is mapped
+ * to its group once, using the #MassifgLabelFields it was split into, and the
+ * snapshots are then summed into one column of values per group in a single pass.
+ * When the data has a union tree, see #MassifgUnionTree, the columns of the
+ * allocation sites are summed directly instead.
+ *
+ * massifg_analysis_compare_peaks() compares the allocation functions at the peaks
+ * of two outputs parsed into the same #MassifgLabelTable, see massifg_parse_files().
+ * Functions are matched by the id of their name and shared object rather than
+ * by label, since code addresses usually differ between two builds.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "massifg_analysis.h"
+#include "massifg_parser.h"
+#include "massifg_trace.h"
+
+/* Private data structures */
+
+/* Running sums for the least squares fit of a single call site.
+ * The sums over x are the same for all sites, and are kept in LeakSweep */
+typedef struct {
+	const gchar *label;
+
+	gdouble sum_y;
+	gdouble sum_xy;
+	gdouble sum_yy;
+
+	gint64 current_mem_B; /* Memory usage in the snapshot being swept */
+	gint64 peak_mem_B;
+	gint last_snapshot; /* The last snapshot this site appeared in */
+	gint active; /* How many times this site is on the path to the current node */
+} LeakSiteSums;
+
+typedef struct {
+	MassifgLabelTable *labels;
+	GHashTable *sites; /* Label id -> LeakSiteSums */
+	GPtrArray *touched; /* Sites that appear in the current snapshot */
+	gint snapshot;
+
+	gdouble n;
+	gdouble sum_x;
+	gdouble sum_xx;
+} LeakSweep;
+
+/* The frames of the labels, shared by the threads building inverted trees.
+ * The id of a frame is the id of the first label with that frame */
+typedef struct {
+	guint num_labels;
+	guint *ids; /* Label id -> frame id, or MASSIFG_LABEL_NONE if the label is not a call site */
+	const gchar **names; /* Frame id -> frame */
+} InvertedFrames;
+
+/* The snapshots one thread builds inverted trees for */
+typedef struct {
+	MassifgInvertedTrees *trees;
+	MassifgOutputData *data;
+	const InvertedFrames *frames;
+	GList *snapshots; /* The first snapshot of this part */
+	guint first_index;
+	guint num_snapshots;
+
+	guint *active; /* Frame id -> times the frame is on the path to the current node */
+	MassifgInvertedNode *partial; /* Merged tree of this part */
+} InvertedTreesPart;
+
+/* A group in massifg_analysis_group_usage() */
+typedef struct {
+	gchar *name;
+	gdouble *values;
+	guint num_present; /* Number of snapshots the group appears in */
+	guint last_snapshot; /* The last snapshot the group appeared in, plus one */
+	guint order; /* Order of creation, to keep the sort stable */
+	GSList *union_nodes; /* Children of the root of the union tree in the group, newest first */
+} UsageGroup;
+
+/* The groups being built by massifg_analysis_group_usage() */
+typedef struct {
+	MassifgLabelTable *labels;
+	MassifgGroupBy group_by;
+	guint num_snapshots;
+
+	UsageGroup **label_groups; /* Label id -> group, once the label has been seen */
+	GHashTable *groups_by_name;
+	GPtrArray *groups; /* In order of creation */
+} UsageGroups;
+
+/* A MassifgFunctionDelta with the key it is stored under in massifg_analysis_compare_peaks() */
+typedef struct {
+	MassifgFunctionDelta delta; /* Must be first, it is freed as a MassifgFunctionDelta */
+	guint64 key;
+} FunctionDeltaEntry;
+
+/* Default number of threads for massifg_analysis_build_inverted_trees() */
+static const guint INVERTED_TREES_DEFAULT_THREADS = 4;
+
+/* Private functions */
+
+/* Nodes that massif uses to summarize allocations below its threshold
+ * have labels like "in 266 places, all below massif's threshold (01.00%)",
+ * which do not identify a call site. Such labels are not split into a function */
+static gboolean
+is_call_site(MassifgLabelTable *labels, MassifgHeapTreeNode *node) {
+	if (node->label_id == MASSIFG_LABEL_NONE) {
+		return !g_strstr_len(node->label->str, -1, "below massif's threshold");
+	}
+	return massifg_label_table_get_fields(labels, node->label_id)->function_id != MASSIFG_LABEL_NONE;
+}
+
+/* Add the memory usage under node to the call sites in the subtree.
+ * A call site that appears several times on the same path, for instance
+ * because of recursion, only gets the memory of the outermost node counted */
+static void
+leak_sweep_node(LeakSweep *sweep, GNode *node) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	LeakSiteSums *site = NULL;
+	GNode *child = NULL;
+
+	if (!is_call_site(sweep->labels, n))
+		return;
+
+	site = (LeakSiteSums *)g_hash_table_lookup(sweep->sites, GUINT_TO_POINTER(n->label_id));
+	if (!site) {
+		site = g_new0(LeakSiteSums, 1);
+		site->label = n->label->str;
+		site->last_snapshot = -1;
+		g_hash_table_insert(sweep->sites, GUINT_TO_POINTER(n->label_id), site);
+	}
+	if (site->last_snapshot != sweep->snapshot) {
+		site->last_snapshot = sweep->snapshot;
+		site->current_mem_B = 0;
+		g_ptr_array_add(sweep->touched, site);
+	}
+
+	if (site->active == 0) {
+		site->current_mem_B += n->total_mem_B;
+	}
+	site->active++;
+	for (child = node->children; child; child = child->next) {
+		leak_sweep_node(sweep, child);
+	}
+	site->active--;
+}
+
+static void
+leak_sweep_foreach(GNode *node, gpointer user_data) {
+	leak_sweep_node((LeakSweep *)user_data, node);
+}
+
+/* Add the memory usage of all call sites in the current snapshot to the running sums.
+ * Sites that do not appear in a snapshot have zero memory usage there,
+ * which does not contribute to the sums over y */
+static void
+leak_sweep_end_snapshot(LeakSweep *sweep, gdouble x) {
+	LeakSiteSums *site = NULL;
+	gdouble y;
+	guint i;
+
+	for (i=0; i<sweep->touched->len; i++) {
+		site = (LeakSiteSums *)g_ptr_array_index(sweep->touched, i);
+		y = (gdouble)site->current_mem_B;
+
+		site->sum_y += y;
+		site->sum_xy += x*y;
+		site->sum_yy += y*y;
+		site->peak_mem_B = MAX(site->peak_mem_B, site->current_mem_B);
+	}
+	g_ptr_array_set_size(sweep->touched, 0);
+
+	sweep->n += 1;
+	sweep->sum_x += x;
+	sweep->sum_xx += x*x;
+}
+
+/* Fit a line through the memory usage of site and create a MassifgLeakSite for it,
+ * or return NULL if the memory usage of the site is not growing */
+static MassifgLeakSite *
+leak_site_new_from_sums(LeakSweep *sweep, LeakSiteSums *site) {
+	MassifgLeakSite *leak_site = NULL;
+	gdouble var_x = sweep->n*sweep->sum_xx - sweep->sum_x*sweep->sum_x;
+	gdouble var_y = sweep->n*site->sum_yy - site->sum_y*site->sum_y;
+	gdouble cov_xy = sweep->n*site->sum_xy - sweep->sum_x*site->sum_y;
+
+	if (var_x <= 0 || var_y <= 0 || cov_xy <= 0)
+		return NULL;
+
+	leak_site = g_new(MassifgLeakSite, 1);
+	leak_site->label = site->label;
+	leak_site->slope = cov_xy / var_x;
+	leak_site->r_squared = (cov_xy / var_x) * (cov_xy / var_y);
+	leak_site->peak_mem_B = site->peak_mem_B;
+	leak_site->last_mem_B = (site->last_snapshot == sweep->snapshot) ? site->current_mem_B : 0;
+	return leak_site;
+}
+
+/* Sort leak sites by the fitted growth, weighted by how well the fit explains the data.
+ * A site that grows slowly but steadily is a more likely leak than one that jumps around */
+static gint
+leak_site_compare(gconstpointer a, gconstpointer b) {
+	const MassifgLeakSite *site_a = (const MassifgLeakSite *)a;
+	const MassifgLeakSite *site_b = (const MassifgLeakSite *)b;
+	gdouble score_a = site_a->slope * site_a->r_squared;
+	gdouble score_b = site_b->slope * site_b->r_squared;
+
+	if (score_a > score_b) return -1;
+	if (score_a < score_b) return +1;
+	return 0;
+}
+
+/* Frames are identified by their label without the code address, so that
+ * calls to a function from different places are merged.
+ * Example: "0x5792ABD: dictresize (dictobject.c:517)" -> "dictresize (dictobject.c:517)"
+ * Returns a pointer into label */
+static const gchar *
+frame_from_label(const gchar *label) {
+	const gchar *frame = NULL;
+
+	if (!g_str_has_prefix(label, "0x"))
+		return label;
+	frame = g_strstr_len(label, -1, ": ");
+	return frame ? frame+2 : label;
+}
+
+/* Map every label in labels to its frame. The cost is one lookup per distinct label */
+static void
+inverted_frames_init(InvertedFrames *frames, MassifgLabelTable *labels) {
+	GHashTable *frame_ids = g_hash_table_new(g_str_hash, g_str_equal);
+	const gchar *frame = NULL;
+	gpointer frame_id = NULL;
+	guint id;
+
+	frames->num_labels = massifg_label_table_size(labels);
+	frames->ids = g_new(guint, frames->num_labels);
+	frames->names = g_new0(const gchar *, frames->num_labels);
+
+	for (id=0; id<frames->num_labels; id++) {
+		if (massifg_label_table_get_fields(labels, id)->function_id == MASSIFG_LABEL_NONE) {
+			frames->ids[id] = MASSIFG_LABEL_NONE;
+			continue;
+		}
+		frame = frame_from_label(massifg_label_table_get(labels, id)->str);
+		if (g_hash_table_lookup_extended(frame_ids, frame, NULL, &frame_id)) {
+			frames->ids[id] = GPOINTER_TO_UINT(frame_id);
+			continue;
+		}
+		frames->ids[id] = id;
+		frames->names[id] = frame;
+		g_hash_table_insert(frame_ids, (gpointer)frame, GUINT_TO_POINTER(id));
+	}
+
+	g_hash_table_destroy(frame_ids);
+}
+
+/* Get the id of the frame of a heap tree node, or MASSIFG_LABEL_NONE if it is
+ * not a call site. Nodes with labels that were not interned are not call sites */
+static guint
+inverted_frames_get_id(const InvertedFrames *frames, MassifgHeapTreeNode *node) {
+	if (node->label_id >= frames->num_labels)
+		return MASSIFG_LABEL_NONE;
+	return frames->ids[node->label_id];
+}
+
+static MassifgInvertedNode *
+inverted_node_new(guint frame_id, const gchar *frame) {
+	MassifgInvertedNode *node = g_new(MassifgInvertedNode, 1);
+
+	node->frame_id = frame_id;
+	node->frame = frame;
+	node->inclusive_B = 0;
+	node->exclusive_B = 0;
+	node->callers = NULL;
+	return node;
+}
+
+static void
+inverted_node_free(MassifgInvertedNode *node) {
+	if (node->callers)
+		g_hash_table_destroy(node->callers);
+	g_free(node);
+}
+
+/* Get the caller of node with the given frame, creating it if needed */
+static MassifgInvertedNode *
+inverted_node_get_caller(MassifgInvertedNode *node, guint frame_id, const gchar *frame) {
+	MassifgInvertedNode *caller = NULL;
+
+	if (!node->callers) {
+		node->callers = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, (GDestroyNotify)inverted_node_free);
+	}
+	caller = (MassifgInvertedNode *)g_hash_table_lookup(node->callers, GUINT_TO_POINTER(frame_id));
+	if (!caller) {
+		caller = inverted_node_new(frame_id, frame);
+		g_hash_table_insert(node->callers, GUINT_TO_POINTER(frame_id), caller);
+	}
+	return caller;
+}
+
+/* Add the heap tree under heap_node to inverted_node.
+ * The children of a heap tree node are the callers of its frame */
+static void
+inverted_node_add_heap_tree(const InvertedFrames *frames, MassifgInvertedNode *inverted_node,
+			GNode *heap_node) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)heap_node->data;
+	MassifgHeapTreeNode *child_n = NULL;
+	MassifgInvertedNode *caller = NULL;
+	GNode *child = NULL;
+	gint64 exclusive_B = n->self_mem_B;
+	guint frame_id;
+
+	for (child = heap_node->children; child; child = child->next) {
+		child_n = (MassifgHeapTreeNode *)child->data;
+		frame_id = inverted_frames_get_id(frames, child_n);
+		if (frame_id == MASSIFG_LABEL_NONE) {
+			/* Allocations below the threshold of massif have no caller to go to */
+			exclusive_B += child_n->total_mem_B;
+			continue;
+		}
+
+		caller = inverted_node_get_caller(inverted_node, frame_id, frames->names[frame_id]);
+		inverted_node_add_heap_tree(frames, caller, child);
+	}
+	inverted_node->inclusive_B += n->total_mem_B;
+	inverted_node->exclusive_B += exclusive_B;
+}
+
+/* Make every call site in the heap tree under heap_node a child of root,
+ * with the subtree of callers it has at that place.
+ * part->active counts how many times each frame is on the path to heap_node. Only the
+ * outermost occurrence of a frame on a path is added, so that recursion is not counted twice */
+static void
+inverted_tree_add_frames(InvertedTreesPart *part, MassifgInvertedNode *root, GNode *heap_node) {
+	const InvertedFrames *frames = part->frames;
+	guint frame_id = inverted_frames_get_id(frames, (MassifgHeapTreeNode *)heap_node->data);
+	GNode *child = NULL;
+
+	if (frame_id == MASSIFG_LABEL_NONE)
+		return;
+
+	if (part->active[frame_id] == 0) {
+		inverted_node_add_heap_tree(frames,
+			inverted_node_get_caller(root, frame_id, frames->names[frame_id]), heap_node);
+	}
+
+	part->active[frame_id]++;
+	for (child = heap_node->children; child; child = child->next) {
+		inverted_tree_add_frames(part, root, child);
+	}
+	part->active[frame_id]--;
+}
+
+/* Build the inverted tree for a single heap tree */
+static MassifgInvertedNode *
+inverted_tree_new(InvertedTreesPart *part, GNode *heap_tree) {
+	MassifgInvertedNode *root = inverted_node_new(MASSIFG_LABEL_NONE, NULL);
+	GNode *child = NULL;
+
+	root->inclusive_B = ((MassifgHeapTreeNode *)heap_tree->data)->total_mem_B;
+	for (child = heap_tree->children; child; child = child->next) {
+		inverted_tree_add_frames(part, root, child);
+	}
+	return root;
+}
+
+/* Add the memory usage in src and its callers to dst */
+static void
+inverted_node_merge(MassifgInvertedNode *dst, MassifgInvertedNode *src) {
+	GHashTableIter iter;
+	MassifgInvertedNode *src_caller = NULL;
+
+	dst->inclusive_B += src->inclusive_B;
+	dst->exclusive_B += src->exclusive_B;
+
+	if (!src->callers)
+		return;
+	g_hash_table_iter_init(&iter, src->callers);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&src_caller)) {
+		inverted_node_merge(inverted_node_get_caller(dst, src_caller->frame_id, src_caller->frame),
+				src_caller);
+	}
+}
+
+/* Build the inverted trees for one part of the snapshots. Runs in a thread from the pool */
+static void
+inverted_trees_build_part(gpointer data, gpointer user_data) {
+	InvertedTreesPart *part = (InvertedTreesPart *)data;
+	MassifgInvertedNode *tree = NULL;
+	MassifgSnapshot *s = NULL;
+	GNode *heap_tree = NULL;
+	GList *l = part->snapshots;
+	guint i;
+
+	part->partial = inverted_node_new(MASSIFG_LABEL_NONE, NULL);
+	part->active = g_new0(guint, part->frames->num_labels);
+	for (i=part->first_index; i<part->first_index+part->num_snapshots; i++, l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		heap_tree = massifg_output_data_get_heap_tree(part->data, s);
+		if (!heap_tree)
+			continue;
+
+		/* Each part writes to its own slots of the array, which is already allocated */
+		tree = inverted_tree_new(part, heap_tree);
+		massifg_output_data_release_heap_tree(part->data, s);
+		g_ptr_array_index(part->trees->snapshot_trees, i) = tree;
+		inverted_node_merge(part->partial, tree);
+	}
+	g_free(part->active);
+}
+
+/* Sort inverted nodes by inclusive memory usage, largest first */
+static gint
+inverted_node_compare(gconstpointer a, gconstpointer b) {
+	const MassifgInvertedNode *node_a = (const MassifgInvertedNode *)a;
+	const MassifgInvertedNode *node_b = (const MassifgInvertedNode *)b;
+
+	if (node_a->inclusive_B > node_b->inclusive_B) return -1;
+	if (node_a->inclusive_B < node_b->inclusive_B) return +1;
+	return 0;
+}
+
+/* Get the name of the group a label belongs to. Returns a newly allocated string */
+static gchar *
+usage_group_name(MassifgLabelTable *labels, guint label_id, MassifgGroupBy group_by) {
+	const MassifgLabelFields *fields = massifg_label_table_get_fields(labels, label_id);
+	const gchar *function = NULL;
+	const gchar *separator = NULL;
+	const gchar *args = NULL;
+
+	if (group_by == MASSIFG_GROUP_BY_FUNCTION) {
+		return massifg_label_table_get_short_label(labels, label_id);
+	}
+	if (fields->function_id == MASSIFG_LABEL_NONE) {
+		/* Allocations below the threshold of massif */
+		return g_strdup("(other)");
+	}
+
+	switch (group_by) {
+	case MASSIFG_GROUP_BY_OBJECT:
+		if (fields->object_id == MASSIFG_LABEL_NONE)
+			return g_strdup("(unknown object)");
+		return g_strdup(massifg_label_table_get(labels->objects, fields->object_id)->str);
+	case MASSIFG_GROUP_BY_FILE:
+		if (fields->file_id == MASSIFG_LABEL_NONE)
+			return g_strdup("(unknown file)");
+		return g_strdup(massifg_label_table_get(labels->files, fields->file_id)->str);
+	case MASSIFG_GROUP_BY_NAMESPACE:
+		/* Only look for the namespace before the argument list */
+		function = massifg_label_table_get(labels->functions, fields->function_id)->str;
+		separator = strstr(function, "::");
+		args = strchr(function, '(');
+		if (!separator || (args && args < separator))
+			return g_strdup("(global namespace)");
+		return g_strndup(function, separator-function);
+	case MASSIFG_GROUP_BY_FUNCTION:
+	case MASSIFG_GROUP_BY_LAST:
+		g_assert_not_reached();
+		break;
+	}
+	return NULL;
+}
+
+/* Start building groups, with none yet */
+static void
+usage_groups_init(UsageGroups *usage_groups, MassifgLabelTable *labels, MassifgGroupBy group_by,
+				guint num_snapshots) {
+	usage_groups->labels = labels;
+	usage_groups->group_by = group_by;
+	usage_groups->num_snapshots = num_snapshots;
+	usage_groups->label_groups = g_new0(UsageGroup *, massifg_label_table_size(labels));
+	usage_groups->groups_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+	usage_groups->groups = g_ptr_array_new();
+}
+
+/* Get the group of a label, which is found the first time the label is seen */
+static UsageGroup *
+usage_groups_get(UsageGroups *usage_groups, guint label_id) {
+	UsageGroup *group = usage_groups->label_groups[label_id];
+	gchar *name = NULL;
+
+	if (group)
+		return group;
+
+	name = usage_group_name(usage_groups->labels, label_id, usage_groups->group_by);
+	group = (UsageGroup *)g_hash_table_lookup(usage_groups->groups_by_name, name);
+	if (!group) {
+		group = g_new0(UsageGroup, 1);
+		group->name = name;
+		group->values = g_new0(gdouble, usage_groups->num_snapshots);
+		group->order = usage_groups->groups->len;
+		g_ptr_array_add(usage_groups->groups, group);
+		g_hash_table_insert(usage_groups->groups_by_name, name, group);
+	}
+	else {
+		g_free(name);
+	}
+	usage_groups->label_groups[label_id] = group;
+	return group;
+}
+
+/* Sum the allocation sites of the heap trees by group, one snapshot at a time */
+static void
+usage_groups_add_heap_trees(UsageGroups *usage_groups, MassifgOutputData *data,
+				const gboolean *label_mask) {
+	MassifgSnapshot *snapshot = NULL;
+	MassifgHeapTreeNode *n = NULL;
+	UsageGroup *group = NULL;
+	GNode *heap_tree = NULL;
+	GNode *child = NULL;
+	GList *l = NULL;
+	guint i;
+
+	for (l = data->snapshots, i = 0; l; l = l->next, i++) {
+		snapshot = (MassifgSnapshot *)l->data;
+		heap_tree = massifg_output_data_get_heap_tree(data, snapshot);
+		if (!heap_tree)
+			continue;
+
+		for (child = heap_tree->children; child; child = child->next) {
+			n = (MassifgHeapTreeNode *)child->data;
+			if (label_mask && !label_mask[n->label_id])
+				continue;
+
+			group = usage_groups_get(usage_groups, n->label_id);
+			group->values[i] += n->total_mem_B;
+			if (group->last_snapshot != i+1) {
+				group->last_snapshot = i+1;
+				group->num_present++;
+			}
+		}
+		massifg_output_data_release_heap_tree(data, snapshot);
+	}
+}
+
+/* Sum the columns of the allocation sites in the union tree by group.
+ * The children of the root are in the order their labels were first seen
+ * in the snapshots, so the groups are created in the same order as when
+ * walking the heap trees. The columns of a group are summed one after
+ * another, so the snapshots a group appears in can be counted with
+ * a mark per snapshot */
+static void
+usage_groups_add_union_tree(UsageGroups *usage_groups, MassifgUnionTree *union_tree,
+				const gboolean *label_mask) {
+	guint *marks = NULL;
+	MassifgUnionNode *n = NULL;
+	UsageGroup *group = NULL;
+	GNode *child = NULL;
+	GSList *l = NULL;
+	guint i, j;
+
+	if (!union_tree->root)
+		return;
+
+	for (child = union_tree->root->children; child; child = child->next) {
+		n = (MassifgUnionNode *)child->data;
+		if (label_mask && !label_mask[n->label_id])
+			continue;
+
+		group = usage_groups_get(usage_groups, n->label_id);
+		group->union_nodes = g_slist_prepend(group->union_nodes, n);
+	}
+
+	marks = g_new0(guint, usage_groups->num_snapshots);
+	for (i=0; i<usage_groups->groups->len; i++) {
+		group = (UsageGroup *)g_ptr_array_index(usage_groups->groups, i);
+		for (l = group->union_nodes; l; l = l->next) {
+			n = (MassifgUnionNode *)l->data;
+			for (j=0; j<n->num_values && n->snapshots[j] < usage_groups->num_snapshots; j++) {
+				group->values[n->snapshots[j]] += n->values[j];
+				if (marks[n->snapshots[j]] != i+1) {
+					marks[n->snapshots[j]] = i+1;
+					group->num_present++;
+				}
+			}
+		}
+	}
+	g_free(marks);
+}
+
+/* Sort groups by the number of snapshots they appear in, most first */
+static gint
+usage_group_compare(gconstpointer a, gconstpointer b) {
+	const UsageGroup *group_a = *(const UsageGroup **)a;
+	const UsageGroup *group_b = *(const UsageGroup **)b;
+
+	if (group_a->num_present != group_b->num_present)
+		return group_a->num_present > group_b->num_present ? -1 : +1;
+	return group_a->order < group_b->order ? -1 : +1;
+}
+
+/* Find the detailed snapshot with the largest heap usage, or NULL if there is none */
+static MassifgSnapshot *
+find_peak_snapshot(MassifgOutputData *data) {
+	MassifgSnapshot *snapshot = NULL;
+	MassifgSnapshot *peak = NULL;
+	GList *l = NULL;
+
+	for (l = data->snapshots; l; l = l->next) {
+		snapshot = (MassifgSnapshot *)l->data;
+		if (massifg_snapshot_has_heap_tree(snapshot) && (!peak || snapshot->mem_heap_B > peak->mem_heap_B)) {
+			peak = snapshot;
+		}
+	}
+	return peak;
+}
+
+/* Add the memory of the allocation functions at the peak of data to the
+ * deltas table, keyed on function and shared object id */
+static void
+compare_add_peak(GHashTable *deltas, MassifgOutputData *data, gboolean after) {
+	MassifgSnapshot *peak = find_peak_snapshot(data);
+	const MassifgLabelFields *fields = NULL;
+	FunctionDeltaEntry *entry = NULL;
+	MassifgHeapTreeNode *n = NULL;
+	GNode *heap_tree = NULL;
+	GNode *child = NULL;
+	guint64 key;
+	gchar *function = NULL;
+
+	heap_tree = peak ? massifg_output_data_get_heap_tree(data, peak) : NULL;
+	if (!heap_tree)
+		return;
+
+	for (child = heap_tree->children; child; child = child->next) {
+		n = (MassifgHeapTreeNode *)child->data;
+		fields = massifg_label_table_get_fields(data->labels, n->label_id);
+		key = ((guint64)fields->function_id << 32) | fields->object_id;
+
+		entry = (FunctionDeltaEntry *)g_hash_table_lookup(deltas, &key);
+		if (!entry) {
+			if (fields->function_id == MASSIFG_LABEL_NONE) {
+				function = g_strdup("(below massif's threshold)");
+			}
+			else if (fields->object_id == MASSIFG_LABEL_NONE) {
+				function = g_strdup(massifg_label_table_get(data->labels->functions, fields->function_id)->str);
+			}
+			else {
+				function = g_strdup_printf("%s (in %s)",
+					massifg_label_table_get(data->labels->functions, fields->function_id)->str,
+					massifg_label_table_get(data->labels->objects, fields->object_id)->str);
+			}
+			entry = g_new0(FunctionDeltaEntry, 1);
+			entry->delta.function = function;
+			entry->key = key;
+			g_hash_table_insert(deltas, &entry->key, entry);
+		}
+		if (after)
+			entry->delta.after_B += n->total_mem_B;
+		else
+			entry->delta.before_B += n->total_mem_B;
+	}
+	massifg_output_data_release_heap_tree(data, peak);
+}
+
+/* Sort deltas with the largest change first */
+static gint
+function_delta_compare(gconstpointer a, gconstpointer b) {
+	gint64 delta_a = ABS(((const MassifgFunctionDelta *)a)->delta_B);
+	gint64 delta_b = ABS(((const MassifgFunctionDelta *)b)->delta_B);
+
+	if (delta_a == delta_b)
+		return 0;
+	return delta_a > delta_b ? -1 : +1;
+}
+
+/* Public functions */
+
+/**
+ * massifg_analysis_find_leaks:
+ * @data: #MassifgOutputData to analyze
+ * @max_sites: The maximum number of call sites to return
+ * @Returns: A #GList of #MassifgLeakSite, ranked with the most likely leak first.
+ * Free with massifg_analysis_leaks_free().
+ *
+ * Find the call sites whose memory usage grows steadily over the run.
+ *
+ * Every call site in the heap trees of the detailed snapshots gets a straight line
+ * fitted to its memory usage over time. Sites with a positive slope are ranked by
+ * slope times R², so that steady growth ranks above noisy growth.
+ * The work done is linear in the total number of heap tree nodes.
+ */
+GList *
+massifg_analysis_find_leaks(MassifgOutputData *data, guint max_sites) {
+	LeakSweep sweep;
+	LeakSiteSums *site = NULL;
+	MassifgSnapshot *s = NULL;
+	GNode *heap_tree = NULL;
+	MassifgLeakSite *leak_site = NULL;
+	GList *l = NULL;
+	GList *leak_sites = NULL;
+	GHashTableIter iter;
+	gdouble x;
+	gint64 first_time = -1;
+
+	g_return_val_if_fail(data != NULL, NULL);
+
+	sweep.labels = data->labels;
+	sweep.sites = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	sweep.touched = g_ptr_array_new();
+	sweep.snapshot = 0;
+	sweep.n = sweep.sum_x = sweep.sum_xx = 0;
+
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		heap_tree = massifg_output_data_get_heap_tree(data, s);
+		if (!heap_tree)
+			continue;
+
+		/* Measure time from the first detailed snapshot, to keep the sums small */
+		if (first_time < 0)
+			first_time = s->time;
+		x = (gdouble)(s->time - first_time);
+
+		/* The root is the total over all allocation functions, not a call site */
+		sweep.snapshot++;
+		g_node_children_foreach(heap_tree, G_TRAVERSE_ALL,
+				leak_sweep_foreach, &sweep);
+		massifg_output_data_release_heap_tree(data, s);
+		leak_sweep_end_snapshot(&sweep, x);
+	}
+
+	g_hash_table_iter_init(&iter, sweep.sites);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&site)) {
+		leak_site = leak_site_new_from_sums(&sweep, site);
+		if (leak_site)
+			leak_sites = g_list_prepend(leak_sites, leak_site);
+	}
+	leak_sites = g_list_sort(leak_sites, leak_site_compare);
+
+	/* Only keep the max_sites highest ranked */
+	if (max_sites == 0) {
+		massifg_analysis_leaks_free(leak_sites);
+		leak_sites = NULL;
+	}
+	l = g_list_nth(leak_sites, max_sites);
+	if (l) {
+		l->prev->next = NULL;
+		l->prev = NULL;
+		massifg_analysis_leaks_free(l);
+	}
+
+	g_ptr_array_free(sweep.touched, TRUE);
+	g_hash_table_destroy(sweep.sites);
+	return leak_sites;
+}
+
+/**
+ * massifg_analysis_leaks_free:
+ * @leak_sites: #GList of #MassifgLeakSite, as returned by massifg_analysis_find_leaks()
+ *
+ * Free a list of #MassifgLeakSite.
+ */
+void
+massifg_analysis_leaks_free(GList *leak_sites) {
+	GList *l = NULL;
+
+	for (l = leak_sites; l; l = l->next) {
+		g_free(l->data);
+	}
+	g_list_free(leak_sites);
+}
+
+/**
+ * massifg_analysis_build_inverted_trees:
+ * @data: #MassifgOutputData to build the trees for
+ * @num_threads: Number of threads to use, or 0 for a default
+ * @Returns: A new #MassifgInvertedTrees. Free with massifg_analysis_inverted_trees_free().
+ *
+ * Build an inverted call tree for each snapshot, and one merged over all snapshots.
+ * See #MassifgInvertedNode.
+ *
+ * The trees refer to strings in @data, which must therefore outlive them.
+ * If threads are not supported, the trees are built in the calling thread.
+ */
+MassifgInvertedTrees *
+massifg_analysis_build_inverted_trees(MassifgOutputData *data, guint num_threads) {
+	MassifgInvertedTrees *trees = NULL;
+	InvertedTreesPart *parts = NULL;
+	InvertedFrames frames;
+	GThreadPool *pool = NULL;
+	GList *l = NULL;
+	guint num_snapshots;
+	guint part_size;
+	guint i, j;
+
+	g_return_val_if_fail(data != NULL, NULL);
+
+	num_snapshots = g_list_length(data->snapshots);
+	if (num_threads == 0)
+		num_threads = INVERTED_TREES_DEFAULT_THREADS;
+	num_threads = CLAMP(num_threads, 1, MAX(num_snapshots, 1));
+
+	trees = g_new(MassifgInvertedTrees, 1);
+	trees->snapshot_trees = g_ptr_array_sized_new(num_snapshots);
+	g_ptr_array_set_size(trees->snapshot_trees, num_snapshots);
+	trees->merged = inverted_node_new(MASSIFG_LABEL_NONE, NULL);
+	inverted_frames_init(&frames, data->labels);
+
+	/* Split the snapshots into one consecutive part per thread */
+	parts = g_new(InvertedTreesPart, num_threads);
+	part_size = (num_snapshots + num_threads - 1) / num_threads;
+	l = data->snapshots;
+	for (i=0; i<num_threads; i++) {
+		parts[i].trees = trees;
+		parts[i].data = data;
+		parts[i].frames = &frames;
+		parts[i].snapshots = l;
+		parts[i].first_index = MIN(i*part_size, num_snapshots);
+		parts[i].num_snapshots = MIN(part_size, num_snapshots - parts[i].first_index);
+		parts[i].active = NULL;
+		parts[i].partial = NULL;
+		for (j=0; j<parts[i].num_snapshots; j++)
+			l = l->next;
+	}
+
+	if (g_thread_supported() && num_threads > 1) {
+		pool = g_thread_pool_new(inverted_trees_build_part, NULL, num_threads, FALSE, NULL);
+	}
+	for (i=0; i<num_threads; i++) {
+		if (pool)
+			g_thread_pool_push(pool, &parts[i], NULL);
+		else
+			inverted_trees_build_part(&parts[i], NULL);
+	}
+	if (pool) {
+		/* Wait for all the parts to be built */
+		g_thread_pool_free(pool, FALSE, TRUE);
+	}
+
+	/* Merge the partial trees */
+	for (i=0; i<num_threads; i++) {
+		inverted_node_merge(trees->merged, parts[i].partial);
+		inverted_node_free(parts[i].partial);
+	}
+	g_free(parts);
+	g_free(frames.ids);
+	g_free(frames.names);
+
+	return trees;
+}
+
+/**
+ * massifg_analysis_inverted_trees_free:
+ * @trees: #MassifgInvertedTrees to free
+ *
+ * Free a #MassifgInvertedTrees, including all the trees in it.
+ */
+void
+massifg_analysis_inverted_trees_free(MassifgInvertedTrees *trees) {
+	MassifgInvertedNode *tree = NULL;
+	guint i;
+
+	for (i=0; i<trees->snapshot_trees->len; i++) {
+		tree = (MassifgInvertedNode *)g_ptr_array_index(trees->snapshot_trees, i);
+		if (tree)
+			inverted_node_free(tree);
+	}
+	g_ptr_array_free(trees->snapshot_trees, TRUE);
+	inverted_node_free(trees->merged);
+	g_free(trees);
+}
+
+/**
+ * massifg_inverted_node_get_callers:
+ * @node: A #MassifgInvertedNode
+ * @Returns: #GList of the callers of @node, sorted with the largest @inclusive_B first.
+ * Free with g_list_free().
+ *
+ * Get the callers of an inverted node, in the order they should be presented.
+ */
+GList *
+massifg_inverted_node_get_callers(MassifgInvertedNode *node) {
+	GList *callers = NULL;
+
+	if (!node->callers)
+		return NULL;
+	callers = g_hash_table_get_values(node->callers);
+	return g_list_sort(callers, inverted_node_compare);
+}
+
+/**
+ * massifg_analysis_group_usage:
+ * @data: A #MassifgOutputData
+ * @group_by: How to group the allocation sites
+ * @label_mask: Indexed by label id, %TRUE for the allocation sites to include.
+ * %NULL to include all of them
+ * @Returns: A new #MassifgGroupedUsage. Free with massifg_analysis_grouped_usage_free()
+ *
+ * Sum the heap usage of the allocation sites in each snapshot by group.
+ * The cost is one lookup per distinct label, and one addition per allocation site
+ * in each snapshot. If @data has a union tree, the columns of the children of
+ * its root are summed instead, so the heap trees are not needed.
+ */
+MassifgGroupedUsage *
+massifg_analysis_group_usage(MassifgOutputData *data, MassifgGroupBy group_by,
+				const gboolean *label_mask) {
+	MassifgGroupedUsage *usage = g_new(MassifgGroupedUsage, 1);
+	UsageGroups usage_groups;
+	UsageGroup *group = NULL;
+	MassifgTraceSpan span;
+	guint i;
+
+	g_return_val_if_fail(group_by < MASSIFG_GROUP_BY_LAST, NULL);
+
+	massifg_trace_begin(&span, "detailed-table");
+	usage->num_snapshots = g_list_length(data->snapshots);
+	usage_groups_init(&usage_groups, data->labels, group_by, usage->num_snapshots);
+
+	if (data->union_tree)
+		usage_groups_add_union_tree(&usage_groups, data->union_tree, label_mask);
+	else
+		usage_groups_add_heap_trees(&usage_groups, data, label_mask);
+
+	g_ptr_array_sort(usage_groups.groups, usage_group_compare);
+	usage->names = g_ptr_array_new_with_free_func(g_free);
+	usage->series = g_ptr_array_new_with_free_func(g_free);
+	for (i=0; i<usage_groups.groups->len; i++) {
+		group = (UsageGroup *)g_ptr_array_index(usage_groups.groups, i);
+		g_ptr_array_add(usage->names, group->name);
+		g_ptr_array_add(usage->series, group->values);
+		g_slist_free(group->union_nodes);
+		g_free(group);
+	}
+
+	g_ptr_array_free(usage_groups.groups, TRUE);
+	g_hash_table_destroy(usage_groups.groups_by_name);
+	g_free(usage_groups.label_groups);
+	massifg_trace_end(&span);
+	return usage;
+}
+
+/**
+ * massifg_analysis_grouped_usage_free:
+ * @usage: #MassifgGroupedUsage to free
+ *
+ * Free a #MassifgGroupedUsage.
+ */
+void
+massifg_analysis_grouped_usage_free(MassifgGroupedUsage *usage) {
+	g_ptr_array_free(usage->names, TRUE);
+	g_ptr_array_free(usage->series, TRUE);
+	g_free(usage);
+}
+
+/**
+ * massifg_analysis_compare_peaks:
+ * @before: The first #MassifgOutputData
+ * @after: The second #MassifgOutputData. Must share the #MassifgLabelTable with @before
+ * @Returns: #GList of #MassifgFunctionDelta, with the largest change first.
+ * Free with massifg_analysis_deltas_free()
+ *
+ * Compare the memory allocated by each allocation function, the direct children
+ * of the root of the heap tree, at the peak of two massif outputs.
+ */
+GList *
+massifg_analysis_compare_peaks(MassifgOutputData *before, MassifgOutputData *after) {
+	GHashTable *deltas = NULL;
+	GList *delta_list = NULL;
+	GList *l = NULL;
+	MassifgFunctionDelta *delta = NULL;
+
+	g_return_val_if_fail(before->labels == after->labels, NULL);
+
+	deltas = g_hash_table_new(g_int64_hash, g_int64_equal);
+	compare_add_peak(deltas, before, FALSE);
+	compare_add_peak(deltas, after, TRUE);
+
+	delta_list = g_hash_table_get_values(deltas);
+	for (l = delta_list; l; l = l->next) {
+		delta = (MassifgFunctionDelta *)l->data;
+		delta->delta_B = delta->after_B - delta->before_B;
+	}
+	g_hash_table_destroy(deltas);
+
+	return g_list_sort(delta_list, function_delta_compare);
+}
+
+/**
+ * massifg_analysis_deltas_free:
+ * @deltas: #GList of #MassifgFunctionDelta
+ *
+ * Free a list returned by massifg_analysis_compare_peaks().
+ */
+void
+massifg_analysis_deltas_free(GList *deltas) {
+	GList *l = NULL;
+
+	for (l = deltas; l; l = l->next) {
+		g_free(((MassifgFunctionDelta *)l->data)->function);
+		g_free(l->data);
+	}
+	g_list_free(deltas);
+}
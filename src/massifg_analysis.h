@@ -0,0 +1,165 @@
+/*
+ *  MassifG - massifg_analysis.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_ANALYSIS_H__
+#define MASSIFG_ANALYSIS_H__
+
+#include <glib.h>
+
+#include "massifg_parser.h"
+
+/* Data structures */
+
+/**
+ * MassifgLeakSite:
+ * @label: Label of the call site. Owned by the #MassifgOutputData it was found in.
+ * @slope: Growth of the memory usage under this call site, in bytes per time unit.
+ * @r_squared: How well a straight line fits the memory usage over time, between 0 and 1.
+ * @peak_mem_B: The largest memory usage under this call site in a single snapshot.
+ * @last_mem_B: Memory usage under this call site in the last detailed snapshot.
+ *
+ * A call site whose memory usage grows over the run.
+ */
+typedef struct {
+	const gchar *label;
+
+	gdouble slope;
+	gdouble r_squared;
+
+	gint64 peak_mem_B;
+	gint64 last_mem_B;
+} MassifgLeakSite;
+
+/**
+ * MassifgInvertedNode:
+ * @frame_id: Id of the frame this node represents, which is the id of the first label
+ * with this frame in the #MassifgLabelTable of the #MassifgOutputData it was built from.
+ * %MASSIFG_LABEL_NONE for the root of the tree.
+ * @frame: The frame this node represents, as the label of the heap tree node without
+ * the code address. Owned by the #MassifgOutputData it was built from.
+ * %NULL for the root of the tree.
+ * @inclusive_B: Memory allocated through this frame, when called along this path.
+ * @exclusive_B: The part of @inclusive_B that massif did not attribute to any caller of this frame.
+ * @callers: Table over the callers of this frame, from frame id (with GUINT_TO_POINTER())
+ * to #MassifgInvertedNode. %NULL if there are none.
+ *
+ * A node in an inverted call tree. The children of the root are every frame
+ * that appears anywhere in the heap trees, and the children of those are their
+ * callers, merged by frame. For every node except the root,
+ * @inclusive_B is @exclusive_B plus the @inclusive_B of the callers.
+ */
+typedef struct _MassifgInvertedNode MassifgInvertedNode;
+struct _MassifgInvertedNode {
+	guint frame_id;
+	const gchar *frame;
+
+	gint64 inclusive_B;
+	gint64 exclusive_B;
+
+	GHashTable *callers;
+};
+
+/**
+ * MassifgInvertedTrees:
+ * @snapshot_trees: Array with the root #MassifgInvertedNode for each snapshot,
+ * in the same order as the snapshots in the #MassifgOutputData.
+ * %NULL for snapshots without a heap tree.
+ * @merged: The inverted trees of all the snapshots merged into one, with the
+ * memory usage summed over the snapshots.
+ *
+ * Inverted call trees built by massifg_analysis_build_inverted_trees().
+ */
+typedef struct {
+	GPtrArray *snapshot_trees;
+	MassifgInvertedNode *merged;
+} MassifgInvertedTrees;
+
+/**
+ * MassifgGroupBy:
+ * @MASSIFG_GROUP_BY_FUNCTION: One group for each distinct label.
+ * @MASSIFG_GROUP_BY_OBJECT: Group by the shared object of the frame.
+ * @MASSIFG_GROUP_BY_FILE: Group by the source file of the frame.
+ * @MASSIFG_GROUP_BY_NAMESPACE: Group by the outermost namespace of the function,
+ * for instance "std" for "std::string::_Rep::_S_create".
+ *
+ * How to aggregate the heap usage of the allocation sites in
+ * massifg_analysis_group_usage().
+ */
+typedef enum {
+	MASSIFG_GROUP_BY_FUNCTION,
+	MASSIFG_GROUP_BY_OBJECT,
+	MASSIFG_GROUP_BY_FILE,
+	MASSIFG_GROUP_BY_NAMESPACE,
+	/*< private >*/
+	MASSIFG_GROUP_BY_LAST /* NOTE: only used to calculate the number of elements in the enum */
+} MassifgGroupBy;
+
+/**
+ * MassifgGroupedUsage:
+ * @num_snapshots: Number of snapshots, and of values in each series.
+ * @names: Array with the name of each group.
+ * @series: Array with the memory usage of each group, as an array of
+ * @num_snapshots #gdouble values, in the same order as the snapshots in
+ * the #MassifgOutputData.
+ *
+ * The heap usage of the allocation sites, the direct children of the root of
+ * each heap tree, summed by group. Groups are ordered by the number of snapshots
+ * they appear in, with the ones that appear in the most snapshots first.
+ */
+typedef struct {
+	guint num_snapshots;
+	GPtrArray *names;
+	GPtrArray *series;
+} MassifgGroupedUsage;
+
+/**
+ * MassifgFunctionDelta:
+ * @function: Name of the function, with the shared object if it is known.
+ * @before_B: Memory allocated directly by the function at the peak of the first output.
+ * @after_B: Memory allocated directly by the function at the peak of the second output.
+ * @delta_B: @after_B minus @before_B.
+ *
+ * The change in memory usage of an allocation function between two massif outputs.
+ */
+typedef struct {
+	gchar *function;
+
+	gint64 before_B;
+	gint64 after_B;
+	gint64 delta_B;
+} MassifgFunctionDelta;
+
+/* Public functions */
+GList *massifg_analysis_find_leaks(MassifgOutputData *data, guint max_sites);
+void massifg_analysis_leaks_free(GList *leak_sites);
+
+MassifgInvertedTrees *massifg_analysis_build_inverted_trees(MassifgOutputData *data, guint num_threads);
+void massifg_analysis_inverted_trees_free(MassifgInvertedTrees *trees);
+GList *massifg_inverted_node_get_callers(MassifgInvertedNode *node);
+
+MassifgGroupedUsage *massifg_analysis_group_usage(MassifgOutputData *data, MassifgGroupBy group_by,
+				const gboolean *label_mask);
+void massifg_analysis_grouped_usage_free(MassifgGroupedUsage *usage);
+
+GList *massifg_analysis_compare_peaks(MassifgOutputData *before, MassifgOutputData *after);
+void massifg_analysis_deltas_free(GList *deltas);
+
+#endif /* MASSIFG_ANALYSIS_H__ */
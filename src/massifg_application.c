@@ -28,11 +28,18 @@
  * Note: These functions are meant to be used internally in MassifG.
  */
 
+#include <signal.h> /* for kill() */
+#include <stdio.h> /* for sscanf() */
+#include <string.h>
+
+#include <gio/gio.h>
 #include <gtk/gtk.h>
 
 #include "massifg_application.h"
 #include "massifg_parser.h"
 #include "massifg_graph.h"
+#include "massifg_run.h"
+#include "massifg_trace.h"
 #include "massifg_utils.h"
 #include "massifg_gtkui.h"
 
@@ -47,6 +54,55 @@ enum
 
 static guint massifg_application_signals[N_SIGNALS];
 
+/* Number of allocators printed for each file by --summary */
+static const guint SUMMARY_NUM_ALLOCATORS = 20;
+
+/* Size of the graphs rendered by --render, unless --size is given */
+static const guint RENDER_DEFAULT_WIDTH = 2000;
+static const guint RENDER_DEFAULT_HEIGHT = 1000;
+
+/* Number of threads parsing files for --render, and the number of parsed files
+ * that can wait for rendering, which limits the memory used for many files */
+static const guint RENDER_PARSE_THREADS = 4;
+static const guint RENDER_MAX_PENDING = 8;
+
+/* Number of bytes read from a file for each step of loading it */
+#define LOADER_CHUNK_SIZE (64*1024)
+
+/* While a file is loaded, the graph is updated at most this often, in seconds.
+ * After an update, the next one waits for at least this many times as long as
+ * the update took, so that updating the graph takes at most about 10% of the time */
+static const gdouble LOADER_MIN_UPDATE_INTERVAL = 0.1;
+static const gdouble LOADER_UPDATE_COST_FACTOR = 10.0;
+
+/* A file being loaded by massifg_application_load_file(), or the output of
+ * massif being read by massifg_application_run_massif().
+ * When a file is followed, the loader stays after the end of the file is reached, and
+ * the bytes written to the file later are read when monitor reports a change */
+struct _MassifgLoader {
+	gchar *filename;
+	GIOChannel *io_channel;
+	MassifgParser *parser;
+	GPid pid; /* Only set while massif is running */
+	guint source_id; /* Set while reading */
+	guint update_source_id; /* Set while waiting to update the graph */
+	GFileMonitor *monitor; /* Only set when following the file */
+	goffset offset; /* Number of bytes read */
+	GTimer *timer;
+	gdouble last_update; /* When the graph was last updated, from timer */
+	gdouble update_cost; /* How long that update took, in seconds */
+	gboolean shown; /* Whether the graph shows the data of parser */
+	gchar buffer[LOADER_CHUNK_SIZE];
+};
+typedef struct _MassifgLoader MassifgLoader;
+
+/* A file to render with --render */
+typedef struct {
+	const gchar *filename;
+	MassifgOutputData *data;
+	GError *error;
+} RenderJob;
+
 /* Unref object once and only once, to avoid trying to unref an invalid object */
 void
 gobject_safe_unref(GObject *object) {
@@ -56,6 +112,420 @@ gobject_safe_unref(GObject *object) {
 	}
 }
 
+/* Print the summary of a file to stdout */
+static void
+print_summary(const gchar *filename, MassifgSummary *summary) {
+	MassifgAllocator *allocator = NULL;
+	guint i;
+
+	g_print("%s\n", filename);
+	g_print("  Command:   %s\n", summary->cmd->str);
+	g_print("  Snapshots: %d\n", summary->num_snapshots);
+	g_print("  Peak:      %" G_GINT64_FORMAT " bytes in snapshot %d, at time %" G_GINT64_FORMAT " (%s)\n",
+		summary->peak_mem_B, summary->peak_snapshot_no, summary->peak_time, summary->time_unit->str);
+
+	if (summary->peak_tree_snapshot_no < 0)
+		return;
+	g_print("  Largest allocators in snapshot %d:\n", summary->peak_tree_snapshot_no);
+	for (i=0; i<summary->peak_allocators->len; i++) {
+		allocator = (MassifgAllocator *)g_ptr_array_index(summary->peak_allocators, i);
+		g_print("  %12" G_GINT64_FORMAT " %5.1f%% %s\n", allocator->mem_B,
+			summary->peak_tree_mem_B ? 100.0*allocator->mem_B/summary->peak_tree_mem_B : 0.0,
+			allocator->label);
+	}
+}
+
+/* Print a summary of each file, without opening a window
+ * Returns the exit status */
+static gint
+massifg_application_run_summary(gchar **filenames, gint num_files) {
+	MassifgSummary *summary = NULL;
+	GError *error = NULL;
+	gint retval = 0;
+	gint i;
+
+	for (i=0; i<num_files; i++) {
+		summary = massifg_summarize_file(filenames[i], SUMMARY_NUM_ALLOCATORS, &error);
+		if (!summary) {
+			g_printerr("Unable to parse file %s: %s\n", filenames[i], error->message);
+			g_clear_error(&error);
+			retval = 1;
+			continue;
+		}
+		print_summary(filenames[i], summary);
+		massifg_summary_free(summary);
+	}
+	return retval;
+}
+
+/* Parse the file of a RenderJob, as a GFunc for a GThreadPool
+ * The job is pushed to the queue in user_data when done */
+static void
+render_parse_job(gpointer data, gpointer user_data) {
+	RenderJob *job = (RenderJob *)data;
+
+	job->data = massifg_parse_file(job->filename, &job->error);
+	g_async_queue_push((GAsyncQueue *)user_data, job);
+}
+
+/* Get the file to render input to. With several inputs, the name of each
+ * input is added to output before the extension: out.png becomes out-massif.out.123.png */
+static gchar *
+render_output_name(const gchar *output, const gchar *input, gint num_inputs) {
+	const gchar *extension = strrchr(output, '.');
+	gchar *basename = NULL;
+	gchar *stem = NULL;
+	gchar *name = NULL;
+
+	if (num_inputs == 1 || !extension)
+		return g_strdup(output);
+
+	basename = g_path_get_basename(input);
+	stem = g_strndup(output, extension - output);
+	name = g_strdup_printf("%s-%s%s", stem, basename, extension);
+	g_free(stem);
+	g_free(basename);
+	return name;
+}
+
+/* Render a graph of each file, without opening a window
+ * The files are parsed by a pool of threads while the main thread renders
+ * the ones that are done, since GOffice can only be used from one thread.
+ * Returns the exit status */
+static gint
+massifg_application_run_render(const gchar *output, const gchar *size,
+				gchar **filenames, gint num_files) {
+	MassifgGraph *graph = NULL;
+	GAsyncQueue *done = NULL;
+	GThreadPool *pool = NULL;
+	RenderJob *jobs = NULL;
+	RenderJob *job = NULL;
+	GError *error = NULL;
+	gchar *output_name = NULL;
+	guint width = RENDER_DEFAULT_WIDTH;
+	guint height = RENDER_DEFAULT_HEIGHT;
+	gint next = 0, pending = 0, i;
+	gint retval = 0;
+
+	if (size && (sscanf(size, "%ux%u", &width, &height) != 2 || !width || !height)) {
+		g_printerr("Invalid size %s, expected WIDTHxHEIGHT\n", size);
+		return 1;
+	}
+	if (num_files < 1) {
+		g_printerr("No files to render\n");
+		return 1;
+	}
+
+	massifg_graph_init();
+	graph = massifg_graph_new();
+
+	jobs = g_new0(RenderJob, num_files);
+	done = g_async_queue_new();
+	if (g_thread_supported()) {
+		pool = g_thread_pool_new(render_parse_job, done, RENDER_PARSE_THREADS, FALSE, NULL);
+	}
+
+	for (i=0; i<num_files; i++) {
+		/* Keep the pool busy, but do not parse too far ahead */
+		while (next < num_files && pending < (gint)RENDER_MAX_PENDING) {
+			jobs[next].filename = filenames[next];
+			if (pool)
+				g_thread_pool_push(pool, &jobs[next], NULL);
+			else
+				render_parse_job(&jobs[next], done);
+			next++;
+			pending++;
+		}
+
+		/* Render the files in the order they are parsed */
+		job = (RenderJob *)g_async_queue_pop(done);
+		pending--;
+		if (!job->data) {
+			g_printerr("Unable to parse file %s: %s\n", job->filename,
+				job->error ? job->error->message : "Unknown error");
+			g_clear_error(&job->error);
+			retval = 1;
+			continue;
+		}
+
+		/* The graph keeps its own reference, and drops the one to the previous file */
+		massifg_graph_set_data(graph, job->data);
+		massifg_output_data_unref(job->data);
+
+		output_name = render_output_name(output, job->filename, num_files);
+		if (!massifg_graph_render_to_file(graph, output_name, width, height, &error)) {
+			g_printerr("Unable to render %s: %s\n", output_name, error->message);
+			g_clear_error(&error);
+			retval = 1;
+		}
+		g_free(output_name);
+	}
+
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+	g_async_queue_unref(done);
+	g_free(jobs);
+
+	massifg_graph_free(graph);
+	return retval;
+}
+
+/* Stop loading a file, if one is being loaded.
+ * If the graph already shows what has been parsed, it is kept */
+static void
+massifg_application_load_stop(MassifgApplication *app) {
+	MassifgLoader *loader = app->loader;
+	MassifgOutputData *data = NULL;
+
+	if (!loader)
+		return;
+	app->loader = NULL;
+
+	if (loader->source_id) {
+		g_source_remove(loader->source_id);
+	}
+	if (loader->pid) {
+		/* Nobody will read what massif writes */
+		kill(loader->pid, SIGTERM);
+	}
+	if (loader->update_source_id) {
+		g_source_remove(loader->update_source_id);
+	}
+	if (loader->monitor) {
+		g_file_monitor_cancel(loader->monitor);
+		g_object_unref(G_OBJECT(loader->monitor));
+	}
+	if (loader->shown) {
+		/* The graph shows the data of the parser, so hand it over.
+		 * It is only shown once it has snapshots, so this can not fail */
+		data = massifg_parser_finish(loader->parser, NULL);
+		massifg_graph_set_data(app->graph, data);
+		massifg_output_data_unref(data);
+	}
+
+	massifg_parser_free(loader->parser);
+	g_io_channel_unref(loader->io_channel);
+	g_timer_destroy(loader->timer);
+	g_free(loader->filename);
+	g_free(loader);
+}
+
+/* Show the snapshots parsed so far in the graph, and measure how long it takes */
+static void
+massifg_application_load_update(MassifgApplication *app) {
+	MassifgLoader *loader = app->loader;
+	MassifgOutputData *data = massifg_parser_get_output_data(loader->parser);
+	GdkWindow *window = NULL;
+	gdouble start = g_timer_elapsed(loader->timer, NULL);
+
+	if (loader->update_source_id) {
+		g_source_remove(loader->update_source_id);
+		loader->update_source_id = 0;
+	}
+	if (!data->snapshots) {
+		/* Nothing to show yet */
+		return;
+	}
+
+	if (!loader->shown) {
+		massifg_graph_set_partial_data(app->graph, data);
+		loader->shown = TRUE;
+		g_free(app->filename);
+		app->filename = g_strdup(loader->filename);
+		g_signal_emit_by_name(app, "file-changed");
+	}
+	else {
+		massifg_graph_append_snapshots(app->graph);
+	}
+
+	/* Redraw now, so that the time it takes is part of the cost of the update */
+	window = gtk_widget_get_window(massifg_graph_get_widget(app->graph));
+	if (window) {
+		gdk_window_process_updates(window, TRUE);
+	}
+
+	loader->last_update = g_timer_elapsed(loader->timer, NULL);
+	loader->update_cost = loader->last_update - start;
+}
+
+/* Update the graph after waiting for the rate limit, as a GSourceFunc */
+static gboolean
+massifg_application_load_update_timeout(gpointer user_data) {
+	MassifgApplication *app = MASSIFG_APPLICATION(user_data);
+
+	app->loader->update_source_id = 0; /* Removed by returning FALSE */
+	massifg_application_load_update(app);
+	return FALSE;
+}
+
+/* Get the time until the graph may be updated again, in seconds */
+static gdouble
+massifg_application_load_update_wait(MassifgLoader *loader) {
+	gdouble interval = MAX(LOADER_MIN_UPDATE_INTERVAL, LOADER_UPDATE_COST_FACTOR*loader->update_cost);
+
+	return interval - (g_timer_elapsed(loader->timer, NULL) - loader->last_update);
+}
+
+/* Read and parse the next chunk of the file being loaded, as a GSourceFunc */
+static gboolean
+massifg_application_load_step(gpointer user_data) {
+	MassifgApplication *app = MASSIFG_APPLICATION(user_data);
+	MassifgLoader *loader = app->loader;
+	MassifgOutputData *data = NULL;
+	GError *error = NULL;
+	gchar *filename = NULL;
+	gsize bytes_read = 0;
+	gdouble wait;
+	GIOStatus io_status;
+
+	io_status = g_io_channel_read_chars(loader->io_channel, loader->buffer,
+				LOADER_CHUNK_SIZE, &bytes_read, &error);
+	massifg_parser_feed(loader->parser, loader->buffer, bytes_read);
+	loader->offset += bytes_read;
+
+	if (io_status == G_IO_STATUS_NORMAL) {
+		if (massifg_application_load_update_wait(loader) <= 0) {
+			massifg_application_load_update(app);
+		}
+		return TRUE;
+	}
+
+	if (io_status == G_IO_STATUS_AGAIN || (io_status == G_IO_STATUS_EOF && loader->monitor)) {
+		/* Everything written so far has been read. Show it, and wait for more */
+		wait = massifg_application_load_update_wait(loader);
+		if (wait <= 0) {
+			massifg_application_load_update(app);
+		}
+		else if (!loader->update_source_id) {
+			loader->update_source_id = g_timeout_add((guint)(wait*1000)+1,
+				massifg_application_load_update_timeout, app);
+		}
+
+		if (io_status == G_IO_STATUS_AGAIN) {
+			/* Wait for massif to write more to the pipe */
+			return TRUE;
+		}
+		/* Wait for the file to change */
+		loader->source_id = 0; /* Removed by returning FALSE */
+		return FALSE;
+	}
+	/* Massif closes the pipe when it is done */
+	loader->pid = 0;
+
+	/* Done. Files that were loaded before the first update are shown now */
+	if (io_status == G_IO_STATUS_EOF && !loader->shown) {
+		data = massifg_parser_finish(loader->parser, &error);
+		if (data) {
+			massifg_graph_set_data(app->graph, data);
+			massifg_output_data_unref(data);
+			g_free(app->filename);
+			app->filename = g_strdup(loader->filename);
+			g_signal_emit_by_name(app, "file-changed");
+		}
+	}
+
+	filename = g_strdup(loader->filename);
+	loader->source_id = 0; /* Removed by returning FALSE */
+	massifg_application_load_stop(app);
+
+	if (error) {
+		massifg_gtkui_errormsg(app, "Unable to parse file %s: %s", filename, error->message);
+		g_error_free(error);
+	}
+	g_free(filename);
+	return FALSE;
+}
+
+/* Read and parse what massif has written to the pipe, as a GIOFunc */
+static gboolean
+massifg_application_load_watch(GIOChannel *io_channel, GIOCondition condition, gpointer user_data) {
+	return massifg_application_load_step(user_data);
+}
+
+/* Create a loader reading from io_channel, showing it as filename */
+static MassifgLoader *
+massifg_application_loader_new(const gchar *filename, GIOChannel *io_channel) {
+	MassifgLoader *loader = g_new(MassifgLoader, 1);
+
+	loader->filename = g_strdup(filename);
+	loader->io_channel = io_channel;
+	loader->parser = massifg_parser_new(NULL);
+	loader->pid = 0;
+	loader->source_id = 0;
+	loader->update_source_id = 0;
+	loader->monitor = NULL;
+	loader->offset = 0;
+	loader->timer = g_timer_new();
+	loader->last_update = 0;
+	loader->update_cost = 0;
+	loader->shown = FALSE;
+
+	return loader;
+}
+
+/* Called when the file being followed changes.
+ * Only the bytes that were added since it was last read are parsed */
+static void
+massifg_application_followed_file_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+				GFileMonitorEvent event_type, gpointer user_data) {
+	MassifgApplication *app = MASSIFG_APPLICATION(user_data);
+	MassifgLoader *loader = app->loader;
+	GFileInfo *info = NULL;
+	gboolean rewritten = FALSE;
+	gchar *filename = NULL;
+
+	if (event_type == G_FILE_MONITOR_EVENT_CREATED) {
+		/* A new file replaced the one being read */
+		rewritten = TRUE;
+	}
+	else if (event_type == G_FILE_MONITOR_EVENT_CHANGED) {
+		/* A file that is now shorter than what has been read was written again from the start */
+		info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					G_FILE_QUERY_INFO_NONE, NULL, NULL);
+		rewritten = info && g_file_info_get_size(info) < loader->offset;
+		if (info) {
+			g_object_unref(G_OBJECT(info));
+		}
+	}
+	else {
+		return;
+	}
+
+	if (rewritten) {
+		filename = g_strdup(loader->filename);
+		massifg_application_load_file(app, filename, NULL);
+		g_free(filename);
+		return;
+	}
+
+	if (!loader->source_id) {
+		loader->source_id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, massifg_application_load_step, app, NULL);
+	}
+}
+
+/* Start following the file being loaded, if it can be monitored */
+static void
+massifg_application_load_follow(MassifgApplication *app) {
+	MassifgLoader *loader = app->loader;
+	GFile *file = NULL;
+
+	if (loader->monitor || loader->pid)
+		return;
+
+	file = g_file_new_for_path(loader->filename);
+	loader->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(G_OBJECT(file));
+
+	if (loader->monitor) {
+		g_signal_connect(loader->monitor, "changed",
+			G_CALLBACK(massifg_application_followed_file_changed), app);
+	}
+	if (!loader->source_id) {
+		/* Read what was added since the end of the file was reached */
+		loader->source_id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, massifg_application_load_step, app, NULL);
+	}
+}
+
 /* Initialize application data structure */
 static void
 massifg_application_init(MassifgApplication *self) {
@@ -65,6 +535,8 @@ massifg_application_init(MassifgApplication *self) {
 	self->graph = NULL;
 	self->filename = NULL;
 	self->gtk_builder = NULL;
+	self->loader = NULL;
+	self->follow = FALSE;
 }
 
 /* Free simple types */
@@ -79,9 +551,15 @@ static void
 massifg_application_dispose(GObject *gobject) {
 	MassifgApplication *app = MASSIFG_APPLICATION(gobject);
 
-	massifg_graph_free(app->graph);
+	massifg_application_load_stop(app);
 
+	/* Dispose can run more than once. There is no graph without a UI */
+	if (app->graph) {
+		massifg_graph_free(app->graph);
+		app->graph = NULL;
+	}
 	gobject_safe_unref(G_OBJECT(app->gtk_builder));
+	app->gtk_builder = NULL;
 }
 
 static void
@@ -144,21 +622,26 @@ massifg_application_free(MassifgApplication *app) {
  * @error: A place to return a #GError or %NULL
  * @Returns: %TRUE on success or %FALSE on failure
  *
- * Set the currently active file.
+ * Set the currently active file. The file is parsed completely before this
+ * returns, see massifg_application_load_file() for showing it while it is parsed.
  */
 gboolean
 massifg_application_set_file(MassifgApplication *app, const gchar *filename, GError **error) {
 	MassifgOutputData *new_data = NULL;
-	gchar *filename_copy = g_strdup(filename);
+	gchar *filename_copy = NULL;
 
 	g_return_val_if_fail(filename != NULL, FALSE);
 
+	massifg_application_load_stop(app);
+	filename_copy = g_strdup(filename);
+
 	/* Try to parse the file */
 	new_data = massifg_parse_file(filename_copy, error);
 
 	if (new_data) {
 		/* Parsing succeeded */
 		massifg_graph_set_data(app->graph, new_data);
+		massifg_output_data_unref(new_data);
 		g_free(app->filename);
 		app->filename = filename_copy;
 		g_signal_emit_by_name(app, "file-changed");
@@ -166,23 +649,242 @@ massifg_application_set_file(MassifgApplication *app, const gchar *filename, GEr
 	}
 
 	/* Parsing failed */
+	g_free(filename_copy);
 	return FALSE;
 }
 
+/**
+ * massifg_application_load_file:
+ * @app: A #MassifgApplication
+ * @filename: Path to the file to load. Will be copied internally
+ * @error: A place to return a #GError or %NULL
+ * @Returns: %TRUE if the file is being loaded, %FALSE if it could not be opened
+ *
+ * Set the currently active file, parsing it a piece at a time from the main loop.
+ * The graph shows the snapshots as they are parsed, and the UI stays responsive
+ * for large files. Errors while parsing are shown in an error dialog.
+ * Any file that was being loaded is stopped.
+ */
+gboolean
+massifg_application_load_file(MassifgApplication *app, const gchar *filename, GError **error) {
+	MassifgLoader *loader = NULL;
+	GIOChannel *io_channel = NULL;
+	MassifgTraceSpan span;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+
+	massifg_application_load_stop(app);
+
+	massifg_trace_begin(&span, "open");
+	io_channel = g_io_channel_new_file(filename, "r", error);
+	massifg_trace_end(&span);
+	if (!io_channel) {
+		return FALSE;
+	}
+	/* Read the bytes as they are, the parser splits them into lines */
+	g_io_channel_set_encoding(io_channel, NULL, NULL);
+
+	loader = massifg_application_loader_new(filename, io_channel);
+	/* Below the priority of redrawing, so that the UI stays responsive */
+	loader->source_id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, massifg_application_load_step, app, NULL);
+	app->loader = loader;
+
+	if (app->follow) {
+		massifg_application_load_follow(app);
+	}
+	return TRUE;
+}
+
+/**
+ * massifg_application_run_massif:
+ * @app: A #MassifgApplication
+ * @argv: %NULL-terminated array with the program to run under massif, and its arguments
+ * @error: A place to return a #GError or %NULL
+ * @Returns: %TRUE if massif was started, %FALSE on failure
+ *
+ * Run a program under massif, and show its output as the active file while it runs.
+ * The output is read from a pipe as massif writes it, see massifg_run_spawn().
+ * Any file that was being loaded is stopped, and stopping the run kills massif.
+ */
+gboolean
+massifg_application_run_massif(MassifgApplication *app, const gchar * const *argv, GError **error) {
+	MassifgLoader *loader = NULL;
+	GIOChannel *io_channel = NULL;
+	gchar *name = NULL;
+	GPid pid;
+
+	massifg_application_load_stop(app);
+
+	io_channel = massifg_run_spawn(argv, &pid, error);
+	if (!io_channel) {
+		return FALSE;
+	}
+
+	name = g_strdup_printf("massif %s", argv[0]);
+	loader = massifg_application_loader_new(name, io_channel);
+	loader->pid = pid;
+	loader->source_id = g_io_add_watch_full(io_channel, G_PRIORITY_DEFAULT_IDLE,
+				G_IO_IN | G_IO_HUP | G_IO_ERR, massifg_application_load_watch, app, NULL);
+	app->loader = loader;
+	g_free(name);
+	return TRUE;
+}
+
+/**
+ * massifg_application_set_follow:
+ * @app: A #MassifgApplication
+ * @follow: %TRUE to follow the active file
+ *
+ * Set whether the active file is followed, which is useful while massif is still
+ * writing it. The snapshots added to a followed file are shown as they are
+ * written, reading only the new part of the file each time it changes.
+ * A single file that was loaded completely is read again to follow it.
+ */
+void
+massifg_application_set_follow(MassifgApplication *app, gboolean follow) {
+	GError *error = NULL;
+	gchar *filename = NULL;
+
+	app->follow = follow;
+
+	if (app->loader) {
+		if (follow) {
+			massifg_application_load_follow(app);
+		}
+		else if (!app->loader->source_id) {
+			/* Done reading, it was only waiting for changes */
+			massifg_application_load_update(app);
+			massifg_application_load_stop(app);
+		}
+		else if (app->loader->monitor) {
+			g_file_monitor_cancel(app->loader->monitor);
+			g_object_unref(G_OBJECT(app->loader->monitor));
+			app->loader->monitor = NULL;
+		}
+	}
+	else if (follow && app->filename && !massifg_graph_get_datasets(app->graph)) {
+		filename = g_strdup(app->filename);
+		if (!massifg_application_load_file(app, filename, &error)) {
+			massifg_gtkui_errormsg(app, "Unable to open file %s: %s", filename, error->message);
+			g_error_free(error);
+		}
+		g_free(filename);
+	}
+}
+
+/**
+ * massifg_application_set_files:
+ * @app: A #MassifgApplication
+ * @filenames: %NULL-terminated array of paths to the files to compare
+ * @error: A place to return a #GError or %NULL
+ * @Returns: %TRUE on success or %FALSE on failure
+ *
+ * Set several files to compare as active. The files are parsed at the same time.
+ */
+gboolean
+massifg_application_set_files(MassifgApplication *app, const gchar * const *filenames, GError **error) {
+	GPtrArray *datasets = NULL;
+	gchar **basenames = NULL;
+	guint num_files = g_strv_length((gchar **)filenames);
+	guint i;
+
+	g_return_val_if_fail(num_files > 0, FALSE);
+
+	massifg_application_load_stop(app);
+	datasets = massifg_parse_files(filenames, error);
+	if (!datasets) {
+		return FALSE;
+	}
+
+	/* Name the lines in the graph after the files */
+	basenames = g_new0(gchar *, num_files+1);
+	for (i=0; i<num_files; i++) {
+		basenames[i] = g_path_get_basename(filenames[i]);
+	}
+	massifg_graph_set_datasets(app->graph, datasets, (const gchar * const *)basenames);
+
+	g_free(app->filename);
+	app->filename = g_strjoinv(", ", basenames);
+	g_strfreev(basenames);
+	g_signal_emit_by_name(app, "file-changed");
+	return TRUE;
+}
+
 /**
  * massifg_application_run:
  * @app: The #MassifgApplication to run
  * @Returns: The applications exit status. Non-zero indicates failure
  *
  * This function will block until the application quits. It is separate from main() so that the application can be tested more easily.
+ * With the --summary option, the files given on the command line are summarized
+ * to stdout without opening a window, see massifg_summarize_file().
+ * With the --render option, a graph of each file is rendered to an image
+ * file instead, see massifg_graph_render_to_file().
+ * The --memory-budget option sets the default memory budget of the parsers,
+ * see massifg_parser_set_memory_budget(), and the --union-tree option has them
+ * build the union call tree, see massifg_parser_set_build_union_tree().
  */
 gint
 massifg_application_run(MassifgApplication *app) {
 	GError *error = NULL;
 	gchar *filename = NULL;
+	GOptionContext *context = NULL;
+	gboolean summary = FALSE;
+	gchar *render = NULL;
+	gchar *size = NULL;
+	gint memory_budget_MB = 0;
+	gboolean union_tree = FALSE;
+	gint retval = 0;
+	GOptionEntry entries[] = {
+		{ "summary", 's', 0, G_OPTION_ARG_NONE, &summary,
+		  "Print the peak and the largest allocators at the peak of each file, without opening a window", NULL },
+		{ "render", 'r', 0, G_OPTION_ARG_FILENAME, &render,
+		  "Render a graph of each file to OUTPUT without opening a window. "
+		  "The format is chosen by the extension: .png, .svg or .pdf. "
+		  "With several files, the name of each file is added before the extension", "OUTPUT" },
+		{ "size", 0, 0, G_OPTION_ARG_STRING, &size,
+		  "Size of the rendered graphs, default 2000x1000", "WIDTHxHEIGHT" },
+		{ "memory-budget", 'm', 0, G_OPTION_ARG_INT, &memory_budget_MB,
+		  "Keep the heap trees of each file within MB megabytes of memory, "
+		  "spilling the rest to a temporary file. Default is no limit", "MB" },
+		{ "union-tree", 'u', 0, G_OPTION_ARG_NONE, &union_tree,
+		  "Merge the heap trees of each file into one call tree while parsing, "
+		  "so that the detailed view does not need to go through every heap tree", NULL },
+		{ NULL }
+	};
 
 	/* Setup */
 	massifg_utils_configure_debug_output();
+	massifg_trace_init();
+
+	context = g_option_context_new("[FILE...] - view massif output");
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_add_group(context, gtk_get_option_group(FALSE));
+	if (!g_option_context_parse(context, app->argc_ptr, app->argv_ptr, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return 1;
+	}
+	g_option_context_free(context);
+	if (memory_budget_MB > 0) {
+		massifg_parser_set_default_memory_budget((gsize)memory_budget_MB*1024*1024);
+	}
+	massifg_parser_set_default_build_union_tree(union_tree);
+
+	/* Headless modes */
+	if (summary) {
+		retval = massifg_application_run_summary(&(*app->argv_ptr)[1], *app->argc_ptr-1);
+	}
+	else if (render) {
+		retval = massifg_application_run_render(render, size, &(*app->argv_ptr)[1], *app->argc_ptr-1);
+	}
+	g_free(size);
+	if (summary || render) {
+		g_free(render);
+		return retval;
+	}
+
 	massifg_graph_init();
 
 	/* Create the UI */
@@ -195,12 +897,19 @@ massifg_application_run(MassifgApplication *app) {
 	if (*app->argc_ptr == 2) {
 		filename = (*app->argv_ptr)[1];
 
-		if (!massifg_application_set_file(app, filename, &error)) {
-			massifg_gtkui_errormsg(app, "Unable to parse file %s: %s",
+		if (!massifg_application_load_file(app, filename, &error)) {
+			massifg_gtkui_errormsg(app, "Unable to open file %s: %s",
 					filename, error->message);
 			g_error_free(error);
 		}
 	}
+	else if (*app->argc_ptr > 2) {
+		/* Several files, compare them */
+		if (!massifg_application_set_files(app, (const gchar * const *)&(*app->argv_ptr)[1], &error)) {
+			massifg_gtkui_errormsg(app, "Unable to parse files: %s", error->message);
+			g_error_free(error);
+		}
+	}
 
 	/* Present the UI and hand over control to the gtk mainloop */
 	massifg_gtkui_start(app);
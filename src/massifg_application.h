@@ -67,6 +67,8 @@ struct _MassifgApplication {
 	gchar *filename;
 	MassifgGraph *graph;
 	GtkBuilder *gtk_builder;
+	struct _MassifgLoader *loader; /* File being loaded, see massifg_application_load_file() */
+	gboolean follow;
 };
 
 /**
@@ -89,6 +91,10 @@ MassifgApplication *massifg_application_new(int *argc_ptr, char ***argv_ptr);
 void massifg_application_free(MassifgApplication *app);
 
 gboolean massifg_application_set_file(MassifgApplication *app, const gchar *filename, GError **error);
+gboolean massifg_application_load_file(MassifgApplication *app, const gchar *filename, GError **error);
+void massifg_application_set_follow(MassifgApplication *app, gboolean follow);
+gboolean massifg_application_run_massif(MassifgApplication *app, const gchar * const *argv, GError **error);
+gboolean massifg_application_set_files(MassifgApplication *app, const gchar * const *filenames, GError **error);
 gint massifg_application_run(MassifgApplication *app);
 
 #endif /* MASSIFG_APPLICATION_H__ */
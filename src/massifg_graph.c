@@ -34,19 +34,45 @@
  * The "detailed" mode shows an area plot, which is broken down
  * to show how different functions contribute to the heap memory usage
  * for each snapshot. Currently only the first children of the heap tree is displayed
- * in detailed mode
+ * in detailed mode. The functions shown can be limited to those whose label contains
+ * a string with massifg_graph_set_label_filter(), and they can be summed by shared
+ * object, source file or namespace with massifg_graph_set_group_by().
+ *
+ * When several outputs are compared with massifg_graph_set_datasets(), the graph
+ * instead shows a line for the total memory usage of each of them, on a common
+ * time axis. With massifg_graph_set_align_time(), the time axis is the percentage
+ * of each run instead, so that runs of different length can be compared.
+ *
+ * Output that is still being parsed can be shown with massifg_graph_set_partial_data(),
+ * and massifg_graph_append_snapshots() adds the snapshots parsed since.
+ *
+ * The widget showing the graph is only created when massifg_graph_get_widget()
+ * is called, so a graph can be rendered to a file with massifg_graph_render_to_file()
+ * without a display.
  */
 
+#include <string.h>
+
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
 #include <glib.h>
 #include <goffice/goffice.h>
+#include "config.h"
 
 #include "massifg_graph.h"
 #include "massifg_graph_private.h"
 
 #include "massifg_utils.h"
 #include "massifg_parser.h"
+#include "massifg_trace.h"
 
 /* Data structures */
+#define MASSIFG_GRAPH_ERROR g_quark_from_string("MASSIFG_GRAPH_ERROR")
+static const gint MASSIFG_GRAPH_ERROR_FORMAT = 1;
+static const gint MASSIFG_GRAPH_ERROR_RENDER = 2;
+
+/* The GOffice plugins providing GogAreaPlot and GogXYPlot, the only plots used */
+static const gchar *MASSIFG_GRAPH_PLUGINS[] = {"GOffice_plot_barcol", "GOffice_plot_xy"};
 
 /**
  * MassifgDataSeries:
@@ -116,7 +142,25 @@ data_from_snapshots(GList *snapshots, MassifgDataSeries series) {
 
 	g_list_foreach((gpointer)snapshots, fill_data_array_func, (gpointer)&foreach_arg);
 	g_assert_cmpint(foreach_arg.index, ==, length);
-	return go_data_vector_val_new(array, length, NULL);
+	return go_data_vector_val_new(array, length, g_free);
+}
+
+/* Append the values of series for snapshots to a vector from data_from_snapshots() */
+static void
+append_data_from_snapshots(GOData *vector, GList *snapshots, guint length, MassifgDataSeries series) {
+	GODataVectorVal *vector_val = (GODataVectorVal *)vector;
+	FillDataArrayFuncArg foreach_arg;
+
+	foreach_arg.series = series;
+	foreach_arg.data_array = g_renew(gdouble, (gdouble *)vector_val->val, vector_val->n + length);
+	foreach_arg.index = vector_val->n;
+
+	g_list_foreach((gpointer)snapshots, fill_data_array_func, (gpointer)&foreach_arg);
+	g_assert_cmpint(foreach_arg.index, ==, vector_val->n + length);
+
+	vector_val->val = foreach_arg.data_array;
+	vector_val->n = foreach_arg.index;
+	go_data_emit_changed(vector);
 }
 
 /* Utility function to add a serie to the plot */
@@ -143,192 +187,110 @@ massifg_graph_update_simple(MassifgGraph *graph) {
 		GOData *time_data = data_from_snapshots(graph->data->snapshots,	MASSIFG_DATA_SERIES_TIME);
 
 		massifg_graph_add_series(graph, series_name, time_data, series_data);
-	}
-}
 
-/* 
- * Currently shortens by stripping the function arguments of overloaded C++
- * functions.
- * Example: "std::string::_Rep::_S_create(unsigned int, unsigned int, std::allocator<char> const&) (in /usr/lib/libstdc++.so.6.0.13)" -> "std::string::_Rep::_S_create (in /usr/lib/libstdc++.so.6.0.13)"
- * Result should be freed with g_free */
-gchar *
-massifg_graph_get_short_function_label(const gchar *label) {
-	gchar *short_label = NULL;
-	guint args_start_idx;
-	guint args_end_idx;
-
-	if (massifg_str_count_char(label, '(') == 1) {
-		/* No need to shorten */
-		short_label = g_strdup(label);
-		return short_label;
+		/* Keep the vectors, so that snapshots parsed later can be appended to them */
+		g_ptr_array_add(graph->simple_vectors, g_object_ref(time_data));
+		g_ptr_array_add(graph->simple_vectors, g_object_ref(series_data));
 	}
-
-	args_start_idx = (guint)(g_strstr_len(label, -1, "(")-label);
-	args_end_idx = (guint)(g_strstr_len(label, -1, ")")-label);
-
-	short_label = massifg_str_cut_region(label, args_start_idx, args_end_idx);
-
-	return short_label;
+	graph->last_snapshot_shown = g_list_last(graph->data->snapshots);
 }
 
-typedef struct {
-	MassifgGraph *graph;
-	GList *snapshot_details;
-} AddDetailsSerieArg;
-
-/* Add a single detailed data series, as specified by key */
-static void
-add_details_serie_foreach(gpointer data, gpointer user_data) {
-	gchar *label = (gchar *)data;
-	AddDetailsSerieArg *arg = (AddDetailsSerieArg *)user_data;
-	MassifgGraph *graph = arg->graph;
-	GOData *series_data, *time_data, *series_name;
-
-	/* Get the actual data series */
-	GList *l = arg->snapshot_details;
-	GHashTable *functions = NULL;
-	gint i = 0;
-	const gint length = g_list_length(l);
-
-	gdouble *array = g_new(double, length);
-
-	while (l) {
-		functions = (GHashTable *)l->data;
-		array[i] = GPOINTER_TO_INT(g_hash_table_lookup(functions, label));
-		l = l->next;
-		i++;
+/* Get the heap usage of the allocation sites grouped as set for the graph.
+ * Without a label filter the result is cached, so that switching between the
+ * groupings only needs to compute each of them once.
+ * The result is owned by graph if cached is set to TRUE */
+static MassifgGroupedUsage *
+massifg_graph_get_grouped_usage(MassifgGraph *graph, gboolean *cached) {
+	MassifgGroupedUsage *usage = NULL;
+	gboolean *label_matches = NULL;
+	GArray *matches = NULL;
+	guint i;
+
+	if (!graph->label_filter) {
+		*cached = TRUE;
+		if (!graph->grouped_usage[graph->group_by]) {
+			graph->grouped_usage[graph->group_by] =
+				massifg_analysis_group_usage(graph->data, graph->group_by, NULL);
+		}
+		return graph->grouped_usage[graph->group_by];
 	}
-	series_data = go_data_vector_val_new(array, length, NULL);
-	time_data = data_from_snapshots(graph->data->snapshots,	MASSIFG_DATA_SERIES_TIME);
-	series_name = go_data_scalar_str_new(massifg_graph_get_short_function_label(label), TRUE);
-
-	/* Add it to the graph */
-	massifg_graph_add_series(graph, series_name, time_data, series_data);
-}
-
-/**
- * AddDetailsArg:
- * @function_labels: A table over all the functions in a #MassifgOutputData, and
- * how many #MassifgSnapshot they appear in
- * @functions_sorted: A sorted list of the keys in @function_labels
- * @functions: A temporary table over the functions and their memory usage in a single #MassifgSnapshot
- *
- *
- */
-typedef struct {
-	GHashTable *functions;
-	GHashTable *function_labels;
-	GList *functions_sorted;
-} AddDetailsArg;
-
-/* Adds function values */
-static void
-add_details_foreach(GNode *node, gpointer user_data) {
-	gboolean exists = FALSE;
-	gpointer value = 0;
-	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
-	AddDetailsArg *arg = (AddDetailsArg *)user_data;
-	gchar *label_str = n->label->str;
 
-	/* Note: key is not copied and value is trucated to 32bit */
-	g_hash_table_insert(arg->functions, label_str, GINT_TO_POINTER(n->total_mem_B));
-
-	exists = g_hash_table_lookup_extended(arg->function_labels, label_str, NULL, &value);
-	if (exists) {
-		g_hash_table_insert(arg->function_labels, label_str,
-				GINT_TO_POINTER(GPOINTER_TO_INT(value)+1));
-	}
-	else {
-		g_hash_table_insert(arg->function_labels, label_str, GINT_TO_POINTER(0));
+	/* Only include the allocation sites that match the filter
+	 * The data might still be growing, so index the labels added since last time first */
+	massifg_label_index_update(graph->data->label_index);
+	matches = massifg_label_index_search(graph->data->label_index, graph->label_filter);
+	label_matches = g_new0(gboolean, massifg_label_table_size(graph->data->labels));
+	for (i=0; i<matches->len; i++) {
+		label_matches[g_array_index(matches, guint, i)] = TRUE;
 	}
-}
+	g_array_free(matches, TRUE);
 
-/**
- * sort_func_label:
- * @a: a value
- * @b: a value to compare with
- * @user_data: user data
- * @Returns: +1 if function @a appears in less snapshots than @b,
- * -1 if function @a appears in more snapshots than @b and 0
- * if @a appears in as many as @b
- *
- * A #GCompareDataFunc to sort snapshots.
- */
-static gint
-sort_func_label(gconstpointer a, gconstpointer b, gpointer user_data) {
-	GHashTable *function_labels = (GHashTable *)user_data;
-
-	gchar *label_a = (gchar *)a;
-	gchar *label_b = (gchar *)b;
-	int value_a = GPOINTER_TO_INT(g_hash_table_lookup(function_labels, label_a));
-	int value_b = GPOINTER_TO_INT(g_hash_table_lookup(function_labels, label_b));
-
-	if (value_a == value_b)	return 0;
-	if (value_a < value_b) return +1;
-	if (value_a > value_b) return -1;
-	g_assert_not_reached();
+	usage = massifg_analysis_group_usage(graph->data, graph->group_by, label_matches);
+	g_free(label_matches);
+	*cached = FALSE;
+	return usage;
 }
 
-/* Sort the functions according to how many snapshots they appear in
- * This allows short-lived functions to be on top of the graph, and long-lived
- * ones on the bottom, which leads to a less confusing graph */
+/* Drop the cached grouped heap usage */
 static void
-sort_details_serie_foreach(gpointer key, gpointer value, gpointer user_data) {
-	AddDetailsArg *arg = (AddDetailsArg *)user_data;
+massifg_graph_clear_grouped_usage(MassifgGraph *graph) {
+	MassifgGroupBy group_by;
 
-	arg->functions_sorted = g_list_insert_sorted_with_data(
-			arg->functions_sorted, key, sort_func_label,
-			arg->function_labels);
+	for (group_by=0; group_by<MASSIFG_GROUP_BY_LAST; group_by++) {
+		if (graph->grouped_usage[group_by]) {
+			massifg_analysis_grouped_usage_free(graph->grouped_usage[group_by]);
+			graph->grouped_usage[group_by] = NULL;
+		}
+	}
 }
 
-/* Build datastructures for the functions we want to show */
+/* Drop the reference to the data, and all the datasets if several are compared */
 static void
-build_function_tables(GList *snapshots, GList **snapshot_details, AddDetailsArg *arg) {
-	MassifgSnapshot *s = NULL;
-	GHashTable *ht = NULL;
-	GList *l = snapshots;
-
-	while (l) {
-		s = (MassifgSnapshot *)l->data;
-		ht = g_hash_table_new(g_str_hash, g_str_equal);
-		*snapshot_details = g_list_append(*snapshot_details, ht);
-		arg->functions = ht;
-
-		/* Note: we only look at the direct children of the root, because that
-		 * is the behaviour that ms_print and massif_grapher has */
-		if (s->heap_tree) {
-			g_node_children_foreach(s->heap_tree, G_TRAVERSE_ALL,
-				add_details_foreach, (gpointer)arg);
-		}
-		l = l->next;
+massifg_graph_clear_datasets(MassifgGraph *graph) {
+	if (graph->datasets) {
+		/* Releases graph->data too */
+		g_ptr_array_free(graph->datasets, TRUE);
+		g_strfreev(graph->dataset_names);
+		graph->datasets = NULL;
+		graph->dataset_names = NULL;
 	}
+	else if (graph->data) {
+		massifg_output_data_unref(graph->data);
+	}
+	graph->data = NULL;
+	graph->data_is_partial = FALSE;
 }
 
 /* Adds all the detailed data series to graph
- * The graph should have been cleared for data series before this is called */
+ * The graph should have been cleared for data series before this is called
+ * Note: we only look at the direct children of the root, because that
+ * is the behaviour that ms_print and massif_grapher has.
+ * The groups that appear in the most snapshots are added first. This allows
+ * short-lived functions to be on top of the graph, and long-lived
+ * ones on the bottom, which leads to a less confusing graph */
 static void
 massifg_graph_update_detailed(MassifgGraph *graph) {
-	/* TODO: these two helper structures should probably be joined into one */
-	AddDetailsSerieArg add_dserie_arg;
-	AddDetailsArg add_d_arg;
+	MassifgGroupedUsage *usage = NULL;
+	GOData *series_data, *time_data, *series_name;
+	gdouble *values = NULL;
+	gboolean cached = FALSE;
+	guint i;
 
-	GHashTable *function_labels = g_hash_table_new(g_str_hash, g_str_equal);
-	GList *snapshot_details = NULL;
+	usage = massifg_graph_get_grouped_usage(graph, &cached);
 
-	/* Build the datastructures neccesary for this view */
-	add_d_arg.function_labels = function_labels;
-	add_d_arg.functions_sorted = NULL;
-	add_d_arg.functions = NULL;
-	build_function_tables(graph->data->snapshots, &snapshot_details, &add_d_arg);
-	g_hash_table_foreach(function_labels, sort_details_serie_foreach, (gpointer)&add_d_arg);
+	for (i=0; i<usage->series->len; i++) {
+		/* The vector takes ownership of its values, so give it a copy of the cached ones */
+		values = g_memdup(g_ptr_array_index(usage->series, i), usage->num_snapshots*sizeof(gdouble));
+		series_data = go_data_vector_val_new(values, usage->num_snapshots, g_free);
+		time_data = data_from_snapshots(graph->data->snapshots,	MASSIFG_DATA_SERIES_TIME);
+		series_name = go_data_scalar_str_new(g_strdup(g_ptr_array_index(usage->names, i)), TRUE);
 
-	/* Create and add the series to the graph */
-	add_dserie_arg.graph = graph;
-	add_dserie_arg.snapshot_details = snapshot_details;
-	g_list_foreach(add_d_arg.functions_sorted, add_details_serie_foreach, (gpointer)&add_dserie_arg);
+		massifg_graph_add_series(graph, series_name, time_data, series_data);
+	}
 
-	/* FIXME: free snapshot_details */
-	g_hash_table_destroy(function_labels);
+	if (!cached) {
+		massifg_analysis_grouped_usage_free(usage);
+	}
 }
 
 static void
@@ -341,7 +303,10 @@ massifg_graph_add_axis_labels(MassifgGraph *graph) {
 	gchar *time_unit = graph->data->time_unit->str;
 
 	/* Get X axis label string */
-	if (g_ascii_strcasecmp(time_unit, "ms") == 0) {
+	if (graph->datasets && graph->align_time) {
+		x_axis_str = "Time (in percent of each run)";
+	}
+	else if (g_ascii_strcasecmp(time_unit, "ms") == 0) {
 		x_axis_str = "Execution time (in milliseconds)";
 	}
 	else if (g_ascii_strcasecmp(time_unit,"i") == 0) {
@@ -360,10 +325,11 @@ massifg_graph_add_axis_labels(MassifgGraph *graph) {
 
 	label = gog_object_get_child_by_name(GOG_OBJECT(axis), "Label");
 	if (!label) {
-		label_data = go_data_scalar_str_new(x_axis_str, FALSE);
 		label = gog_object_add_by_name(GOG_OBJECT (axis), "Label", NULL);
-		gog_dataset_set_dim (GOG_DATASET (label), 0, label_data, NULL);
 	}
+	/* The text depends on whether the time is aligned, so always set it */
+	label_data = go_data_scalar_str_new(x_axis_str, FALSE);
+	gog_dataset_set_dim (GOG_DATASET (label), 0, label_data, NULL);
 
 	/* Add Y axis label */
 	axis = gog_plot_get_axis(graph->plot, GOG_AXIS_Y);
@@ -378,18 +344,153 @@ massifg_graph_add_axis_labels(MassifgGraph *graph) {
 
 }
 
+/* Show plot in the chart instead of the current plot
+ * The graph keeps a reference to each plot, and the chart to the one it shows */
+static void
+massifg_graph_use_plot(MassifgGraph *graph, GogPlot *plot) {
+	if (graph->plot == plot)
+		return;
+
+	if (graph->plot) {
+		gog_plot_clear_series(graph->plot);
+		gog_object_clear_parent(GOG_OBJECT(graph->plot));
+		g_object_unref(G_OBJECT(graph->plot));
+	}
+	g_object_ref(G_OBJECT(plot));
+	gog_object_add_by_name(GOG_OBJECT (graph->chart), "Plot", GOG_OBJECT(plot));
+	graph->plot = plot;
+}
+
+/* Adds a line with the total memory usage of each dataset to the graph
+ * The graph should have been cleared for data series before this is called */
+static void
+massifg_graph_update_comparison(MassifgGraph *graph) {
+	MassifgOutputData *data = NULL;
+	MassifgSnapshot *snapshot = NULL;
+	GOData *series_data, *time_data, *series_name;
+	gdouble *times, *totals;
+	GList *l = NULL;
+	guint i, j, length;
+
+	for (i=0; i<graph->datasets->len; i++) {
+		data = (MassifgOutputData *)g_ptr_array_index(graph->datasets, i);
+		length = g_list_length(data->snapshots);
+		times = g_new(gdouble, length);
+		totals = g_new(gdouble, length);
+
+		for (l = data->snapshots, j = 0; l; l = l->next, j++) {
+			snapshot = (MassifgSnapshot *)l->data;
+			times[j] = (gdouble)snapshot->time;
+			if (graph->align_time) {
+				times[j] = data->max_time > 0 ? 100.0*times[j]/data->max_time : 0;
+			}
+			totals[j] = (gdouble)(snapshot->mem_heap_B + snapshot->mem_heap_extra_B +
+					snapshot->mem_stacks_B);
+		}
+
+		time_data = go_data_vector_val_new(times, length, g_free);
+		series_data = go_data_vector_val_new(totals, length, g_free);
+		series_name = go_data_scalar_str_new(g_strdup(graph->dataset_names[i]), TRUE);
+		massifg_graph_add_series(graph, series_name, time_data, series_data);
+	}
+}
+
 static void
 massifg_graph_update(MassifgGraph *graph) {
+	MassifgTraceSpan span;
+
+	massifg_trace_begin(&span, "series");
+	/* Comparisons need a plot where each series has its own time values */
+	if (graph->datasets) {
+		if (!graph->xy_plot) {
+			graph->xy_plot = (GogPlot *)gog_plot_new_by_name("GogXYPlot");
+			g_object_set(G_OBJECT(graph->xy_plot), "default-style-has-markers", FALSE, NULL);
+		}
+		massifg_graph_use_plot(graph, graph->xy_plot);
+	}
+	else {
+		massifg_graph_use_plot(graph, graph->area_plot);
+	}
+
 	/* Update the data series */
-	gog_plot_clear_series(graph->plot); /* TODO: verify that we are not responsible for freeing */
+	gog_plot_clear_series(graph->plot); /* Unrefs the series, which own their data */
+	g_ptr_array_set_size(graph->simple_vectors, 0);
+	graph->last_snapshot_shown = NULL;
 
-	if (graph->detailed) {
+	if (graph->datasets) {
+		massifg_graph_update_comparison(graph);
+	}
+	else if (graph->detailed) {
 		massifg_graph_update_detailed(graph);
 	}
 	else {
 		massifg_graph_update_simple(graph);
 	}
 	massifg_graph_add_axis_labels(graph);
+	massifg_trace_end(&span);
+	MASSIFG_NOTE(GRAPH, g_debug("Showing %u data series",
+		g_slist_length((GSList *)gog_plot_get_series(graph->plot))));
+}
+
+/* Render the graph to surface, and finish writing it.
+ * Image surfaces are written to png_filename, other surfaces write to their file themselves */
+static gboolean
+massifg_graph_render_to_surface(MassifgGraph *graph, cairo_surface_t *surface,
+				const gchar *png_filename, const guint width, const guint height,
+				GError **error) {
+	cairo_t *cr = cairo_create(surface);
+	cairo_status_t status = CAIRO_STATUS_SUCCESS;
+	gboolean rendered;
+
+	rendered = massifg_graph_render_to_cairo(graph, cr, width, height);
+	cairo_destroy(cr);
+	if (!rendered) {
+		g_set_error_literal(error, MASSIFG_GRAPH_ERROR, MASSIFG_GRAPH_ERROR_RENDER,
+			"Rendering graph failed");
+		return FALSE;
+	}
+
+	if (png_filename) {
+		status = cairo_surface_write_to_png(surface, png_filename);
+	}
+	else {
+		cairo_surface_finish(surface);
+		status = cairo_surface_status(surface);
+	}
+	if (status != CAIRO_STATUS_SUCCESS) {
+		g_set_error_literal(error, MASSIFG_GRAPH_ERROR, MASSIFG_GRAPH_ERROR_RENDER,
+			cairo_status_to_string(status));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Add the memory stats of data to stats. The labels table is left out
+ * unless count_labels is set, for tables that have been counted already */
+static void
+massifg_graph_add_memory_stats(MassifgMemoryStats *stats, MassifgOutputData *data, gboolean count_labels) {
+	MassifgMemoryStats data_stats;
+
+	massifg_output_data_get_memory_stats(data, &data_stats);
+	if (!count_labels) {
+		data_stats.labels_B -= massifg_label_table_get_memory_size(data->labels);
+		data_stats.num_labels = 0;
+	}
+
+	stats->num_snapshots += data_stats.num_snapshots;
+	stats->snapshots_B += data_stats.snapshots_B;
+	stats->num_nodes += data_stats.num_nodes;
+	stats->nodes_B += data_stats.nodes_B;
+	stats->num_node_refs += data_stats.num_node_refs;
+	stats->num_links += data_stats.num_links;
+	stats->links_B += data_stats.links_B;
+	stats->num_labels += data_stats.num_labels;
+	stats->num_label_refs += data_stats.num_label_refs;
+	stats->labels_B += data_stats.labels_B;
+	stats->num_spilled_trees += data_stats.num_spilled_trees;
+	stats->spill_file_B += data_stats.spill_file_B;
+	stats->num_union_nodes += data_stats.num_union_nodes;
+	stats->union_tree_B += data_stats.union_tree_B;
 }
 
 /* Public functions */
@@ -398,12 +499,23 @@ massifg_graph_update(MassifgGraph *graph) {
  * massifg_graph_init:
  *
  * Initialize what is neccesary to use the graph.
+ * Only the GOffice plugins for the plots the graph uses are activated,
+ * the others are never loaded.
  * Note: Must be called before the first call to massifg_graph_new() 
  */
 void
 massifg_graph_init(void) {
+	GSList *plugins = NULL;
+	guint i;
+
 	libgoffice_init();
-	go_plugins_init(NULL, NULL, NULL, NULL, TRUE, GO_TYPE_PLUGIN_LOADER_MODULE);
+
+	for (i=0; i<G_N_ELEMENTS(MASSIFG_GRAPH_PLUGINS); i++) {
+		plugins = g_slist_prepend(plugins, (gpointer)MASSIFG_GRAPH_PLUGINS[i]);
+	}
+	/* All other plugins are new, and stay inactive */
+	go_plugins_init(NULL, plugins, plugins, NULL, FALSE, GO_TYPE_PLUGIN_LOADER_MODULE);
+	g_slist_free(plugins);
 }
 
 /**
@@ -414,8 +526,6 @@ massifg_graph_init(void) {
  */
 MassifgGraph *
 massifg_graph_new(void) {
-	GogChart *chart = NULL;
-
 	MassifgGraph *graph = (MassifgGraph *)g_malloc(sizeof(MassifgGraph));
 
 	/* Initialize members */
@@ -424,16 +534,30 @@ massifg_graph_new(void) {
 
 	graph->has_legend = FALSE;
 	graph->detailed = FALSE;
-
-	/* Create a graph widget, and get the embedded graph and chart */
-	graph->widget = go_graph_widget_new(NULL);
-	chart = go_graph_widget_get_chart(GO_GRAPH_WIDGET(graph->widget));
-
-	/* Create a plot and add it to the chart */
-	graph->plot = (GogPlot *)gog_plot_new_by_name("GogAreaPlot");
-	g_object_set (G_OBJECT (graph->plot), "type", "stacked", NULL);
-
-	gog_object_add_by_name(GOG_OBJECT (chart), "Plot", GOG_OBJECT(graph->plot));
+	graph->label_filter = NULL;
+	graph->group_by = MASSIFG_GROUP_BY_FUNCTION;
+	memset(graph->grouped_usage, 0, sizeof(graph->grouped_usage));
+
+	graph->data_is_partial = FALSE;
+	graph->last_snapshot_shown = NULL;
+	graph->simple_vectors = g_ptr_array_new_with_free_func(g_object_unref);
+
+	graph->datasets = NULL;
+	graph->dataset_names = NULL;
+	graph->align_time = FALSE;
+
+	/* Create a graph with a chart. The widget is created when it is first needed */
+	graph->widget = NULL;
+	graph->go_graph = (GogGraph *)g_object_new(GOG_TYPE_GRAPH, NULL);
+	graph->chart = (GogChart *)gog_object_add_by_name(GOG_OBJECT(graph->go_graph), "Chart", NULL);
+
+	/* Create a plot and add it to the chart
+	 * The plot for comparisons is created when it is first needed */
+	graph->plot = NULL;
+	graph->xy_plot = NULL;
+	graph->area_plot = (GogPlot *)gog_plot_new_by_name("GogAreaPlot");
+	g_object_set (G_OBJECT (graph->area_plot), "type", "stacked", NULL);
+	massifg_graph_use_plot(graph, graph->area_plot);
 
 	/* Set default settings */
 	massifg_graph_set_show_details(graph, FALSE);
@@ -446,11 +570,23 @@ massifg_graph_new(void) {
  * massifg_graph_free:
  * @graph: A #MassifgGraph
  *
- * Free a #MassifgGraph.
+ * Free a #MassifgGraph, and the data it shows. The widget from
+ * massifg_graph_get_widget() is owned by its container, and keeps
+ * what it draws alive until it is destroyed.
  */
 void massifg_graph_free(MassifgGraph *graph) {
-
-	/* FIXME: actually free the stuff used by graph */
+	massifg_graph_clear_grouped_usage(graph);
+	massifg_graph_clear_datasets(graph);
+	g_free(graph->label_filter);
+	g_ptr_array_free(graph->simple_vectors, TRUE);
+	g_clear_error(&graph->error);
+
+	/* The chart holds a reference to the plot it shows, and the graph one to each plot */
+	g_object_unref(G_OBJECT(graph->go_graph)); /* The widget has its own reference */
+	g_object_unref(G_OBJECT(graph->area_plot));
+	if (graph->xy_plot) {
+		g_object_unref(G_OBJECT(graph->xy_plot));
+	}
 	g_free(graph);
 }
 
@@ -459,17 +595,137 @@ void massifg_graph_free(MassifgGraph *graph) {
  * @graph: A #MassifgGraph
  * @data: #MassifgOutputData to visualize in graph
  *
- * Set the data to visualize.
+ * Set the data to visualize. The graph keeps its own reference to it, so
+ * the same data can be shown by several graphs.
+ * If @data was set with massifg_graph_set_partial_data(), the snapshots not
+ * shown yet are added.
  */
 void 
 massifg_graph_set_data(MassifgGraph *graph, MassifgOutputData *data) {
-	if (graph->data) {
-		massifg_output_data_free(graph->data);
+	if (graph->data_is_partial && graph->data == data) {
+		massifg_graph_append_snapshots(graph);
+		graph->data_is_partial = FALSE;
+		return;
 	}
+	/* Reference first, the graph might hold the last reference to data */
+	massifg_output_data_ref(data);
+	massifg_graph_clear_grouped_usage(graph);
+	massifg_graph_clear_datasets(graph);
 	graph->data = data;
 	massifg_graph_update(graph);
 }
 
+/**
+ * massifg_graph_set_partial_data:
+ * @graph: A #MassifgGraph
+ * @data: #MassifgOutputData that is still being parsed, for instance from massifg_parser_get_output_data()
+ *
+ * Show output data while it is being parsed. The graph keeps a reference to @data.
+ * Call massifg_graph_append_snapshots() to show the snapshots that are
+ * parsed later, and massifg_graph_set_data() with the same @data once it is complete.
+ */
+void
+massifg_graph_set_partial_data(MassifgGraph *graph, MassifgOutputData *data) {
+	massifg_output_data_ref(data);
+	massifg_graph_clear_grouped_usage(graph);
+	massifg_graph_clear_datasets(graph);
+	graph->data = data;
+	graph->data_is_partial = TRUE;
+	massifg_graph_update(graph);
+}
+
+/**
+ * massifg_graph_append_snapshots:
+ * @graph: A #MassifgGraph
+ *
+ * Show the snapshots that have been appended to the data of the graph since it
+ * was last updated. In the simple view only the new snapshots are added to the
+ * existing data series, so the cost is proportional to the number of new snapshots.
+ * The detailed view is computed again.
+ */
+void
+massifg_graph_append_snapshots(MassifgGraph *graph) {
+	GList *snapshots = NULL;
+	MassifgTraceSpan span;
+	guint length, i;
+
+	g_return_if_fail(graph->data != NULL);
+
+	snapshots = graph->last_snapshot_shown ? graph->last_snapshot_shown->next : graph->data->snapshots;
+	if (!snapshots)
+		return;
+
+	if (graph->datasets || graph->detailed || graph->simple_vectors->len == 0) {
+		massifg_graph_clear_grouped_usage(graph);
+		massifg_graph_update(graph);
+		return;
+	}
+
+	massifg_trace_begin(&span, "series");
+	length = g_list_length(snapshots);
+	for (i=0; i<graph->simple_vectors->len; i+=2) {
+		append_data_from_snapshots(g_ptr_array_index(graph->simple_vectors, i),
+			snapshots, length, MASSIFG_DATA_SERIES_TIME);
+		append_data_from_snapshots(g_ptr_array_index(graph->simple_vectors, i+1),
+			snapshots, length, MASSIFG_DATA_SERIES_HEAP + i/2);
+	}
+	graph->last_snapshot_shown = g_list_last(snapshots);
+	massifg_trace_end(&span);
+}
+
+/**
+ * massifg_graph_set_datasets:
+ * @graph: A #MassifgGraph
+ * @datasets: #GPtrArray of #MassifgOutputData to compare, for instance from massifg_parse_files().
+ * The graph takes ownership of it, and of the references it holds
+ * @names: %NULL-terminated array with a name for each of @datasets, shown in the legend.
+ * Will be copied internally
+ *
+ * Set several outputs to compare. The graph shows the total memory usage of each of them.
+ * The first one is also the data returned by massifg_graph_get_data().
+ */
+void
+massifg_graph_set_datasets(MassifgGraph *graph, GPtrArray *datasets, const gchar * const *names) {
+	g_return_if_fail(datasets->len > 0);
+	g_return_if_fail(g_strv_length((gchar **)names) == datasets->len);
+
+	massifg_graph_clear_grouped_usage(graph);
+	massifg_graph_clear_datasets(graph);
+	graph->datasets = datasets;
+	graph->dataset_names = g_strdupv((gchar **)names);
+	graph->data = (MassifgOutputData *)g_ptr_array_index(datasets, 0);
+	massifg_graph_update(graph);
+}
+
+/**
+ * massifg_graph_get_datasets:
+ * @graph: A #MassifgGraph
+ * @Returns: #GPtrArray of the #MassifgOutputData being compared, or %NULL if
+ * the graph is not comparing several outputs. Owned by @graph
+ *
+ * Get the outputs set with massifg_graph_set_datasets().
+ */
+GPtrArray *
+massifg_graph_get_datasets(MassifgGraph *graph) {
+	return graph->datasets;
+}
+
+/**
+ * massifg_graph_set_align_time:
+ * @graph: A #MassifgGraph
+ * @align_time: %TRUE to show time as a percentage of each run, %FALSE to show the time itself
+ *
+ * Set whether the outputs being compared are aligned, so that they all start
+ * and end at the same place on the time axis.
+ */
+void
+massifg_graph_set_align_time(MassifgGraph *graph, gboolean align_time) {
+	graph->align_time = align_time;
+	if (graph->datasets) {
+		massifg_graph_update(graph);
+	}
+}
+
 
 /**
  * massifg_graph_set_show_details:
@@ -497,15 +753,14 @@ massifg_graph_set_show_details(MassifgGraph *graph, gboolean show_details) {
 void
 massifg_graph_set_show_legend(MassifgGraph *graph, gboolean show_legend) {
 	GogObject *gog_object = NULL;
-	GogChart *chart = go_graph_widget_get_chart(GO_GRAPH_WIDGET(graph->widget));
 
 	if (show_legend && !graph->has_legend) {
-		gog_object_add_by_name(GOG_OBJECT(chart), "Legend", NULL);
+		gog_object_add_by_name(GOG_OBJECT(graph->chart), "Legend", NULL);
 	}
 
 	if (!show_legend) {
 		/* Remove existing legend, if any */
-		gog_object = gog_object_get_child_by_name(GOG_OBJECT(chart), "Legend");
+		gog_object = gog_object_get_child_by_name(GOG_OBJECT(graph->chart), "Legend");
 		if (gog_object) {
 			gog_object_clear_parent(gog_object);
 			g_object_unref(G_OBJECT(gog_object));
@@ -515,22 +770,64 @@ massifg_graph_set_show_legend(MassifgGraph *graph, gboolean show_legend) {
 	graph->has_legend = show_legend;
 }
 
+/**
+ * massifg_graph_set_label_filter:
+ * @graph: A #MassifgGraph
+ * @filter: Only show the functions whose label contains this string, ignoring case.
+ * %NULL or an empty string shows all functions
+ *
+ * Limit the functions shown in the detailed graph view.
+ */
+void
+massifg_graph_set_label_filter(MassifgGraph *graph, const gchar *filter) {
+	gchar *old_filter = graph->label_filter;
+
+	graph->label_filter = (filter && *filter) ? g_strdup(filter) : NULL;
+	g_free(old_filter);
+
+	if (graph->data && graph->detailed) {
+		massifg_graph_update(graph);
+	}
+}
+
+/**
+ * massifg_graph_set_group_by:
+ * @graph: A #MassifgGraph
+ * @group_by: How to sum the heap usage in the detailed graph view
+ *
+ * Set whether the detailed graph view shows each function, or the functions
+ * summed by shared object, source file or namespace.
+ */
+void
+massifg_graph_set_group_by(MassifgGraph *graph, MassifgGroupBy group_by) {
+	g_return_if_fail(group_by < MASSIFG_GROUP_BY_LAST);
+
+	graph->group_by = group_by;
+	if (graph->data && graph->detailed) {
+		massifg_graph_update(graph);
+	}
+}
+
 /**
  * massifg_graph_get_widget:
  * @graph: A #MassifgGraph
  * @Returns: The #GtkWidget that displays the graph
  *
- * Get the widget that displays the graph.
+ * Get the widget that displays the graph. It is created on the first call.
  */
 GtkWidget *
 massifg_graph_get_widget(MassifgGraph *graph) {
+	if (!graph->widget) {
+		graph->widget = go_graph_widget_new(graph->go_graph);
+	}
 	return graph->widget;
 }
 
 /**
  * massifg_graph_get_data:
  * @graph: A #MassifgGraph
- * @Returns: the #MassifgOutputData the graph is visualizing
+ * @Returns: the #MassifgOutputData the graph is visualizing. The graph holds
+ * the reference, use massifg_output_data_ref() to keep it after the graph changes
  *
  * Get the data the graph visualizes.
  */
@@ -539,6 +836,61 @@ MassifgOutputData
 	return graph->data;
 }
 
+/**
+ * massifg_graph_get_memory_stats:
+ * @graph: A #MassifgGraph
+ * @stats: The #MassifgMemoryStats to fill in
+ *
+ * Estimate the memory used by the data the graph shows, as
+ * massifg_output_data_get_memory_stats() does, and by the data series made from it.
+ * When comparing files, the numbers for all of them are added up, counting a
+ * shared #MassifgLabelTable once.
+ */
+void
+massifg_graph_get_memory_stats(MassifgGraph *graph, MassifgMemoryStats *stats) {
+	MassifgOutputData *data = NULL;
+	MassifgGroupedUsage *usage = NULL;
+	MassifgGroupBy group_by;
+	GSList const *series = NULL;
+	GOData *vector = NULL;
+	guint i, dim;
+
+	memset(stats, 0, sizeof(MassifgMemoryStats));
+
+	if (graph->datasets) {
+		for (i=0; i<graph->datasets->len; i++) {
+			data = (MassifgOutputData *)g_ptr_array_index(graph->datasets, i);
+			massifg_graph_add_memory_stats(stats, data,
+					i == 0 || data->labels != graph->data->labels);
+		}
+	}
+	else if (graph->data) {
+		massifg_graph_add_memory_stats(stats, graph->data, TRUE);
+	}
+
+	/* The values of the series in the plot */
+	for (series = gog_plot_get_series(graph->plot); series; series = series->next) {
+		stats->num_series++;
+		for (dim=0; dim<2; dim++) {
+			vector = gog_dataset_get_dim(GOG_DATASET(series->data), dim);
+			if (vector && GO_IS_DATA_VECTOR(vector)) {
+				stats->series_B += go_data_vector_get_len(GO_DATA_VECTOR(vector))*sizeof(gdouble);
+			}
+		}
+	}
+
+	/* The cached values of the detailed view */
+	for (group_by=0; group_by<MASSIFG_GROUP_BY_LAST; group_by++) {
+		usage = graph->grouped_usage[group_by];
+		if (usage) {
+			stats->series_B += usage->series->len*(usage->num_snapshots*sizeof(gdouble) + sizeof(gpointer));
+		}
+	}
+
+	stats->total_B = stats->snapshots_B + stats->nodes_B + stats->links_B
+		+ stats->labels_B + stats->union_tree_B + stats->series_B;
+}
+
 /**
  * massifg_graph_render_to_cairo:
  * @graph: A #MassifgGraph to render
@@ -552,12 +904,14 @@ MassifgOutputData
 gboolean
 massifg_graph_render_to_cairo(MassifgGraph *graph, cairo_t *cr,
 				const guint width, const guint height) {
+	MassifgTraceSpan span;
 	gboolean retval;
 
-	GogGraph *go_graph = go_graph_widget_get_graph(GO_GRAPH_WIDGET(graph->widget));
-	GogRenderer *renderer = gog_renderer_new(go_graph);
+	GogRenderer *renderer = gog_renderer_new(graph->go_graph);
 
+	massifg_trace_begin(&span, "render");
 	retval = gog_renderer_render_to_cairo(renderer, cr, width, height);
+	massifg_trace_end(&span);
 	g_object_unref(G_OBJECT(renderer));
 	return retval;
 }
@@ -576,16 +930,54 @@ massifg_graph_render_to_cairo(MassifgGraph *graph, cairo_t *cr,
 gboolean
 massifg_graph_render_to_png(MassifgGraph *graph, const gchar *filename, const guint width, const guint height) {
 	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
-	cairo_t *cr = cairo_create(surface);
+	gboolean retval;
 
-	if (!massifg_graph_render_to_cairo(graph, cr, width, height)) {
-		return FALSE;
+	/* TODO: propagate error up to caller */
+	retval = massifg_graph_render_to_surface(graph, surface, filename, width, height, NULL);
+	cairo_surface_destroy(surface);
+	return retval;
+}
+
+/**
+ * massifg_graph_render_to_file:
+ * @graph: A #MassifgGraph to render
+ * @filename: Path to file to render to. Will be created if not existing,
+ * or overwritten if existing. The format is chosen by the extension,
+ * which must be .png, .svg or .pdf
+ * @width: width of the rendered output, in pixels for PNG and in points otherwise
+ * @height: height of the rendered output
+ * @error: Location to store a #GError or %NULL
+ * @Returns: %TRUE on success, %FALSE on failure
+ *
+ * Render the graph to a PNG, SVG or PDF file. This does not need a display.
+ */
+gboolean
+massifg_graph_render_to_file(MassifgGraph *graph, const gchar *filename,
+				const guint width, const guint height, GError **error) {
+	cairo_surface_t *surface = NULL;
+	gchar *folded_filename = g_ascii_strdown(filename, -1);
+	const gchar *png_filename = NULL;
+	gboolean retval;
+
+	if (g_str_has_suffix(folded_filename, ".png")) {
+		surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+		png_filename = filename;
+	}
+	else if (g_str_has_suffix(folded_filename, ".svg")) {
+		surface = cairo_svg_surface_create(filename, width, height);
+	}
+	else if (g_str_has_suffix(folded_filename, ".pdf")) {
+		surface = cairo_pdf_surface_create(filename, width, height);
 	}
+	g_free(folded_filename);
 
-	/* TODO: propagate error up to caller */
-	if (cairo_surface_write_to_png(surface, filename) != CAIRO_STATUS_SUCCESS) {
+	if (!surface) {
+		g_set_error(error, MASSIFG_GRAPH_ERROR, MASSIFG_GRAPH_ERROR_FORMAT,
+			"Unknown file format for %s, use .png, .svg or .pdf", filename);
 		return FALSE;
 	}
 
-	return TRUE;
+	retval = massifg_graph_render_to_surface(graph, surface, png_filename, width, height, error);
+	cairo_surface_destroy(surface);
+	return retval;
 }
@@ -36,6 +36,7 @@
 #include <glib.h>
 
 #include "massifg_parser.h"
+#include "massifg_analysis.h"
 
 #ifndef MASSIFG_GRAPH_H__
 #define MASSIFG_GRAPH_H__
@@ -51,12 +52,27 @@ typedef struct {
 	/*< private >*/
 	MassifgOutputData *data;
 	GtkWidget *widget;
+	GogGraph *go_graph;
+	GogChart *chart;
 	GError *error;
 
 	gboolean detailed;
 	gboolean has_legend;
+	gchar *label_filter;
+	MassifgGroupBy group_by;
+	MassifgGroupedUsage *grouped_usage[MASSIFG_GROUP_BY_LAST];
+
+	gboolean data_is_partial;
+	GList *last_snapshot_shown;
+	GPtrArray *simple_vectors;
+
+	GPtrArray *datasets;
+	gchar **dataset_names;
+	gboolean align_time;
 
 	GogPlot *plot;
+	GogPlot *area_plot;
+	GogPlot *xy_plot;
 } MassifgGraph;
 
 /* Public functions */
@@ -66,13 +82,23 @@ MassifgGraph *massifg_graph_new(void);
 void massifg_graph_free(MassifgGraph *graph);
 
 void massifg_graph_set_data(MassifgGraph *graph, MassifgOutputData *data);
+void massifg_graph_set_partial_data(MassifgGraph *graph, MassifgOutputData *data);
+void massifg_graph_append_snapshots(MassifgGraph *graph);
+void massifg_graph_set_datasets(MassifgGraph *graph, GPtrArray *datasets, const gchar * const *names);
+GPtrArray *massifg_graph_get_datasets(MassifgGraph *graph);
+void massifg_graph_set_align_time(MassifgGraph *graph, gboolean align_time);
 void massifg_graph_set_show_details(MassifgGraph *graph, gboolean show_details);
 void massifg_graph_set_show_legend(MassifgGraph *graph, gboolean show_legend);
+void massifg_graph_set_label_filter(MassifgGraph *graph, const gchar *filter);
+void massifg_graph_set_group_by(MassifgGraph *graph, MassifgGroupBy group_by);
 
 GtkWidget *massifg_graph_get_widget(MassifgGraph *graph);
 MassifgOutputData *massifg_graph_get_data(MassifgGraph *graph);
+void massifg_graph_get_memory_stats(MassifgGraph *graph, MassifgMemoryStats *stats);
 
 gboolean massifg_graph_render_to_cairo(MassifgGraph *graph, cairo_t *cr, const guint width, const guint height);
 gboolean massifg_graph_render_to_png(MassifgGraph *graph, const gchar *filename, const guint width, const guint height);
+gboolean massifg_graph_render_to_file(MassifgGraph *graph, const gchar *filename,
+				const guint width, const guint height, GError **error);
 
 #endif /* MASSIFG_GRAPH_H__ */
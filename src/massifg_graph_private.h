@@ -2,6 +2,5 @@
 #ifndef MASSIFG_GRAPH_PRIVATE_H__
 #define MASSIFG_GRAPH_PRIVATE_H__
 
-gchar *massifg_graph_get_short_function_label(const gchar *label);
 
 #endif /* MASSIFG_GRAPH_PRIVATE_H__ */
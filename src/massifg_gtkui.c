@@ -33,12 +33,42 @@
 #include "massifg_application.h"
 #include "massifg_gtkui.h"
 #include "massifg_graph.h"
-#include "massifg_utils.h"
+#include "massifg_analysis.h"
+#include "massifg_heap_tree_model.h"
+#include "massifg_gtkui_definitions.h"
 
 static const gchar MAIN_WINDOW_VBOX[] = "mainvbox";
 static const gchar OPEN_DIALOG[] = "openfiledialog";
 static const gchar SAVE_DIALOG[] = "savefiledialog";
 static const gchar MAIN_WINDOW_MENU[] = "/MainMenu";
+static const gchar GRAPH_PLACEHOLDER[] = "massifg-graph-placeholder";
+
+/* The number of call sites to show in the leaks dialog */
+static const guint LEAKS_MAX_SITES = 50;
+
+enum {
+	LEAKS_COLUMN_LABEL,
+	LEAKS_COLUMN_SLOPE,
+	LEAKS_COLUMN_R_SQUARED,
+	LEAKS_COLUMN_LAST,
+	LEAKS_COLUMN_PEAK,
+	LEAKS_N_COLUMNS
+};
+
+enum {
+	DELTAS_COLUMN_FUNCTION,
+	DELTAS_COLUMN_BEFORE,
+	DELTAS_COLUMN_AFTER,
+	DELTAS_COLUMN_DELTA,
+	DELTAS_N_COLUMNS
+};
+
+enum {
+	STATS_COLUMN_WHAT,
+	STATS_COLUMN_OBJECTS,
+	STATS_COLUMN_MEMORY,
+	STATS_N_COLUMNS
+};
 
 /* Private functions */
 static void
@@ -68,6 +98,37 @@ print_op_draw_page(GtkPrintOperation *operation,
 
 }
 
+/* Show a double column in a tree view with a fixed number of decimals */
+static void
+leaks_double_cell_data(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell,
+		GtkTreeModel *tree_model, GtkTreeIter *iter, gpointer data) {
+	gint column = GPOINTER_TO_INT(data);
+	gdouble value;
+	gchar *text = NULL;
+
+	gtk_tree_model_get(tree_model, iter, column, &value, -1);
+	text = g_strdup_printf("%.3f", value);
+	g_object_set(G_OBJECT(cell), "text", text, NULL);
+	g_free(text);
+}
+
+/* Add a text column to a tree view in one of the dialogs. The model must be set,
+ * since double columns are shown with leaks_double_cell_data() */
+static void
+dialog_add_column(GtkTreeView *tree_view, const gchar *title, gint column) {
+	GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+	GtkTreeModel *model = gtk_tree_view_get_model(tree_view);
+
+	if (gtk_tree_model_get_column_type(model, column) == G_TYPE_DOUBLE) {
+		gtk_tree_view_insert_column_with_data_func(tree_view, -1, title, renderer,
+				leaks_double_cell_data, GINT_TO_POINTER(column), NULL);
+	}
+	else {
+		gtk_tree_view_insert_column_with_attributes(tree_view, -1, title, renderer,
+				"text", column, NULL);
+	}
+}
+
 /* Signal handlers */
 /* Destroy event handler for the main window, hooked up though glade/gtkbuilder */
 /* This is not static, because GtkBuilder needs to find. */
@@ -87,32 +148,61 @@ mainwindow_update_title(MassifgApplication *app, gpointer user_data) {
 	}
 }
 
+/* Replace the placeholder with the graph widget when the first file has been loaded.
+ * Creating the widget is then not part of the startup time */
+static void
+mainwindow_show_graph(MassifgApplication *app, gpointer user_data) {
+	GtkWidget *vbox = NULL;
+	GtkWidget *placeholder = NULL;
+	GtkWidget *graph_widget = NULL;
+	gint position = 0;
+
+	vbox = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, MAIN_WINDOW_VBOX));
+	placeholder = GTK_WIDGET (g_object_get_data(G_OBJECT(vbox), GRAPH_PLACEHOLDER));
+	if (!placeholder) {
+		return;
+	}
+
+	gtk_container_child_get(GTK_CONTAINER(vbox), placeholder, "position", &position, NULL);
+	gtk_widget_destroy(placeholder);
+	g_object_set_data(G_OBJECT(vbox), GRAPH_PLACEHOLDER, NULL);
+
+	graph_widget = massifg_graph_get_widget(app->graph);
+	gtk_box_pack_start(GTK_BOX (vbox), graph_widget, TRUE, TRUE, 1);
+	gtk_box_reorder_child(GTK_BOX (vbox), graph_widget, position);
+	gtk_widget_show(graph_widget);
+}
+
 /* Actions */
 static void
 quit_action(GtkAction *action, gpointer data) {
 	mainwindow_destroy(NULL, NULL);
 }
 
-static void
-open_file_action(GtkAction *action, gpointer data) {
-	static gboolean buttons_added = FALSE;
-	GError *error = NULL;
-	GtkWidget *open_dialog = NULL;
-	MassifgApplication *app = (MassifgApplication *)data;
-	gchar *filename = NULL;
-
-	open_dialog = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, OPEN_DIALOG));
+/* Get the open dialog, adding the reponse buttons, but only once */
+static GtkWidget *
+get_open_dialog(MassifgApplication *app) {
+	GtkWidget *open_dialog = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, OPEN_DIALOG));
 
-	/* Add the reponse buttons, but only once */
 	/* NOTE: It does not seem that there is a way to add this using the Glade UI,
 	 * and have gtkbuilder set it up, which would have been nicer */
-	if (!buttons_added) {
+	if (!gtk_dialog_get_widget_for_response(GTK_DIALOG(open_dialog), GTK_RESPONSE_OK)) {
 		gtk_dialog_add_buttons(GTK_DIALOG(open_dialog),
 				GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
 				GTK_STOCK_OPEN, GTK_RESPONSE_OK,
 				NULL);
-		buttons_added = TRUE;
 	}
+	return open_dialog;
+}
+
+static void
+open_file_action(GtkAction *action, gpointer data) {
+	GError *error = NULL;
+	GtkWidget *open_dialog = NULL;
+	MassifgApplication *app = (MassifgApplication *)data;
+	gchar *filename = NULL;
+
+	open_dialog = get_open_dialog(app);
 
 	/* Run the dialog, get the chosen filename */
 	if (gtk_dialog_run(GTK_DIALOG(open_dialog)) == GTK_RESPONSE_OK) {
@@ -125,11 +215,97 @@ open_file_action(GtkAction *action, gpointer data) {
 		return;
 	}
 
-	if (!massifg_application_set_file(app, filename, &error)) {
-		massifg_gtkui_errormsg(app, "Unable to parse file %s: %s",
+	if (!massifg_application_load_file(app, filename, &error)) {
+		massifg_gtkui_errormsg(app, "Unable to open file %s: %s",
 				filename, error->message);
 		g_error_free(error);
 	}
+	g_free(filename);
+}
+
+/* Let the user enter a command, and run it under massif */
+static void
+run_massif_action(GtkAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+	GError *error = NULL;
+	GtkWidget *dialog = NULL;
+	GtkWidget *entry = NULL;
+	GtkWidget *label = NULL;
+	GtkWidget *hbox = NULL;
+	GtkWindow *main_window = NULL;
+	gchar **argv = NULL;
+	gint response;
+
+	main_window = GTK_WINDOW(gtk_builder_get_object(app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
+	dialog = gtk_dialog_new_with_buttons("Run Massif", main_window,
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_EXECUTE, GTK_RESPONSE_OK,
+			NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
+
+	label = gtk_label_new_with_mnemonic("_Command:");
+	entry = gtk_entry_new();
+	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+	gtk_entry_set_width_chars(GTK_ENTRY(entry), 50);
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label), entry);
+	hbox = gtk_hbox_new(FALSE, 6);
+	gtk_container_set_border_width(GTK_CONTAINER(hbox), 6);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			hbox, TRUE, TRUE, 0);
+
+	gtk_widget_show_all(dialog);
+	response = gtk_dialog_run(GTK_DIALOG(dialog));
+	if (response == GTK_RESPONSE_OK &&
+	    g_shell_parse_argv(gtk_entry_get_text(GTK_ENTRY(entry)), NULL, &argv, &error)) {
+		massifg_application_run_massif(app, (const gchar * const *)argv, &error);
+		g_strfreev(argv);
+	}
+	gtk_widget_destroy(dialog);
+
+	if (error) {
+		massifg_gtkui_errormsg(app, "Unable to run massif: %s", error->message);
+		g_error_free(error);
+	}
+}
+
+/* Let the user choose several files, and compare them */
+static void
+compare_files_action(GtkAction *action, gpointer data) {
+	GError *error = NULL;
+	GtkWidget *open_dialog = NULL;
+	MassifgApplication *app = (MassifgApplication *)data;
+	GSList *filenames = NULL;
+	GSList *l = NULL;
+	gchar **filenames_array = NULL;
+	guint i;
+
+	open_dialog = get_open_dialog(app);
+	gtk_file_chooser_set_select_multiple(GTK_FILE_CHOOSER(open_dialog), TRUE);
+	if (gtk_dialog_run(GTK_DIALOG(open_dialog)) == GTK_RESPONSE_OK) {
+		filenames = gtk_file_chooser_get_filenames(GTK_FILE_CHOOSER(open_dialog));
+	}
+	gtk_file_chooser_set_select_multiple(GTK_FILE_CHOOSER(open_dialog), FALSE);
+	gtk_widget_hide(open_dialog);
+
+	if (!filenames) {
+		/* User did not select any files */
+		return;
+	}
+
+	filenames_array = g_new0(gchar *, g_slist_length(filenames)+1);
+	for (l = filenames, i = 0; l; l = l->next, i++) {
+		filenames_array[i] = (gchar *)l->data;
+	}
+	if (!massifg_application_set_files(app, (const gchar * const *)filenames_array, &error)) {
+		massifg_gtkui_errormsg(app, "Unable to parse files: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_strfreev(filenames_array); /* Frees the filenames in the list */
+	g_slist_free(filenames);
 }
 
 static void
@@ -140,7 +316,10 @@ save_file_action(GtkAction *action, gpointer data) {
 	static gboolean buttons_added = FALSE;
 	GtkWidget *save_dialog = NULL;
 	MassifgApplication *app = (MassifgApplication *)data;
+	GError *error = NULL;
 	gchar *filename = NULL;
+	gchar *folded_filename = NULL;
+	gchar *tmp = NULL;
 
 	save_dialog = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, SAVE_DIALOG));
 
@@ -159,12 +338,25 @@ save_file_action(GtkAction *action, gpointer data) {
 	}
 	gtk_widget_hide(save_dialog);
 
-	/* TODO: add .png to filename if not existing */
-	if (filename) {
-		if (!massifg_graph_render_to_png(app->graph, filename, width, height)) {
-			massifg_gtkui_errormsg(app, "%s", "Error: Could not save PNG file");
-		}
+	if (!filename) {
+		return;
+	}
+
+	/* Save as PNG unless SVG or PDF was asked for */
+	folded_filename = g_ascii_strdown(filename, -1);
+	if (!g_str_has_suffix(folded_filename, ".png") && !g_str_has_suffix(folded_filename, ".svg") &&
+	    !g_str_has_suffix(folded_filename, ".pdf")) {
+		tmp = filename;
+		filename = g_strconcat(tmp, ".png", NULL);
+		g_free(tmp);
+	}
+	g_free(folded_filename);
+
+	if (!massifg_graph_render_to_file(app->graph, filename, width, height, &error)) {
+		massifg_gtkui_errormsg(app, "Could not save the graph: %s", error->message);
+		g_error_free(error);
 	}
+	g_free(filename);
 }
 
 static void
@@ -198,6 +390,419 @@ print_action(GtkAction *action, gpointer data) {
 	g_object_unref (print_op);
 }
 
+/* Present the call sites that are most likely to leak memory */
+static void
+leaks_action(GtkAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+	MassifgOutputData *output_data = massifg_graph_get_data(app->graph);
+	MassifgLeakSite *site = NULL;
+	GList *leak_sites = NULL;
+	GList *l = NULL;
+	GtkListStore *store = NULL;
+	GtkTreeIter iter;
+	GtkWidget *dialog = NULL;
+	GtkWidget *scrolled_window = NULL;
+	GtkWidget *tree_view = NULL;
+	GtkWindow *main_window = NULL;
+
+	if (!output_data) {
+		massifg_gtkui_errormsg(app, "%s", "No file is loaded");
+		return;
+	}
+
+	/* Find the leaks and fill a list model with them */
+	leak_sites = massifg_analysis_find_leaks(output_data, LEAKS_MAX_SITES);
+	store = gtk_list_store_new(LEAKS_N_COLUMNS, G_TYPE_STRING, G_TYPE_DOUBLE,
+			G_TYPE_DOUBLE, G_TYPE_INT64, G_TYPE_INT64);
+	for (l = leak_sites; l; l = l->next) {
+		site = (MassifgLeakSite *)l->data;
+		gtk_list_store_append(store, &iter);
+		gtk_list_store_set(store, &iter,
+			LEAKS_COLUMN_LABEL, site->label,
+			LEAKS_COLUMN_SLOPE, site->slope,
+			LEAKS_COLUMN_R_SQUARED, site->r_squared,
+			LEAKS_COLUMN_LAST, site->last_mem_B,
+			LEAKS_COLUMN_PEAK, site->peak_mem_B,
+			-1);
+	}
+
+	tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Call site", LEAKS_COLUMN_LABEL);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Growth (bytes per time unit)", LEAKS_COLUMN_SLOPE);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "R²", LEAKS_COLUMN_R_SQUARED);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Last (bytes)", LEAKS_COLUMN_LAST);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Peak (bytes)", LEAKS_COLUMN_PEAK);
+
+	/* Present it in a dialog */
+	main_window = GTK_WINDOW(gtk_builder_get_object(app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
+	dialog = gtk_dialog_new_with_buttons("Likely Leaks", main_window,
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+			NULL);
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 900, 500);
+
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), tree_view);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			scrolled_window, TRUE, TRUE, 0);
+
+	gtk_widget_show_all(dialog);
+	gtk_dialog_run(GTK_DIALOG(dialog));
+
+	/* Cleanup */
+	gtk_widget_destroy(dialog);
+	g_object_unref(store);
+	massifg_analysis_leaks_free(leak_sites);
+}
+
+/* Add a row to the list in the statistics dialog. objects is freed */
+static void
+stats_add_row(GtkListStore *store, const gchar *what, gchar *objects, guint64 size_B) {
+	GtkTreeIter iter;
+	gchar *memory = g_format_size_for_display(size_B);
+
+	gtk_list_store_append(store, &iter);
+	gtk_list_store_set(store, &iter,
+		STATS_COLUMN_WHAT, what,
+		STATS_COLUMN_OBJECTS, objects,
+		STATS_COLUMN_MEMORY, memory,
+		-1);
+	g_free(objects);
+	g_free(memory);
+}
+
+/* Show what the memory of the loaded data is used for */
+static void
+stats_action(GtkAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+	MassifgMemoryStats stats;
+	GtkListStore *store = NULL;
+	GtkWidget *dialog = NULL;
+	GtkWidget *tree_view = NULL;
+	GtkWindow *main_window = NULL;
+
+	if (!massifg_graph_get_data(app->graph)) {
+		massifg_gtkui_errormsg(app, "%s", "No file is loaded");
+		return;
+	}
+
+	massifg_graph_get_memory_stats(app->graph, &stats);
+	store = gtk_list_store_new(STATS_N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+	stats_add_row(store, "Snapshots",
+		g_strdup_printf("%" G_GUINT64_FORMAT, stats.num_snapshots), stats.snapshots_B);
+	stats_add_row(store, "Heap tree nodes",
+		g_strdup_printf("%" G_GUINT64_FORMAT " (%" G_GUINT64_FORMAT " in the trees)",
+			stats.num_nodes, stats.num_node_refs), stats.nodes_B);
+	stats_add_row(store, "Tree links",
+		g_strdup_printf("%" G_GUINT64_FORMAT, stats.num_links), stats.links_B);
+	stats_add_row(store, "Labels",
+		g_strdup_printf("%" G_GUINT64_FORMAT " unique (%" G_GUINT64_FORMAT " uses)",
+			stats.num_labels, stats.num_label_refs), stats.labels_B);
+	if (stats.num_union_nodes) {
+		stats_add_row(store, "Union call tree",
+			g_strdup_printf("%" G_GUINT64_FORMAT " call paths", stats.num_union_nodes),
+			stats.union_tree_B);
+	}
+	stats_add_row(store, "Graph series",
+		g_strdup_printf("%" G_GUINT64_FORMAT, stats.num_series), stats.series_B);
+	stats_add_row(store, "Total", g_strdup(""), stats.total_B);
+	if (stats.spill_file_B) {
+		/* On disk, not in the total */
+		stats_add_row(store, "Spill file",
+			g_strdup_printf("%" G_GUINT64_FORMAT " heap trees not in memory", stats.num_spilled_trees),
+			stats.spill_file_B);
+	}
+
+	tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "",
+			gtk_cell_renderer_text_new(), "text", STATS_COLUMN_WHAT, NULL);
+	gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "Objects",
+			gtk_cell_renderer_text_new(), "text", STATS_COLUMN_OBJECTS, NULL);
+	gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view), -1, "Memory",
+			gtk_cell_renderer_text_new(), "text", STATS_COLUMN_MEMORY, NULL);
+
+	/* Present it in a dialog */
+	main_window = GTK_WINDOW(gtk_builder_get_object(app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
+	dialog = gtk_dialog_new_with_buttons("Statistics", main_window,
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+			NULL);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			tree_view, TRUE, TRUE, 0);
+
+	gtk_widget_show_all(dialog);
+	gtk_dialog_run(GTK_DIALOG(dialog));
+
+	/* Cleanup */
+	gtk_widget_destroy(dialog);
+	g_object_unref(store);
+}
+
+/* Filter the functions in the detailed graph by the text in the search box */
+static void
+search_entry_changed(GtkEditable *editable, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+
+	massifg_graph_set_label_filter(app->graph, gtk_entry_get_text(GTK_ENTRY(editable)));
+}
+
+static void
+group_by_action(GtkRadioAction *action, GtkRadioAction *current, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+
+	massifg_graph_set_group_by(app->graph, (MassifgGroupBy)gtk_radio_action_get_current_value(current));
+}
+
+/* Present how the memory usage of each allocation function changed
+ * between the peaks of the first two files being compared */
+static void
+peak_deltas_action(GtkAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+	GPtrArray *datasets = massifg_graph_get_datasets(app->graph);
+	MassifgFunctionDelta *delta = NULL;
+	GList *deltas = NULL;
+	GList *l = NULL;
+	GtkListStore *store = NULL;
+	GtkTreeIter iter;
+	GtkWidget *dialog = NULL;
+	GtkWidget *scrolled_window = NULL;
+	GtkWidget *tree_view = NULL;
+	GtkWindow *main_window = NULL;
+
+	if (!datasets || datasets->len < 2) {
+		massifg_gtkui_errormsg(app, "%s", "Open two or more files with Compare Files first");
+		return;
+	}
+
+	deltas = massifg_analysis_compare_peaks(g_ptr_array_index(datasets, 0),
+				g_ptr_array_index(datasets, 1));
+	store = gtk_list_store_new(DELTAS_N_COLUMNS, G_TYPE_STRING, G_TYPE_INT64,
+			G_TYPE_INT64, G_TYPE_INT64);
+	for (l = deltas; l; l = l->next) {
+		delta = (MassifgFunctionDelta *)l->data;
+		gtk_list_store_append(store, &iter);
+		gtk_list_store_set(store, &iter,
+			DELTAS_COLUMN_FUNCTION, delta->function,
+			DELTAS_COLUMN_BEFORE, delta->before_B,
+			DELTAS_COLUMN_AFTER, delta->after_B,
+			DELTAS_COLUMN_DELTA, delta->delta_B,
+			-1);
+	}
+
+	tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Allocation function", DELTAS_COLUMN_FUNCTION);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "First file (bytes)", DELTAS_COLUMN_BEFORE);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Second file (bytes)", DELTAS_COLUMN_AFTER);
+	dialog_add_column(GTK_TREE_VIEW(tree_view), "Change (bytes)", DELTAS_COLUMN_DELTA);
+
+	/* Present it in a dialog */
+	main_window = GTK_WINDOW(gtk_builder_get_object(app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
+	dialog = gtk_dialog_new_with_buttons("Changes at Peak", main_window,
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+			NULL);
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 900, 500);
+
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), tree_view);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			scrolled_window, TRUE, TRUE, 0);
+
+	gtk_widget_show_all(dialog);
+	gtk_dialog_run(GTK_DIALOG(dialog));
+
+	/* Cleanup */
+	gtk_widget_destroy(dialog);
+	g_object_unref(store);
+	massifg_analysis_deltas_free(deltas);
+}
+
+/* Add a column of fixed width to the heap tree view */
+static void
+heap_tree_add_column(GtkTreeView *tree_view, const gchar *title, gint column, gint width) {
+	GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+	GtkTreeViewColumn *tree_column = NULL;
+
+	if (column == MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT) {
+		tree_column = gtk_tree_view_column_new();
+		gtk_tree_view_column_set_title(tree_column, title);
+		gtk_tree_view_column_pack_start(tree_column, renderer, TRUE);
+		gtk_tree_view_column_set_cell_data_func(tree_column, renderer,
+				leaks_double_cell_data, GINT_TO_POINTER(column), NULL);
+	}
+	else {
+		tree_column = gtk_tree_view_column_new_with_attributes(title, renderer, "text", column, NULL);
+	}
+	/* Rows of fixed height, so that only the visible rows are measured */
+	gtk_tree_view_column_set_sizing(tree_column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(tree_column, width);
+	gtk_tree_view_column_set_resizable(tree_column, TRUE);
+	gtk_tree_view_append_column(tree_view, tree_column);
+}
+
+/* Expand the root of the heap tree view. With a filter, expand all the rows
+ * instead, which are only the ones leading to a matching label */
+static void
+heap_tree_expand(GtkTreeView *tree_view, gboolean filtered) {
+	GtkTreePath *root_path = NULL;
+
+	if (filtered) {
+		gtk_tree_view_expand_all(tree_view);
+		return;
+	}
+	root_path = gtk_tree_path_new_first();
+	gtk_tree_view_expand_row(tree_view, root_path, FALSE);
+	gtk_tree_path_free(root_path);
+}
+
+/* Show the heap tree of the snapshot chosen with the spin button, filtered
+ * by the text in the search box. Only the rows that are shown are created */
+static void
+heap_tree_snapshot_changed(GtkSpinButton *spin_button, gpointer data) {
+	GtkTreeView *tree_view = GTK_TREE_VIEW(data);
+	MassifgOutputData *output_data = NULL;
+	MassifgHeapTreeModel *model = NULL;
+	MassifgSnapshot *snapshot = NULL;
+	GtkTreeModel *filter = NULL;
+	GtkEntry *search_entry = NULL;
+
+	output_data = (MassifgOutputData *)g_object_get_data(G_OBJECT(spin_button), "massifg-output-data");
+	search_entry = GTK_ENTRY(g_object_get_data(G_OBJECT(spin_button), "massifg-search-entry"));
+	snapshot = (MassifgSnapshot *)g_list_nth_data(output_data->snapshots,
+			gtk_spin_button_get_value_as_int(spin_button));
+
+	model = massifg_heap_tree_model_new(output_data, snapshot);
+	massifg_heap_tree_model_set_label_filter(model, gtk_entry_get_text(search_entry));
+	filter = gtk_tree_model_filter_new(GTK_TREE_MODEL(model), NULL);
+	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(filter),
+			massifg_heap_tree_model_row_matches, NULL, NULL);
+	gtk_tree_view_set_model(tree_view, filter);
+	g_object_unref(filter);
+	g_object_unref(model);
+
+	heap_tree_expand(tree_view, *gtk_entry_get_text(search_entry) != '\0');
+}
+
+/* Only show the rows of the heap tree leading to labels that contain the text in the search box */
+static void
+heap_tree_search_changed(GtkEditable *editable, gpointer data) {
+	GtkTreeView *tree_view = GTK_TREE_VIEW(data);
+	GtkTreeModelFilter *filter = GTK_TREE_MODEL_FILTER(gtk_tree_view_get_model(tree_view));
+	const gchar *text = gtk_entry_get_text(GTK_ENTRY(editable));
+
+	massifg_heap_tree_model_set_label_filter(
+		MASSIFG_HEAP_TREE_MODEL(gtk_tree_model_filter_get_model(filter)), text);
+	gtk_tree_model_filter_refilter(filter);
+	heap_tree_expand(tree_view, *text != '\0');
+}
+
+/* Browse the heap tree of a snapshot, starting with the largest one */
+static void
+heap_tree_action(GtkAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+	MassifgOutputData *output_data = massifg_graph_get_data(app->graph);
+	MassifgSnapshot *snapshot = NULL;
+	GtkWidget *dialog = NULL;
+	GtkWidget *scrolled_window = NULL;
+	GtkWidget *tree_view = NULL;
+	GtkWidget *spin_button = NULL;
+	GtkWidget *search_entry = NULL;
+	GtkWidget *label = NULL;
+	GtkWidget *search_label = NULL;
+	GtkWidget *hbox = NULL;
+	GtkWindow *main_window = NULL;
+	GList *l = NULL;
+	gint64 mem_B, largest_mem_B = -1;
+	gint i, largest = 0;
+
+	if (!output_data || !output_data->snapshots) {
+		massifg_gtkui_errormsg(app, "%s", "Open a file first");
+		return;
+	}
+
+	for (l = output_data->snapshots, i = 0; l; l = l->next, i++) {
+		snapshot = (MassifgSnapshot *)l->data;
+		mem_B = snapshot->mem_heap_B + snapshot->mem_heap_extra_B + snapshot->mem_stacks_B;
+		if (massifg_snapshot_has_heap_tree(snapshot) && mem_B > largest_mem_B) {
+			largest_mem_B = mem_B;
+			largest = i;
+		}
+	}
+
+	tree_view = gtk_tree_view_new();
+	heap_tree_add_column(GTK_TREE_VIEW(tree_view), "Function", MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL, 600);
+	heap_tree_add_column(GTK_TREE_VIEW(tree_view), "Bytes", MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES, 100);
+	heap_tree_add_column(GTK_TREE_VIEW(tree_view), "Percent", MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT, 80);
+	heap_tree_add_column(GTK_TREE_VIEW(tree_view), "Self bytes", MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES, 100);
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(tree_view), TRUE);
+
+	search_label = gtk_label_new_with_mnemonic("_Find:");
+	search_entry = gtk_entry_new();
+	gtk_label_set_mnemonic_widget(GTK_LABEL(search_label), search_entry);
+
+	label = gtk_label_new_with_mnemonic("_Snapshot:");
+	spin_button = gtk_spin_button_new_with_range(0, g_list_length(output_data->snapshots)-1, 1);
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label), spin_button);
+	/* Keep the data alive while browsing, even if another file is opened meanwhile */
+	g_object_set_data_full(G_OBJECT(spin_button), "massifg-output-data",
+			massifg_output_data_ref(output_data), (GDestroyNotify)massifg_output_data_unref);
+	g_object_set_data(G_OBJECT(spin_button), "massifg-search-entry", search_entry);
+
+	/* Set the value before connecting, so that the tree is only shown once.
+	 * Setting it does not emit "value-changed" if the largest snapshot is the first */
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), largest);
+	heap_tree_snapshot_changed(GTK_SPIN_BUTTON(spin_button), tree_view);
+	g_signal_connect(spin_button, "value-changed", G_CALLBACK(heap_tree_snapshot_changed), tree_view);
+	g_signal_connect(search_entry, "changed", G_CALLBACK(heap_tree_search_changed), tree_view);
+
+	/* Present it in a dialog */
+	main_window = GTK_WINDOW(gtk_builder_get_object(app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
+	dialog = gtk_dialog_new_with_buttons("Heap Tree", main_window,
+			GTK_DIALOG_DESTROY_WITH_PARENT,
+			GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+			NULL);
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 900, 600);
+
+	hbox = gtk_hbox_new(FALSE, 6);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), spin_button, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), search_label, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), search_entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			hbox, FALSE, FALSE, 0);
+
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), tree_view);
+	gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))),
+			scrolled_window, TRUE, TRUE, 0);
+
+	gtk_widget_show_all(dialog);
+	gtk_dialog_run(GTK_DIALOG(dialog));
+
+	/* Cleanup. The models are freed with the tree view */
+	gtk_widget_destroy(dialog);
+}
+
+static void
+toggle_align_action(GtkToggleAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+
+	massifg_graph_set_align_time(app->graph, gtk_toggle_action_get_active(action));
+}
+
+static void
+toggle_follow_action(GtkToggleAction *action, gpointer data) {
+	MassifgApplication *app = (MassifgApplication *)data;
+
+	massifg_application_set_follow(app, gtk_toggle_action_get_active(action));
+}
+
 static void
 toggle_details_action(GtkToggleAction *action, gpointer data) {
 	MassifgApplication *app = (MassifgApplication *)data;
@@ -221,7 +826,6 @@ toggle_legend_action(GtkToggleAction *action, gpointer data) {
  */
 static gboolean
 massifg_gtkui_init_menus(MassifgApplication *app) {
-	gchar *uifile_path = NULL;
 	GtkActionGroup *action_group = NULL;
 	GtkWidget *vbox = NULL;
 	GtkWidget *menubar = NULL;
@@ -235,33 +839,56 @@ massifg_gtkui_init_menus(MassifgApplication *app) {
 	  { "FileMenuAction", NULL, "_File", NULL, NULL, NULL},
 	  { "QuitAction", GTK_STOCK_QUIT, "_Quit", NULL, NULL, G_CALLBACK(quit_action)},
 	  { "OpenFileAction", GTK_STOCK_OPEN, "_Open...", NULL, NULL, G_CALLBACK(open_file_action)},
+	  { "CompareFilesAction", NULL, "_Compare Files...", NULL, NULL, G_CALLBACK(compare_files_action)},
+	  { "RunMassifAction", GTK_STOCK_EXECUTE, "_Run Massif...", NULL, NULL, G_CALLBACK(run_massif_action)},
 	  { "SaveFileAction", GTK_STOCK_SAVE, "_Save...", NULL, NULL, G_CALLBACK(save_file_action)},
 	  { "PrintAction", GTK_STOCK_PRINT, "_Print...", NULL, NULL, G_CALLBACK(print_action)},
 
 	  { "ViewMenuAction", NULL, "_View", NULL, NULL, NULL},
+	  { "GroupByMenuAction", NULL, "_Group By", NULL, NULL, NULL},
+	  { "HeapTreeAction", NULL, "_Heap Tree...", NULL, NULL, G_CALLBACK(heap_tree_action)},
+	  { "LeaksAction", NULL, "Likely _Leaks...", NULL, NULL, G_CALLBACK(leaks_action)},
+	  { "PeakDeltasAction", NULL, "Changes at _Peak...", NULL, NULL, G_CALLBACK(peak_deltas_action)},
+	  { "StatisticsAction", NULL, "_Statistics...", NULL, NULL, G_CALLBACK(stats_action)},
 	};
 	const guint num_actions = G_N_ELEMENTS(actions);
 
 	GtkToggleActionEntry view_actions[] = {
 	  {"ToggleDetailsAction", NULL, "_Detailed", NULL, NULL, G_CALLBACK(toggle_details_action), FALSE},
-	  {"ToggleLegendAction", NULL, "_Legend", NULL, NULL, G_CALLBACK(toggle_legend_action), TRUE}
+	  {"ToggleLegendAction", NULL, "_Legend", NULL, NULL, G_CALLBACK(toggle_legend_action), TRUE},
+	  {"ToggleAlignAction", NULL, "_Align Compared Files", NULL, NULL, G_CALLBACK(toggle_align_action), FALSE}
 	};
 	const guint num_view_actions = G_N_ELEMENTS(view_actions);
 
+	GtkToggleActionEntry file_actions[] = {
+	  {"ToggleFollowAction", NULL, "_Follow File", NULL, NULL, G_CALLBACK(toggle_follow_action), FALSE}
+	};
+	const guint num_file_actions = G_N_ELEMENTS(file_actions);
+
+	GtkRadioActionEntry group_by_actions[] = {
+	  {"GroupByFunctionAction", NULL, "_Function", NULL, NULL, MASSIFG_GROUP_BY_FUNCTION},
+	  {"GroupByObjectAction", NULL, "Shared _Object", NULL, NULL, MASSIFG_GROUP_BY_OBJECT},
+	  {"GroupByFileAction", NULL, "Source F_ile", NULL, NULL, MASSIFG_GROUP_BY_FILE},
+	  {"GroupByNamespaceAction", NULL, "_Namespace", NULL, NULL, MASSIFG_GROUP_BY_NAMESPACE}
+	};
+	const guint num_group_by_actions = G_N_ELEMENTS(group_by_actions);
+
 	/* Initialize */
 	vbox = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, MAIN_WINDOW_VBOX));
 	window = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, MASSIFG_GTKUI_MAIN_WINDOW));
 
-	uifile_path = massifg_utils_get_resource_file("menu.ui");
 	action_group = gtk_action_group_new ("action group");
 	uimanager = gtk_ui_manager_new();
 
 	/* Build menus */
 	gtk_action_group_add_actions (action_group, actions, num_actions, app);
+	gtk_action_group_add_toggle_actions (action_group, file_actions, num_file_actions, app);
 	gtk_action_group_add_toggle_actions (action_group, view_actions, num_view_actions, app);
+	gtk_action_group_add_radio_actions (action_group, group_by_actions, num_group_by_actions,
+		MASSIFG_GROUP_BY_FUNCTION, G_CALLBACK(group_by_action), app);
 	gtk_ui_manager_insert_action_group (uimanager, action_group, 0);
 
-	if (!gtk_ui_manager_add_ui_from_file (uimanager, uifile_path, &error))
+	if (!gtk_ui_manager_add_ui_from_string (uimanager, MASSIFG_GTKUI_MENU, -1, &error))
 	{
 		g_critical ("Building menus failed: %s", error->message);
 		g_error_free (error);
@@ -276,7 +903,6 @@ massifg_gtkui_init_menus(MassifgApplication *app) {
 	gtk_box_reorder_child (GTK_BOX (vbox), menubar, 0);
 
 	/* Cleanup */
-	g_free(uifile_path);
 	g_object_unref(action_group);
 	g_object_unref(uimanager);
 
@@ -296,21 +922,23 @@ massifg_gtkui_init_menus(MassifgApplication *app) {
  */
 gboolean
 massifg_gtkui_init(MassifgApplication *app) {
-	gchar *gladefile_path = NULL;
 	GtkWidget *vbox = NULL;
-	GtkWidget *graph_widget = NULL;
+	GtkWidget *hbox = NULL;
+	GtkWidget *search_entry = NULL;
+	GtkWidget *search_label = NULL;
+	GtkWidget *placeholder = NULL;
 	GError *error = NULL;
 
 	/* Initialize */
 	gtk_init (app->argc_ptr, app->argv_ptr);
 
 	g_signal_connect(app, "file-changed", G_CALLBACK(mainwindow_update_title), NULL);
+	g_signal_connect(app, "file-changed", G_CALLBACK(mainwindow_show_graph), NULL);
 
 	app->gtk_builder = gtk_builder_new();
-	gladefile_path = massifg_utils_get_resource_file("massifg.glade");
 
-	/* Build UI */
-	if (!gtk_builder_add_from_file (app->gtk_builder, gladefile_path, &error))
+	/* Build UI from the compiled-in definition */
+	if (!gtk_builder_add_from_string (app->gtk_builder, MASSIFG_GTKUI_GLADE, -1, &error))
 	{
 		g_critical ("%s", error->message);
 		g_error_free (error);
@@ -319,14 +947,24 @@ massifg_gtkui_init(MassifgApplication *app) {
 	}
 	gtk_builder_connect_signals(app->gtk_builder, NULL);
 
-	/* Add the graph widget */
+	/* Reserve the space of the graph widget, which is added when a file is loaded */
 	vbox = GTK_WIDGET (gtk_builder_get_object (app->gtk_builder, MAIN_WINDOW_VBOX));
 	app->graph = massifg_graph_new();
-	graph_widget = massifg_graph_get_widget(app->graph);
-	gtk_box_pack_start(GTK_BOX (vbox), graph_widget, TRUE, TRUE, 1);
-
-	/* Cleanup */
-	g_free(gladefile_path);
+	placeholder = gtk_label_new("Open a massif output file to show its memory usage");
+	gtk_box_pack_start(GTK_BOX (vbox), placeholder, TRUE, TRUE, 1);
+	g_object_set_data(G_OBJECT(vbox), GRAPH_PLACEHOLDER, placeholder);
+
+	/* Add the search box for filtering the functions in the detailed view */
+	hbox = gtk_hbox_new(FALSE, 6);
+	search_entry = gtk_entry_new();
+	gtk_widget_set_tooltip_text(search_entry,
+			"Only show functions whose label contains this text in the detailed view");
+	g_signal_connect(search_entry, "changed", G_CALLBACK(search_entry_changed), app);
+	search_label = gtk_label_new_with_mnemonic("_Filter:");
+	gtk_label_set_mnemonic_widget(GTK_LABEL(search_label), search_entry);
+	gtk_box_pack_start(GTK_BOX(hbox), search_label, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), search_entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX (vbox), hbox, FALSE, FALSE, 1);
 
 	return massifg_gtkui_init_menus(app);
 }
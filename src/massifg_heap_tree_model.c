@@ -0,0 +1,464 @@
+/*
+ *  MassifG - massifg_heap_tree_model.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_heap_tree_model
+ * @short_description: A tree model over the heap tree of a snapshot
+ * @title: MassifG Heap Tree Model
+ * @stability: Unstable
+ *
+ * #MassifgHeapTreeModel implements #GtkTreeModel directly on top of the heap
+ * tree of a #MassifgSnapshot, so that a #GtkTreeView can browse trees with
+ * hundreds of thousands of nodes without copying them into a #GtkTreeStore.
+ *
+ * Rows are only created when they are first asked for, typically when their
+ * parent is expanded, and the children of a row are sorted by memory usage,
+ * largest first, at that point. Creating the model only creates the row for
+ * the root, so it takes constant time whatever the size of the tree.
+ *
+ * A filter can be set with massifg_heap_tree_model_set_label_filter(), which
+ * finds the matching labels with the #MassifgLabelIndex of the data. The model
+ * itself keeps all its rows, and massifg_heap_tree_model_row_matches() tells
+ * a #GtkTreeModelFilter which of them to show: the rows with a matching label
+ * in their subtree. Whether a subtree matches is remembered by its #GNode, so
+ * subtrees that several snapshots or parents share are only searched once.
+ *
+ * The model does not own the snapshot, which must outlive it.
+ */
+
+#include <gtk/gtk.h>
+
+#include "massifg_heap_tree_model.h"
+#include "massifg_parser.h"
+
+/* Private data structures */
+
+/* A row of the model. The rows of the children of a row are created together,
+ * so that they can be sorted, and stay until the model is freed */
+typedef struct _MassifgHeapTreeRow MassifgHeapTreeRow;
+struct _MassifgHeapTreeRow {
+	GNode *node;
+	MassifgHeapTreeRow *parent; /* The parent GNode may be in another snapshot, see MassifgSnapshot */
+	gint index; /* Among the children of parent */
+	gint num_children; /* -1 until counted */
+	MassifgHeapTreeRow *children; /* Array of num_children rows, NULL until needed */
+};
+
+static void massifg_heap_tree_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (MassifgHeapTreeModel, massifg_heap_tree_model, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, massifg_heap_tree_model_tree_model_init))
+
+/* Private functions */
+
+#define ROW_MEM_B(row) (((MassifgHeapTreeNode *)(row)->node->data)->total_mem_B)
+
+static MassifgHeapTreeRow *
+massifg_heap_tree_row_new(GNode *node) {
+	MassifgHeapTreeRow *row = g_new(MassifgHeapTreeRow, 1);
+
+	row->node = node;
+	row->parent = NULL;
+	row->index = 0;
+	row->num_children = -1;
+	row->children = NULL;
+	return row;
+}
+
+/* Free the rows created under row */
+static void
+massifg_heap_tree_row_free_children(MassifgHeapTreeRow *row) {
+	gint i;
+
+	if (!row->children)
+		return;
+	for (i=0; i<row->num_children; i++) {
+		massifg_heap_tree_row_free_children(&row->children[i]);
+	}
+	g_free(row->children);
+}
+
+static gint
+massifg_heap_tree_row_count_children(MassifgHeapTreeRow *row) {
+	if (row->num_children < 0) {
+		row->num_children = g_node_n_children(row->node);
+	}
+	return row->num_children;
+}
+
+/* Sort rows by memory usage, largest first */
+static gint
+massifg_heap_tree_row_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+	glong mem_a = ROW_MEM_B((const MassifgHeapTreeRow *)a);
+	glong mem_b = ROW_MEM_B((const MassifgHeapTreeRow *)b);
+
+	return mem_a > mem_b ? -1 : (mem_a < mem_b ? 1 : 0);
+}
+
+/* Get the rows of the children of row, creating them if needed.
+ * Returns NULL if the row has no children */
+static MassifgHeapTreeRow *
+massifg_heap_tree_row_get_children(MassifgHeapTreeModel *model, MassifgHeapTreeRow *row) {
+	GNode *child = NULL;
+	gint i;
+
+	if (row->children || massifg_heap_tree_row_count_children(row) == 0)
+		return row->children;
+
+	row->children = g_new(MassifgHeapTreeRow, row->num_children);
+	for (child = row->node->children, i = 0; child; child = child->next, i++) {
+		row->children[i].node = child;
+		row->children[i].parent = row;
+		row->children[i].num_children = -1;
+		row->children[i].children = NULL;
+	}
+	/* Massif usually writes the children sorted already, but does not have to */
+	g_qsort_with_data(row->children, row->num_children, sizeof(MassifgHeapTreeRow),
+			massifg_heap_tree_row_compare, NULL);
+	for (i=0; i<row->num_children; i++) {
+		row->children[i].index = i;
+	}
+	model->num_rows += row->num_children;
+	return row->children;
+}
+
+/* Whether node or a node under it has a label that matches the filter */
+static gboolean
+massifg_heap_tree_model_subtree_matches(MassifgHeapTreeModel *model, GNode *node) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	gpointer cached = g_hash_table_lookup(model->subtree_matches, node);
+	gboolean matches = FALSE;
+	GNode *child = NULL;
+
+	if (cached)
+		return GPOINTER_TO_INT(cached) == 2;
+
+	matches = n->label_id < model->num_labels && model->label_matches[n->label_id];
+	for (child = node->children; child && !matches; child = child->next) {
+		matches = massifg_heap_tree_model_subtree_matches(model, child);
+	}
+	g_hash_table_insert(model->subtree_matches, node, GINT_TO_POINTER(matches ? 2 : 1));
+	return matches;
+}
+
+static gboolean
+massifg_heap_tree_model_set_iter(MassifgHeapTreeModel *model, GtkTreeIter *iter, MassifgHeapTreeRow *row) {
+	if (!row) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+	iter->stamp = model->stamp;
+	iter->user_data = row;
+	return TRUE;
+}
+
+/* GtkTreeModel implementation */
+
+static GtkTreeModelFlags
+massifg_heap_tree_model_get_flags(GtkTreeModel *tree_model) {
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+massifg_heap_tree_model_get_n_columns(GtkTreeModel *tree_model) {
+	return MASSIFG_HEAP_TREE_MODEL_N_COLUMNS;
+}
+
+static GType
+massifg_heap_tree_model_get_column_type(GtkTreeModel *tree_model, gint index) {
+	switch (index) {
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL:
+		return G_TYPE_STRING;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES:
+		return G_TYPE_INT64;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT:
+		return G_TYPE_DOUBLE;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES:
+		return G_TYPE_INT64;
+	}
+	g_return_val_if_reached(G_TYPE_INVALID);
+}
+
+static gboolean
+massifg_heap_tree_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = model->root;
+	MassifgHeapTreeRow *children = NULL;
+	gint *indices = gtk_tree_path_get_indices(path);
+	gint depth = gtk_tree_path_get_depth(path);
+	gint i;
+
+	/* The root is the only top-level row */
+	if (!row || depth < 1 || indices[0] != 0)
+		return massifg_heap_tree_model_set_iter(model, iter, NULL);
+
+	for (i=1; i<depth; i++) {
+		children = massifg_heap_tree_row_get_children(model, row);
+		if (!children || indices[i] < 0 || indices[i] >= row->num_children)
+			return massifg_heap_tree_model_set_iter(model, iter, NULL);
+		row = &children[indices[i]];
+	}
+	return massifg_heap_tree_model_set_iter(model, iter, row);
+}
+
+static GtkTreePath *
+massifg_heap_tree_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)iter->user_data;
+	GtkTreePath *path = gtk_tree_path_new();
+
+	for (; row; row = row->parent) {
+		gtk_tree_path_prepend_index(path, row->index);
+	}
+	return path;
+}
+
+static void
+massifg_heap_tree_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+				gint column, GValue *value) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)iter->user_data;
+	MassifgHeapTreeNode *node = (MassifgHeapTreeNode *)row->node->data;
+	glong root_mem_B = ROW_MEM_B(model->root);
+
+	g_value_init(value, massifg_heap_tree_model_get_column_type(tree_model, column));
+	switch (column) {
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL:
+		g_value_set_string(value, node->label->str);
+		break;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES:
+		g_value_set_int64(value, node->total_mem_B);
+		break;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT:
+		g_value_set_double(value, root_mem_B ? 100.0*node->total_mem_B/root_mem_B : 0.0);
+		break;
+	case MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES:
+		g_value_set_int64(value, node->self_mem_B);
+		break;
+	}
+}
+
+static gboolean
+massifg_heap_tree_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)iter->user_data;
+
+	if (!row->parent || row->index+1 >= row->parent->num_children)
+		return massifg_heap_tree_model_set_iter(model, iter, NULL);
+	return massifg_heap_tree_model_set_iter(model, iter, &row->parent->children[row->index+1]);
+}
+
+static gboolean
+massifg_heap_tree_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter,
+				GtkTreeIter *parent, gint n) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = NULL;
+	MassifgHeapTreeRow *children = NULL;
+
+	if (!parent) {
+		return massifg_heap_tree_model_set_iter(model, iter, n == 0 ? model->root : NULL);
+	}
+
+	row = (MassifgHeapTreeRow *)parent->user_data;
+	children = massifg_heap_tree_row_get_children(model, row);
+	if (!children || n < 0 || n >= row->num_children)
+		return massifg_heap_tree_model_set_iter(model, iter, NULL);
+	return massifg_heap_tree_model_set_iter(model, iter, &children[n]);
+}
+
+static gboolean
+massifg_heap_tree_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent) {
+	return massifg_heap_tree_model_iter_nth_child(tree_model, iter, parent, 0);
+}
+
+/* Does not create the rows of the children, so that expanders can be shown cheaply */
+static gboolean
+massifg_heap_tree_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)iter->user_data;
+
+	return row->node->children != NULL;
+}
+
+static gint
+massifg_heap_tree_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+
+	if (!iter)
+		return model->root ? 1 : 0;
+	return massifg_heap_tree_row_count_children((MassifgHeapTreeRow *)iter->user_data);
+}
+
+static gboolean
+massifg_heap_tree_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)child->user_data;
+
+	return massifg_heap_tree_model_set_iter(model, iter, row->parent);
+}
+
+static void
+massifg_heap_tree_model_tree_model_init(GtkTreeModelIface *iface) {
+	iface->get_flags = massifg_heap_tree_model_get_flags;
+	iface->get_n_columns = massifg_heap_tree_model_get_n_columns;
+	iface->get_column_type = massifg_heap_tree_model_get_column_type;
+	iface->get_iter = massifg_heap_tree_model_get_iter;
+	iface->get_path = massifg_heap_tree_model_get_path;
+	iface->get_value = massifg_heap_tree_model_get_value;
+	iface->iter_next = massifg_heap_tree_model_iter_next;
+	iface->iter_children = massifg_heap_tree_model_iter_children;
+	iface->iter_has_child = massifg_heap_tree_model_iter_has_child;
+	iface->iter_n_children = massifg_heap_tree_model_iter_n_children;
+	iface->iter_nth_child = massifg_heap_tree_model_iter_nth_child;
+	iface->iter_parent = massifg_heap_tree_model_iter_parent;
+}
+
+/* GObject implementation */
+
+static void
+massifg_heap_tree_model_init(MassifgHeapTreeModel *self) {
+	self->stamp = g_random_int();
+	self->data = NULL;
+	self->snapshot = NULL;
+	self->root = NULL;
+	self->num_rows = 0;
+	self->label_matches = NULL;
+	self->num_labels = 0;
+	self->subtree_matches = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void
+massifg_heap_tree_model_finalize(GObject *gobject) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(gobject);
+
+	if (model->root) {
+		massifg_heap_tree_row_free_children(model->root);
+		g_free(model->root);
+		massifg_output_data_release_heap_tree(model->data, model->snapshot);
+	}
+	if (model->data) {
+		massifg_output_data_unref(model->data);
+	}
+	g_free(model->label_matches);
+	g_hash_table_destroy(model->subtree_matches);
+	G_OBJECT_CLASS(massifg_heap_tree_model_parent_class)->finalize(gobject);
+}
+
+static void
+massifg_heap_tree_model_class_init(MassifgHeapTreeModelClass *klass) {
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	gobject_class->finalize = massifg_heap_tree_model_finalize;
+}
+
+/* Public functions */
+
+/**
+ * massifg_heap_tree_model_new:
+ * @data: The #MassifgOutputData @snapshot belongs to. The model keeps a reference to it
+ * @snapshot: The #MassifgSnapshot whose heap tree to show
+ * @Returns: A new #MassifgHeapTreeModel. Unref with g_object_unref()
+ *
+ * Create a model showing the heap tree of @snapshot, with the root of the tree
+ * as the only top-level row. The model is empty if the snapshot has no heap tree.
+ * The tree is kept in memory as long as the model exists, see
+ * massifg_output_data_get_heap_tree().
+ */
+MassifgHeapTreeModel *
+massifg_heap_tree_model_new(MassifgOutputData *data, MassifgSnapshot *snapshot) {
+	MassifgHeapTreeModel *model = g_object_new(MASSIFG_TYPE_HEAP_TREE_MODEL, NULL);
+	GNode *heap_tree = massifg_output_data_get_heap_tree(data, snapshot);
+
+	model->data = massifg_output_data_ref(data);
+	model->snapshot = snapshot;
+	if (heap_tree) {
+		model->root = massifg_heap_tree_row_new(heap_tree);
+		model->num_rows = 1;
+	}
+	return model;
+}
+
+/**
+ * massifg_heap_tree_model_get_num_rows:
+ * @model: A #MassifgHeapTreeModel
+ * @Returns: The number of rows that have been created
+ *
+ * Get the number of rows the model has created so far. This is usually much
+ * smaller than the number of nodes in the tree.
+ */
+guint
+massifg_heap_tree_model_get_num_rows(MassifgHeapTreeModel *model) {
+	return model->num_rows;
+}
+
+/**
+ * massifg_heap_tree_model_set_label_filter:
+ * @model: A #MassifgHeapTreeModel
+ * @filter: Only match the rows with a label containing this string under them,
+ * ignoring case. %NULL or an empty string matches all rows
+ *
+ * Set which rows massifg_heap_tree_model_row_matches() matches. The rows of
+ * the model do not change, so a #GtkTreeModelFilter over it must be refiltered
+ * with gtk_tree_model_filter_refilter() afterwards.
+ */
+void
+massifg_heap_tree_model_set_label_filter(MassifgHeapTreeModel *model, const gchar *filter) {
+	GArray *matches = NULL;
+	guint i;
+
+	g_free(model->label_matches);
+	model->label_matches = NULL;
+	model->num_labels = 0;
+	g_hash_table_remove_all(model->subtree_matches);
+
+	if (!filter || !*filter || !model->data)
+		return;
+
+	/* The data might still be growing, so index the labels added since last time first */
+	massifg_label_index_update(model->data->label_index);
+	matches = massifg_label_index_search(model->data->label_index, filter);
+	model->num_labels = massifg_label_table_size(model->data->labels);
+	model->label_matches = g_new0(gboolean, model->num_labels);
+	for (i=0; i<matches->len; i++) {
+		model->label_matches[g_array_index(matches, guint, i)] = TRUE;
+	}
+	g_array_free(matches, TRUE);
+}
+
+/**
+ * massifg_heap_tree_model_row_matches:
+ * @tree_model: A #MassifgHeapTreeModel
+ * @iter: A row of @tree_model
+ * @data: Not used
+ * @Returns: %TRUE if the label of the row or of a row under it matches the filter
+ *
+ * Check a row against the filter set with massifg_heap_tree_model_set_label_filter().
+ * Every row matches when there is no filter. This is a #GtkTreeModelFilterVisibleFunc,
+ * see gtk_tree_model_filter_set_visible_func(). Each node in the heap trees
+ * is only checked once for each filter, however many rows ask for it.
+ */
+gboolean
+massifg_heap_tree_model_row_matches(GtkTreeModel *tree_model, GtkTreeIter *iter, gpointer data) {
+	MassifgHeapTreeModel *model = MASSIFG_HEAP_TREE_MODEL(tree_model);
+	MassifgHeapTreeRow *row = (MassifgHeapTreeRow *)iter->user_data;
+
+	if (!model->label_matches)
+		return TRUE;
+	return massifg_heap_tree_model_subtree_matches(model, row->node);
+}
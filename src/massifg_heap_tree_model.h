@@ -0,0 +1,102 @@
+/*
+ *  MassifG - massifg_heap_tree_model.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_HEAP_TREE_MODEL_H__
+#define MASSIFG_HEAP_TREE_MODEL_H__
+
+#include <gtk/gtk.h>
+#include <glib-object.h>
+
+#include "massifg_parser.h"
+
+/*
+ * Type macros.
+ */
+#define MASSIFG_TYPE_HEAP_TREE_MODEL              (massifg_heap_tree_model_get_type ())
+#define MASSIFG_HEAP_TREE_MODEL(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), MASSIFG_TYPE_HEAP_TREE_MODEL, MassifgHeapTreeModel))
+#define MASSIFG_IS_HEAP_TREE_MODEL(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MASSIFG_TYPE_HEAP_TREE_MODEL))
+#define MASSIFG_HEAP_TREE_MODEL_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), MASSIFG_TYPE_HEAP_TREE_MODEL, MassifgHeapTreeModelClass))
+#define MASSIFG_IS_HEAP_TREE_MODEL_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), MASSIFG_TYPE_HEAP_TREE_MODEL))
+#define MASSIFG_HEAP_TREE_MODEL_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), MASSIFG_TYPE_HEAP_TREE_MODEL, MassifgHeapTreeModelClass))
+
+/**
+ * MassifgHeapTreeModelColumn:
+ * @MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL: The label of the node, a string
+ * @MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES: The memory usage under the node in bytes, a #gint64
+ * @MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT: The memory usage under the node in percent
+ * of the root of the tree, a #gdouble
+ * @MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES: The memory usage of the node itself, without
+ * its children, in bytes, a #gint64
+ *
+ * The columns of a #MassifgHeapTreeModel.
+ */
+typedef enum {
+	MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL,
+	MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES,
+	MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT,
+	MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES,
+	/*< private >*/
+	MASSIFG_HEAP_TREE_MODEL_N_COLUMNS
+} MassifgHeapTreeModelColumn;
+
+/**
+ * MassifgHeapTreeModel:
+ *
+ * A #GtkTreeModel showing the heap tree of a single snapshot.
+ */
+typedef struct _MassifgHeapTreeModel        MassifgHeapTreeModel;
+
+/**
+ * MassifgHeapTreeModelClass:
+ *
+ * Class structure for a #MassifgHeapTreeModel object.
+ */
+typedef struct _MassifgHeapTreeModelClass   MassifgHeapTreeModelClass;
+
+struct _MassifgHeapTreeModel {
+	/*< private >*/
+	GObject parent_instance;
+
+	gint stamp;
+	MassifgOutputData *data;
+	MassifgSnapshot *snapshot;
+	struct _MassifgHeapTreeRow *root;
+	guint num_rows;
+
+	gboolean *label_matches; /* Label id -> matches the filter, NULL without a filter */
+	guint num_labels;
+	GHashTable *subtree_matches; /* GNode -> whether a label under it matches */
+};
+
+struct _MassifgHeapTreeModelClass {
+	/*< private >*/
+	GObjectClass parent_class;
+};
+
+/* used by MASSIFG_TYPE_HEAP_TREE_MODEL */
+GType massifg_heap_tree_model_get_type (void);
+
+MassifgHeapTreeModel *massifg_heap_tree_model_new(MassifgOutputData *data, MassifgSnapshot *snapshot);
+guint massifg_heap_tree_model_get_num_rows(MassifgHeapTreeModel *model);
+void massifg_heap_tree_model_set_label_filter(MassifgHeapTreeModel *model, const gchar *filter);
+gboolean massifg_heap_tree_model_row_matches(GtkTreeModel *tree_model, GtkTreeIter *iter, gpointer data);
+
+#endif /* MASSIFG_HEAP_TREE_MODEL_H__ */
@@ -0,0 +1,671 @@
+/*
+ *  MassifG - massifg_labels.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_labels
+ * @short_description: Interned heap tree labels, and searching in them
+ * @title: MassifG Labels
+ * @stability: Unstable
+ *
+ * The same heap tree labels appear in many snapshots. The parser interns them
+ * in a #MassifgLabelTable, so that each distinct label is stored once and
+ * heap tree nodes with the same label share the same #GString.
+ * Each label is split into its code address, function, source file and line,
+ * and shared object once, when it is interned, see #MassifgLabelFields.
+ * Code that groups or compares by these parts can then work on integer ids.
+ *
+ * When several files are parsed at the same time into one table, the parsers
+ * intern their labels concurrently, so interning is protected by a mutex.
+ * The labels and their parts are stored in chunks that are never moved or
+ * freed before the table, and the number of labels is only increased after a
+ * label has been stored, so looking labels up by id needs no lock.
+ *
+ * A #MassifgLabelIndex maps every sequence of three characters (a trigram) to the
+ * ids of the labels that contain it. To find the labels containing a string,
+ * only the labels that contain all the trigrams of the string need to be checked.
+ * Searches are case insensitive.
+ */
+
+#include <stdlib.h> /* for strtoul() */
+#include <string.h>
+
+#include <glib.h>
+
+#include "massifg_labels.h"
+
+/* Private functions */
+
+/* Pack three characters into a key for the trigram table */
+static guint
+trigram_key(const gchar *str) {
+	return ((guint)(guchar)str[0] << 16) | ((guint)(guchar)str[1] << 8) | (guint)(guchar)str[2];
+}
+
+/* Sort arrays of label ids by length, shortest first */
+static gint
+compare_array_length(gconstpointer a, gconstpointer b) {
+	const GArray *array_a = *(const GArray **)a;
+	const GArray *array_b = *(const GArray **)b;
+
+	return (gint)array_a->len - (gint)array_b->len;
+}
+
+/* Remove the ids in candidates that are not in ids. Both must be sorted */
+static void
+intersect_ids(GArray *candidates, GArray *ids) {
+	guint i = 0, j = 0, n = 0;
+	guint candidate;
+
+	while (i < candidates->len && j < ids->len) {
+		candidate = g_array_index(candidates, guint, i);
+		if (candidate < g_array_index(ids, guint, j)) {
+			i++;
+		}
+		else if (candidate > g_array_index(ids, guint, j)) {
+			j++;
+		}
+		else {
+			g_array_index(candidates, guint, n++) = candidate;
+			i++;
+			j++;
+		}
+	}
+	g_array_set_size(candidates, n);
+}
+
+/* Estimated size of an entry in a GHashTable: the key, the value and the hash */
+#define HASH_ENTRY_SIZE (2*sizeof(gpointer) + sizeof(guint))
+
+/* Number of labels in the first chunk of a table. Each chunk after it has room
+ * for twice as many labels as the one before, so that LABEL_MAX_CHUNKS chunks
+ * can hold any guint id */
+#define LABEL_FIRST_CHUNK_SIZE 256
+#define LABEL_MAX_CHUNKS 25
+
+/* Number of labels chunk number chunk has room for */
+#define LABEL_CHUNK_SIZE(chunk) ((gsize)LABEL_FIRST_CHUNK_SIZE << (chunk))
+
+/* Get the chunk an id is stored in, and its offset in that chunk */
+static guint
+label_chunk(guint id, guint *offset) {
+	guint chunk = g_bit_storage(id/LABEL_FIRST_CHUNK_SIZE + 1) - 1;
+
+	*offset = id - LABEL_FIRST_CHUNK_SIZE*((1u << chunk) - 1);
+	return chunk;
+}
+
+/* Create a table that does not split its labels into parts */
+static MassifgLabelTable *
+massifg_label_table_new_plain(void) {
+	MassifgLabelTable *table = g_new(MassifgLabelTable, 1);
+
+	table->functions = NULL;
+	table->files = NULL;
+	table->objects = NULL;
+	table->ref_count = 1;
+	table->size = 0;
+	table->lock = g_mutex_new();
+	table->ids = g_hash_table_new(g_str_hash, g_str_equal);
+	table->labels = g_new0(GString **, LABEL_MAX_CHUNKS);
+	table->fields = NULL;
+	return table;
+}
+
+/* Get the label with an id below the size of the table */
+static GString *
+massifg_label_table_get_unchecked(MassifgLabelTable *table, guint id) {
+	guint offset;
+	guint chunk = label_chunk(id, &offset);
+
+	return table->labels[chunk][offset];
+}
+
+/* Intern len bytes of str, with surrounding whitespace removed */
+static guint
+massifg_label_table_intern_len(MassifgLabelTable *table, const gchar *str, gsize len) {
+	gchar *tmp_str = g_strndup(str, len);
+	guint id;
+
+	id = massifg_label_table_intern(table, g_strstrip(tmp_str));
+	g_free(tmp_str);
+	return id;
+}
+
+/* Split a label into its parts. Formats:
+ * "0x5792ABD: dictresize (dictobject.c:517)"
+ * "0x54A26EE: ??? (in /lib/libselinux.so.1)"
+ * "0x4E0A: std::string::_S_create(unsigned int, std::allocator<char> const&) (in /usr/lib/libstdc++.so.6)"
+ * Anything else is not a stack frame */
+static void
+massifg_label_table_split(MassifgLabelTable *table, const gchar *label, MassifgLabelFields *fields) {
+	const gchar *frame = NULL;
+	const gchar *location = NULL;
+	const gchar *end = NULL;
+	const gchar *colon = NULL;
+	gchar *line_end = NULL;
+	gint depth = 0;
+
+	fields->address = 0;
+	fields->function_id = MASSIFG_LABEL_NONE;
+	fields->file_id = MASSIFG_LABEL_NONE;
+	fields->line = 0;
+	fields->object_id = MASSIFG_LABEL_NONE;
+
+	if (!g_str_has_prefix(label, "0x") || !(frame = strstr(label, ": "))) {
+		return;
+	}
+	fields->address = g_ascii_strtoull(label+2, NULL, 16);
+	frame += 2;
+
+	/* Find the location in the last parenthesis. The function name can
+	 * contain parentheses itself, so match them from the end */
+	end = frame + strlen(frame);
+	if (end > frame && *(end-1) == ')') {
+		for (location = end-1; location > frame; location--) {
+			if (*location == ')')
+				depth++;
+			else if (*location == '(' && --depth == 0)
+				break;
+		}
+	}
+	if (!location || depth != 0 || location == frame) {
+		/* No location, the whole frame is the function */
+		fields->function_id = massifg_label_table_intern(table->functions, frame);
+		return;
+	}
+	fields->function_id = massifg_label_table_intern_len(table->functions, frame, location-frame);
+
+	location++;
+	end--;
+	if (g_str_has_prefix(location, "in ")) {
+		location += 3;
+		fields->object_id = massifg_label_table_intern_len(table->objects, location, end-location);
+		return;
+	}
+
+	colon = g_strrstr_len(location, end-location, ":");
+	if (colon) {
+		fields->line = (guint)strtoul(colon+1, &line_end, 10);
+		if (line_end != end) {
+			/* Not a line number */
+			fields->line = 0;
+			colon = end;
+		}
+	}
+	else {
+		colon = end;
+	}
+	fields->file_id = massifg_label_table_intern_len(table->files, location, colon-location);
+}
+
+/* Public functions */
+
+/**
+ * massifg_label_table_new:
+ * @Returns: A new empty #MassifgLabelTable. Free with massifg_label_table_unref()
+ *
+ * Create a new #MassifgLabelTable.
+ */
+MassifgLabelTable *
+massifg_label_table_new(void) {
+	MassifgLabelTable *table = massifg_label_table_new_plain();
+
+	table->functions = massifg_label_table_new_plain();
+	table->files = massifg_label_table_new_plain();
+	table->objects = massifg_label_table_new_plain();
+	table->fields = g_new0(MassifgLabelFields *, LABEL_MAX_CHUNKS);
+	return table;
+}
+
+/**
+ * massifg_label_table_ref:
+ * @table: A #MassifgLabelTable
+ * @Returns: @table
+ *
+ * Increase the reference count of a #MassifgLabelTable.
+ */
+MassifgLabelTable *
+massifg_label_table_ref(MassifgLabelTable *table) {
+	g_atomic_int_inc(&table->ref_count);
+	return table;
+}
+
+/**
+ * massifg_label_table_unref:
+ * @table: A #MassifgLabelTable
+ *
+ * Decrease the reference count of a #MassifgLabelTable. When it reaches zero,
+ * the table is freed, including all the labels in it.
+ */
+void
+massifg_label_table_unref(MassifgLabelTable *table) {
+	guint i, chunk;
+
+	if (!g_atomic_int_dec_and_test(&table->ref_count))
+		return;
+
+	for (i=0; i<(guint)table->size; i++) {
+		g_string_free(massifg_label_table_get_unchecked(table, i), TRUE);
+	}
+	for (chunk=0; chunk<LABEL_MAX_CHUNKS; chunk++) {
+		g_free(table->labels[chunk]);
+	}
+	g_free(table->labels);
+	g_hash_table_destroy(table->ids);
+
+	if (table->fields) {
+		for (chunk=0; chunk<LABEL_MAX_CHUNKS; chunk++) {
+			g_free(table->fields[chunk]);
+		}
+		g_free(table->fields);
+		massifg_label_table_unref(table->functions);
+		massifg_label_table_unref(table->files);
+		massifg_label_table_unref(table->objects);
+	}
+	g_mutex_free(table->lock);
+	g_free(table);
+}
+
+/* Intern a label, with table->lock held */
+static guint
+massifg_label_table_intern_locked(MassifgLabelTable *table, const gchar *label) {
+	GString *str = NULL;
+	gpointer id = NULL;
+	guint new_id = (guint)table->size;
+	guint offset;
+	guint chunk = label_chunk(new_id, &offset);
+
+	if (g_hash_table_lookup_extended(table->ids, label, NULL, &id)) {
+		return GPOINTER_TO_UINT(id);
+	}
+
+	if (!table->labels[chunk]) {
+		table->labels[chunk] = g_new(GString *, LABEL_CHUNK_SIZE(chunk));
+		if (table->fields)
+			table->fields[chunk] = g_new(MassifgLabelFields, LABEL_CHUNK_SIZE(chunk));
+	}
+	if (table->fields) {
+		massifg_label_table_split(table, label, &table->fields[chunk][offset]);
+	}
+
+	/* The key points into the GString, which is never modified */
+	str = g_string_new(label);
+	table->labels[chunk][offset] = str;
+	g_hash_table_insert(table->ids, str->str, GUINT_TO_POINTER(new_id));
+
+	/* Only make the label visible to readers once it is stored */
+	g_atomic_int_set(&table->size, new_id+1);
+	return new_id;
+}
+
+/**
+ * massifg_label_table_intern:
+ * @table: A #MassifgLabelTable
+ * @label: The label to intern
+ * @Returns: The id of the label
+ *
+ * Add a label to the table if it is not already there, and get its id.
+ */
+guint
+massifg_label_table_intern(MassifgLabelTable *table, const gchar *label) {
+	guint id;
+
+	g_mutex_lock(table->lock);
+	id = massifg_label_table_intern_locked(table, label);
+	g_mutex_unlock(table->lock);
+	return id;
+}
+
+/**
+ * massifg_label_table_intern_string:
+ * @table: A #MassifgLabelTable
+ * @label: The label to intern
+ * @id: Location to store the id of the label
+ * @Returns: The interned label. Owned by @table, and must not be modified.
+ *
+ * Like massifg_label_table_intern(), but also gets the interned label,
+ * with a single lookup.
+ */
+GString *
+massifg_label_table_intern_string(MassifgLabelTable *table, const gchar *label, guint *id) {
+	GString *str = NULL;
+
+	g_mutex_lock(table->lock);
+	*id = massifg_label_table_intern_locked(table, label);
+	str = massifg_label_table_get_unchecked(table, *id);
+	g_mutex_unlock(table->lock);
+	return str;
+}
+
+/**
+ * massifg_label_table_get:
+ * @table: A #MassifgLabelTable
+ * @id: Id of the label, as returned by massifg_label_table_intern()
+ * @Returns: The label. Owned by @table, and must not be modified.
+ *
+ * Get a label by its id. Does not lock the table.
+ */
+GString *
+massifg_label_table_get(MassifgLabelTable *table, guint id) {
+	g_return_val_if_fail(id < massifg_label_table_size(table), NULL);
+	return massifg_label_table_get_unchecked(table, id);
+}
+
+/**
+ * massifg_label_table_size:
+ * @table: A #MassifgLabelTable
+ * @Returns: The number of labels in @table
+ *
+ * Get the number of distinct labels in the table. Labels interned by other
+ * threads at the same time may or may not be counted.
+ */
+guint
+massifg_label_table_size(MassifgLabelTable *table) {
+	return (guint)g_atomic_int_get(&table->size);
+}
+
+/**
+ * massifg_label_table_get_memory_size:
+ * @table: A #MassifgLabelTable
+ * @Returns: The estimated number of bytes used by @table
+ *
+ * Estimate the memory used by the labels in the table, including the tables
+ * of their parts, and the hash table for looking them up.
+ */
+gsize
+massifg_label_table_get_memory_size(MassifgLabelTable *table) {
+	GString *label = NULL;
+	gsize size = sizeof(MassifgLabelTable) + 2*LABEL_MAX_CHUNKS*sizeof(gpointer);
+	guint num_labels = massifg_label_table_size(table);
+	guint i, chunk;
+
+	for (i=0; i<num_labels; i++) {
+		label = massifg_label_table_get_unchecked(table, i);
+		size += sizeof(GString) + label->allocated_len + HASH_ENTRY_SIZE;
+	}
+	for (chunk=0; chunk<LABEL_MAX_CHUNKS && LABEL_FIRST_CHUNK_SIZE*((1u << chunk) - 1) < num_labels; chunk++) {
+		size += LABEL_CHUNK_SIZE(chunk)*sizeof(gpointer);
+		if (table->fields)
+			size += LABEL_CHUNK_SIZE(chunk)*sizeof(MassifgLabelFields);
+	}
+
+	if (table->fields) {
+		size += massifg_label_table_get_memory_size(table->functions);
+		size += massifg_label_table_get_memory_size(table->files);
+		size += massifg_label_table_get_memory_size(table->objects);
+	}
+	return size;
+}
+
+/**
+ * massifg_label_table_get_fields:
+ * @table: A #MassifgLabelTable
+ * @id: Id of the label, as returned by massifg_label_table_intern()
+ * @Returns: The parts of the label. Owned by @table, and valid as long as
+ * @table is.
+ *
+ * Get the parts a label was split into. Does not lock the table.
+ */
+const MassifgLabelFields *
+massifg_label_table_get_fields(MassifgLabelTable *table, guint id) {
+	guint offset;
+	guint chunk;
+
+	g_return_val_if_fail(table->fields != NULL, NULL);
+	g_return_val_if_fail(id < massifg_label_table_size(table), NULL);
+
+	chunk = label_chunk(id, &offset);
+	return &table->fields[chunk][offset];
+}
+
+/**
+ * massifg_label_table_get_short_label:
+ * @table: A #MassifgLabelTable
+ * @id: Id of the label, as returned by massifg_label_table_intern()
+ * @Returns: A newly allocated string. Free with g_free()
+ *
+ * Get a shorter version of a label, suitable for display in a legend. The code
+ * address and the arguments of C++ functions are dropped.
+ * Example: "0x4E0A: std::string::_Rep::_S_create(unsigned int) (in /usr/lib/libstdc++.so.6)"
+ * -> "std::string::_Rep::_S_create (in /usr/lib/libstdc++.so.6)"
+ */
+gchar *
+massifg_label_table_get_short_label(MassifgLabelTable *table, guint id) {
+	const MassifgLabelFields *fields = massifg_label_table_get_fields(table, id);
+	const gchar *function = NULL;
+	const gchar *args = NULL;
+	GString *short_label = NULL;
+
+	if (fields->function_id == MASSIFG_LABEL_NONE) {
+		return g_strdup(massifg_label_table_get(table, id)->str);
+	}
+
+	function = massifg_label_table_get(table->functions, fields->function_id)->str;
+	args = strchr(function, '(');
+	short_label = g_string_new_len(function, args ? args-function : -1);
+	g_strchomp(short_label->str);
+	short_label->len = strlen(short_label->str);
+
+	if (fields->file_id != MASSIFG_LABEL_NONE) {
+		g_string_append_printf(short_label, " (%s", massifg_label_table_get(table->files, fields->file_id)->str);
+		if (fields->line)
+			g_string_append_printf(short_label, ":%u", fields->line);
+		g_string_append_c(short_label, ')');
+	}
+	else if (fields->object_id != MASSIFG_LABEL_NONE) {
+		g_string_append_printf(short_label, " (in %s)",
+			massifg_label_table_get(table->objects, fields->object_id)->str);
+	}
+	return g_string_free(short_label, FALSE);
+}
+
+/**
+ * massifg_label_index_new:
+ * @table: The #MassifgLabelTable to index. Must outlive the index
+ * @Returns: A new #MassifgLabelIndex. Free with massifg_label_index_free()
+ *
+ * Create an index over all the labels that are currently in @table.
+ * Labels added to @table later can be indexed with massifg_label_index_update().
+ */
+MassifgLabelIndex *
+massifg_label_index_new(MassifgLabelTable *table) {
+	MassifgLabelIndex *index = g_new(MassifgLabelIndex, 1);
+
+	index->table = table;
+	index->num_indexed = 0;
+	index->frozen = FALSE;
+	index->folded_chunk = g_string_chunk_new(64*1024);
+	index->folded_labels = g_ptr_array_new();
+	index->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, (GDestroyNotify)g_array_unref);
+
+	massifg_label_index_update(index);
+	return index;
+}
+
+/**
+ * massifg_label_index_free:
+ * @index: A #MassifgLabelIndex
+ *
+ * Free a #MassifgLabelIndex. The #MassifgLabelTable it indexes is not freed.
+ */
+void
+massifg_label_index_free(MassifgLabelIndex *index) {
+	g_hash_table_destroy(index->trigrams);
+	g_ptr_array_free(index->folded_labels, TRUE);
+	g_string_chunk_free(index->folded_chunk);
+	g_free(index);
+}
+
+/**
+ * massifg_label_index_freeze:
+ * @index: A #MassifgLabelIndex
+ *
+ * Stop adding labels to the index, even if more are added to its table.
+ * A frozen index is not modified any more, so it can be searched from
+ * several threads at the same time without locking.
+ */
+void
+massifg_label_index_freeze(MassifgLabelIndex *index) {
+	index->frozen = TRUE;
+}
+
+/**
+ * massifg_label_index_update:
+ * @index: A #MassifgLabelIndex
+ *
+ * Add the labels that have been added to the #MassifgLabelTable since the index
+ * was created or last updated. The cost is proportional to the size of the new labels.
+ * Does nothing once the index is frozen with massifg_label_index_freeze().
+ */
+void
+massifg_label_index_update(MassifgLabelIndex *index) {
+	GString *label = NULL;
+	GArray *ids = NULL;
+	gchar *folded = NULL;
+	gsize i;
+	guint id, key;
+
+	if (index->frozen)
+		return;
+
+	for (id=index->num_indexed; id<massifg_label_table_size(index->table); id++) {
+		label = massifg_label_table_get(index->table, id);
+
+		folded = g_ascii_strdown(label->str, label->len);
+		g_ptr_array_add(index->folded_labels,
+				g_string_chunk_insert_len(index->folded_chunk, folded, label->len));
+		g_free(folded);
+		folded = (gchar *)g_ptr_array_index(index->folded_labels, id);
+
+		/* Ids are added in increasing order, so the id lists stay sorted,
+		 * and a trigram that appears several times in a label is at the end of the list */
+		for (i=0; i+3<=label->len; i++) {
+			key = trigram_key(folded+i);
+			ids = (GArray *)g_hash_table_lookup(index->trigrams, GUINT_TO_POINTER(key));
+			if (!ids) {
+				ids = g_array_new(FALSE, FALSE, sizeof(guint));
+				g_hash_table_insert(index->trigrams, GUINT_TO_POINTER(key), ids);
+			}
+			if (ids->len == 0 || g_array_index(ids, guint, ids->len-1) != id) {
+				g_array_append_val(ids, id);
+			}
+		}
+	}
+	index->num_indexed = id;
+}
+
+/**
+ * massifg_label_index_get_memory_size:
+ * @index: A #MassifgLabelIndex
+ * @Returns: The estimated number of bytes used by @index
+ *
+ * Estimate the memory used by the index, not counting the #MassifgLabelTable.
+ */
+gsize
+massifg_label_index_get_memory_size(MassifgLabelIndex *index) {
+	GHashTableIter iter;
+	gpointer ids = NULL;
+	gsize size = sizeof(MassifgLabelIndex);
+	guint i;
+
+	for (i=0; i<index->folded_labels->len; i++) {
+		size += strlen((const gchar *)g_ptr_array_index(index->folded_labels, i)) + 1 + sizeof(gpointer);
+	}
+
+	g_hash_table_iter_init(&iter, index->trigrams);
+	while (g_hash_table_iter_next(&iter, NULL, &ids)) {
+		size += HASH_ENTRY_SIZE + sizeof(GArray) + ((GArray *)ids)->len*sizeof(guint);
+	}
+	return size;
+}
+
+/**
+ * massifg_label_index_search:
+ * @index: A #MassifgLabelIndex
+ * @str: The string to search for
+ * @Returns: A #GArray of guint with the ids of the labels containing @str,
+ * in increasing order. Free with g_array_free().
+ *
+ * Find the labels that contain a string, ignoring case.
+ * An empty string matches all labels.
+ */
+GArray *
+massifg_label_index_search(MassifgLabelIndex *index, const gchar *str) {
+	GArray *result = g_array_new(FALSE, FALSE, sizeof(guint));
+	GPtrArray *id_lists = NULL;
+	GArray *ids = NULL;
+	gchar *folded_str = NULL;
+	gsize len, i;
+	guint id, n;
+
+	g_return_val_if_fail(str != NULL, result);
+
+	len = strlen(str);
+	folded_str = g_ascii_strdown(str, len);
+
+	if (len < 3) {
+		/* Too short to have any trigrams, check all labels */
+		for (id=0; id<index->num_indexed; id++) {
+			if (strstr((gchar *)g_ptr_array_index(index->folded_labels, id), folded_str)) {
+				g_array_append_val(result, id);
+			}
+		}
+		g_free(folded_str);
+		return result;
+	}
+
+	/* Find the id lists for all the trigrams in str */
+	id_lists = g_ptr_array_new();
+	for (i=0; i+3<=len; i++) {
+		ids = (GArray *)g_hash_table_lookup(index->trigrams,
+				GUINT_TO_POINTER(trigram_key(folded_str+i)));
+		if (!ids) {
+			/* No label has this trigram */
+			g_ptr_array_free(id_lists, TRUE);
+			g_free(folded_str);
+			return result;
+		}
+		g_ptr_array_add(id_lists, ids);
+	}
+
+	/* Intersect them, starting with the shortest to keep the candidates few */
+	g_ptr_array_sort(id_lists, compare_array_length);
+	ids = (GArray *)g_ptr_array_index(id_lists, 0);
+	g_array_append_vals(result, ids->data, ids->len);
+	for (i=1; i<id_lists->len && result->len > 0; i++) {
+		intersect_ids(result, (GArray *)g_ptr_array_index(id_lists, i));
+	}
+
+	/* Having all the trigrams does not mean that they are in the right order */
+	n = 0;
+	for (i=0; i<result->len; i++) {
+		id = g_array_index(result, guint, i);
+		if (strstr((gchar *)g_ptr_array_index(index->folded_labels, id), folded_str)) {
+			g_array_index(result, guint, n++) = id;
+		}
+	}
+	g_array_set_size(result, n);
+
+	g_ptr_array_free(id_lists, TRUE);
+	g_free(folded_str);
+	return result;
+}
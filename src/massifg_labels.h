@@ -0,0 +1,130 @@
+/*
+ *  MassifG - massifg_labels.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_LABELS_H__
+#define MASSIFG_LABELS_H__
+
+#include <glib.h>
+
+/**
+ * MASSIFG_LABEL_NONE:
+ *
+ * Label id of a label that is not in any #MassifgLabelTable.
+ */
+#define MASSIFG_LABEL_NONE G_MAXUINT
+
+/* Data structures */
+
+/**
+ * MassifgLabelFields:
+ * @address: Code address of the stack frame, or 0 if the label has none.
+ * @function_id: Id of the function name in the @functions table of the
+ * #MassifgLabelTable, or %MASSIFG_LABEL_NONE.
+ * @file_id: Id of the source file name in the @files table, or %MASSIFG_LABEL_NONE.
+ * @line: Line number in the source file, or 0 if unknown.
+ * @object_id: Id of the shared object name in the @objects table, or %MASSIFG_LABEL_NONE.
+ *
+ * A heap tree label split into its parts. Massif labels stack frames as
+ * "0x5792ABD: dictresize (dictobject.c:517)" when there is debug information,
+ * and as "0x54A26EE: ??? (in /lib/libselinux.so.1)" when there is not.
+ * Labels that are not stack frames, such as the ones for allocations below
+ * massif's threshold, have no parts and @function_id is %MASSIFG_LABEL_NONE.
+ */
+typedef struct {
+	guint64 address;
+	guint function_id;
+	guint file_id;
+	guint line;
+	guint object_id;
+} MassifgLabelFields;
+
+/**
+ * MassifgLabelTable:
+ * @functions: The function names in the labels.
+ * @files: The source file names in the labels.
+ * @objects: The shared object names in the labels.
+ *
+ * A table of interned labels. Each distinct label is stored once,
+ * and identified by an id. Ids are assigned from 0 and up, in the order the
+ * labels are first interned. Each label is split into #MassifgLabelFields when
+ * it is interned, with the strings in it interned in the tables of the
+ * corresponding part. These tables do not split their own labels.
+ *
+ * A table can be shared by several #MassifgOutputData, so that labels can be
+ * compared between them by id. It is reference counted, and labels can be
+ * interned and looked up from several threads at the same time. Looking up
+ * a label or its parts by id does not lock the table.
+ */
+typedef struct _MassifgLabelTable MassifgLabelTable;
+struct _MassifgLabelTable {
+	MassifgLabelTable *functions;
+	MassifgLabelTable *files;
+	MassifgLabelTable *objects;
+
+	/*< private >*/
+	volatile gint ref_count;
+	volatile gint size;
+	GMutex *lock; /* Only taken to intern */
+
+	GHashTable *ids;
+	GString ***labels; /* Chunks of labels, which are never moved */
+	MassifgLabelFields **fields; /* Chunks of fields, or NULL if labels are not split */
+};
+
+/**
+ * MassifgLabelIndex:
+ *
+ * A trigram index for finding the labels in a #MassifgLabelTable
+ * that contain a string.
+ */
+typedef struct {
+	/*< private >*/
+	MassifgLabelTable *table;
+	guint num_indexed;
+	gboolean frozen;
+
+	GStringChunk *folded_chunk;
+	GPtrArray *folded_labels;
+	GHashTable *trigrams;
+} MassifgLabelIndex;
+
+/* Public functions */
+MassifgLabelTable *massifg_label_table_new(void);
+MassifgLabelTable *massifg_label_table_ref(MassifgLabelTable *table);
+void massifg_label_table_unref(MassifgLabelTable *table);
+
+guint massifg_label_table_intern(MassifgLabelTable *table, const gchar *label);
+GString *massifg_label_table_intern_string(MassifgLabelTable *table, const gchar *label, guint *id);
+GString *massifg_label_table_get(MassifgLabelTable *table, guint id);
+guint massifg_label_table_size(MassifgLabelTable *table);
+const MassifgLabelFields *massifg_label_table_get_fields(MassifgLabelTable *table, guint id);
+gchar *massifg_label_table_get_short_label(MassifgLabelTable *table, guint id);
+gsize massifg_label_table_get_memory_size(MassifgLabelTable *table);
+
+MassifgLabelIndex *massifg_label_index_new(MassifgLabelTable *table);
+void massifg_label_index_free(MassifgLabelIndex *index);
+
+void massifg_label_index_update(MassifgLabelIndex *index);
+void massifg_label_index_freeze(MassifgLabelIndex *index);
+gsize massifg_label_index_get_memory_size(MassifgLabelIndex *index);
+GArray *massifg_label_index_search(MassifgLabelIndex *index, const gchar *str);
+
+#endif /* MASSIFG_LABELS_H__ */
@@ -33,15 +33,34 @@
 #include <string.h>
 
 #include <glib.h>
+#include "config.h"
 
 #include "massifg_parser.h"
 #include "massifg_parser_private.h"
+#include "massifg_trace.h"
 #include "massifg_utils.h"
 
 /* Private datastructures */
 #define MASSIFG_PARSE_ERROR g_quark_from_string("MASSIFG_PARSE_ERROR")
 static const gint MASSIFG_PARSE_ERROR_NOSNAPSHOTS = 1;
 
+/* Memory budget of the parsers that are not given one, see massifg_parser_set_default_memory_budget() */
+static gsize default_memory_budget_B = 0;
+
+/* Whether parsers build a union tree, see massifg_parser_set_default_build_union_tree() */
+static gboolean default_build_union_tree = FALSE;
+
+/* Memory a heap tree node uses, counted against the memory budget */
+#define HEAP_TREE_NODE_B (sizeof(MassifgHeapTreeNode) + sizeof(GNode))
+
+/* A heap tree node in the spill file. The nodes of a tree are written in preorder,
+ * so the structure of the tree follows from the number of children */
+typedef struct {
+	guint32 label_id;
+	guint32 num_children;
+	gint64 total_mem_B;
+} HeapTreeRecord;
+
 /* Enum for the different possible states the parser state-machine can be in */
 typedef enum {
 	STATE_DESC,
@@ -62,33 +81,75 @@ typedef enum {
  * the central functions that implement the parser */
 struct _MassifgParser {
 	MassifgParserState current_state;
-	MassifgSnapshot *current_snapshot;
+	MassifgSnapshot *current_snapshot; /* Not in output_data until it is complete */
 	GNode *ht_current_parent;
 	gint current_line_number;
 	MassifgOutputData *output_data;
+	GList *last_snapshot; /* Last element of output_data->snapshots, for appending */
+	guint num_snapshots; /* Length of output_data->snapshots */
+	GString *partial_line; /* Start of a line fed without its end, see massifg_parser_feed() */
+	MassifgSummary *summary; /* Only set when summarizing, see massifg_summarize_iochannel() */
+	MassifgTraceSpan heap_tree_span; /* Building the heap tree of current_snapshot */
 };
-typedef struct _MassifgParser MassifgParser;
 
 /* Private functions */
 
-MassifgParser *
-massifg_parser_new(void) {
-	MassifgParser *parser = g_new(MassifgParser, 1);
+static MassifgOutputData *massifg_output_data_new(MassifgLabelTable *labels);
+static void massifg_snapshot_free(MassifgSnapshot *snapshot, MassifgOutputData *data);
+static void massifg_summary_finish_snapshot(MassifgParser *parser);
+static void massifg_output_data_enforce_budget(MassifgOutputData *data);
+static void massifg_heap_tree_node_set_self_mem(GNode *node);
 
-	parser->current_state = STATE_DESC;
-	parser->current_line_number = 0;
+/* Called when the current snapshot has been parsed completely.
+ * It is added to the output data, so that the output data only ever has complete snapshots */
+static void
+massifg_parser_complete_snapshot(MassifgParser *parser) {
+	MassifgOutputData *data = parser->output_data;
+	MassifgSnapshot *snapshot = parser->current_snapshot;
+	GNode *node = NULL;
+
+	if (!snapshot)
+		return;
+
+	if (parser->summary) {
+		/* Only the snapshot being parsed is kept */
+		massifg_summary_finish_snapshot(parser);
+		return;
+	}
+
+	if (!parser->last_snapshot) {
+		data->snapshots = g_list_append(NULL, snapshot);
+		parser->last_snapshot = data->snapshots;
+	}
+	else {
+		parser->last_snapshot = g_list_append(parser->last_snapshot, snapshot)->next;
+	}
 	parser->current_snapshot = NULL;
-	parser->output_data = NULL;
-	parser->ht_current_parent = NULL;
+	snapshot->has_heap_tree = snapshot->heap_tree != NULL;
 
-	return parser;
-}
+	/* The nodes on the path to the last node of a tree cut short by the end of
+	 * the output were never closed. Their children so far are all there is */
+	if (snapshot->heap_tree && parser->current_state != STATE_SNAPSHOT) {
+		for (node = parser->ht_current_parent; node; node = node->parent) {
+			massifg_heap_tree_node_set_self_mem(node);
+		}
+	}
 
-void
-massifg_parser_free(MassifgParser *parser) {
-	/* Currently all pointers point to data which is owned by someone else
-	 * so we only free the MassifgParser structure */
-	g_free(parser);
+	/* Added before the tree can be spilled */
+	if (data->union_tree && snapshot->heap_tree) {
+		massifg_union_tree_add_heap_tree(data->union_tree, parser->num_snapshots, snapshot->heap_tree);
+	}
+	parser->num_snapshots++;
+
+	/* A tree cut short by the end of the output is never spilled,
+	 * its nodes do not have the number of children they claim */
+	if (data->memory_budget_B && snapshot->heap_tree && parser->current_state == STATE_SNAPSHOT) {
+		g_mutex_lock(data->spill_lock);
+		g_queue_push_tail(data->resident, snapshot);
+		snapshot->resident_link = data->resident->tail;
+		massifg_output_data_enforce_budget(data);
+		g_mutex_unlock(data->spill_lock);
+	}
 }
 
 /* Turn the line into tokens, splitting on delim
@@ -98,8 +159,8 @@ massifg_tokenify_line(const gchar *line, const gchar *delim) {
 	gchar **tokens;
 
 	tokens = g_strsplit(line, delim, 2);
-	g_debug("Tokenified entry: key=\"%s\", value=\"%s\"",
-		tokens[0], tokens[1]);
+	MASSIFG_NOTE(PARSER, g_debug("Tokenified entry: key=\"%s\", value=\"%s\"",
+		tokens[0], tokens[1]));
 
 	return tokens;
 }
@@ -145,6 +206,11 @@ massifg_snapshot_new() {
 
 	snapshot->heap_tree_desc = g_string_new("");
 	snapshot->heap_tree = NULL;
+	snapshot->has_heap_tree = FALSE;
+	snapshot->spill_offset = -1;
+	snapshot->spill_num_nodes = 0;
+	snapshot->pin_count = 0;
+	snapshot->resident_link = NULL;
 
 	/* Initialize */
 	snapshot->snapshot_no = -1;
@@ -155,6 +221,63 @@ massifg_snapshot_new() {
 	return snapshot;
 }
 
+/* Sort MassifgAllocator pointers by memory, largest first */
+static gint
+massifg_allocator_compare(gconstpointer a, gconstpointer b) {
+	const MassifgAllocator *allocator_a = *(const MassifgAllocator **)a;
+	const MassifgAllocator *allocator_b = *(const MassifgAllocator **)b;
+
+	if (allocator_a->mem_B != allocator_b->mem_B)
+		return allocator_a->mem_B > allocator_b->mem_B ? -1 : 1;
+	return 0;
+}
+
+static void
+massifg_allocator_free(MassifgAllocator *allocator) {
+	g_free(allocator->label);
+	g_free(allocator);
+}
+
+/* Fold the snapshot that was just parsed into the summary, and free it.
+ * Only the allocators of the largest snapshot with a heap tree so far are kept */
+static void
+massifg_summary_finish_snapshot(MassifgParser *parser) {
+	MassifgSummary *summary = parser->summary;
+	MassifgSnapshot *snapshot = parser->current_snapshot;
+	GPtrArray *allocators = summary->current_allocators;
+	gint64 total_mem_B;
+
+	if (!snapshot)
+		return;
+
+	total_mem_B = snapshot->mem_heap_B + snapshot->mem_heap_extra_B + snapshot->mem_stacks_B;
+	summary->num_snapshots++;
+	if (summary->peak_snapshot_no < 0 || total_mem_B > summary->peak_mem_B) {
+		summary->peak_snapshot_no = snapshot->snapshot_no;
+		summary->peak_time = snapshot->time;
+		summary->peak_mem_B = total_mem_B;
+	}
+
+	if (summary->in_heap_tree &&
+	    (summary->peak_tree_snapshot_no < 0 || total_mem_B > summary->peak_tree_mem_B)) {
+		summary->peak_tree_snapshot_no = snapshot->snapshot_no;
+		summary->peak_tree_mem_B = total_mem_B;
+
+		g_ptr_array_sort(allocators, massifg_allocator_compare);
+		if (allocators->len > summary->num_allocators) {
+			g_ptr_array_remove_range(allocators, summary->num_allocators,
+					allocators->len - summary->num_allocators);
+		}
+		summary->current_allocators = summary->peak_allocators;
+		summary->peak_allocators = allocators;
+	}
+	g_ptr_array_remove_range(summary->current_allocators, 0, summary->current_allocators->len);
+	summary->in_heap_tree = FALSE;
+
+	massifg_snapshot_free(snapshot, parser->output_data);
+	parser->current_snapshot = NULL;
+}
+
 /* Parse snapshot identifier, and initialize the snapshot datastructure. Format:
  * #-----------
  * snapshot=N
@@ -164,6 +287,8 @@ static void
 massifg_parse_snapshot(MassifgParser *parser, const gchar *line) {
 	gchar **kv_tokens;
 	if (g_str_has_prefix(line, "snapshot=")) {
+		/* In case the previous snapshot was cut short */
+		massifg_parser_complete_snapshot(parser);
 		parser->current_snapshot = massifg_snapshot_new();
 
 		/* Actually parse and set correct snapshot number */
@@ -171,9 +296,6 @@ massifg_parse_snapshot(MassifgParser *parser, const gchar *line) {
 		parser->current_snapshot->snapshot_no = atoi(kv_tokens[1]);
 		g_strfreev(kv_tokens);
 
-		/* Add to output data structure */
-		parser->output_data->snapshots =
-			g_list_append(parser->output_data->snapshots, parser->current_snapshot);
 
 		parser->current_state = STATE_SNAPSHOT_TIME;
 
@@ -211,7 +333,8 @@ massifg_parse_snapshot_mem_stacks(MassifgParser *parser, const gchar *line) {
 }
 
 /* Parse heap tree identifier 
- * Format: "heap_tree=value", where value can be "details", "empty" or "peak"*/
+ * Format: "heap_tree=value", where value can be "detailed", "empty" or "peak".
+ * The peak snapshot has a heap tree just like the detailed ones */
 static void
 massifg_parse_heap_tree_desc(MassifgParser *parser, const gchar *line) {
 	gchar **kv_tokens;
@@ -220,10 +343,19 @@ massifg_parse_heap_tree_desc(MassifgParser *parser, const gchar *line) {
 		g_string_printf(parser->current_snapshot->heap_tree_desc, "%s", kv_tokens[1]);
 		g_strfreev(kv_tokens);
 
-		if (g_strcmp0(parser->current_snapshot->heap_tree_desc->str, "empty") == 0)
+		if (g_strcmp0(parser->current_snapshot->heap_tree_desc->str, "empty") == 0) {
 			parser->current_state = STATE_SNAPSHOT;
-		else if (g_strcmp0(parser->current_snapshot->heap_tree_desc->str, "detailed") == 0)
+			massifg_parser_complete_snapshot(parser);
+		}
+		else if (g_strcmp0(parser->current_snapshot->heap_tree_desc->str, "detailed") == 0 ||
+		         g_strcmp0(parser->current_snapshot->heap_tree_desc->str, "peak") == 0) {
 			parser->current_state = STATE_SNAPSHOT_HEAP_TREE_NODE;
+			if (parser->summary) {
+				/* Expecting the root node */
+				parser->summary->in_heap_tree = TRUE;
+				parser->summary->remaining_nodes = 1;
+			}
+		}
 	}
 }
 
@@ -276,7 +408,10 @@ massifg_heap_tree_node_new(const gchar *line) {
 	MassifgHeapTreeNode *node = g_new(MassifgHeapTreeNode, 1);
 
 	node->label = g_string_new("");
+	node->subtree_hash = 0;
+	node->label_id = MASSIFG_LABEL_NONE;
 	massifg_heap_tree_node_init_simple_attributes(node, line);
+	node->self_mem_B = node->total_mem_B;
 
 	return node;
 }
@@ -284,27 +419,164 @@ massifg_heap_tree_node_new(const gchar *line) {
 /* Free a MassifgHeapTreeNode */
 void
 massifg_heap_tree_node_free(MassifgHeapTreeNode *node) {
-	g_string_free(node->label, TRUE);
+	/* Interned labels are owned by the label table */
+	if (node->label_id == MASSIFG_LABEL_NONE) {
+		g_string_free(node->label, TRUE);
+	}
 	g_free(node);
 }
 
+/* Shared subtrees
+ * The children of a node is a list of sibling GNodes, which can only be shared
+ * as a whole, since the sibling pointers are part of the list.
+ * subtrees is a table over all the children lists that can be shared, with
+ * the number of nodes referring to the list as the value. The hash and equality
+ * functions compare the lists structurally. Because the children of the nodes
+ * in a list were made shared before the list itself, two equal lists must
+ * have pointer-identical grandchildren, so the comparison does not need to recurse. */
+
+static guint
+massifg_heap_tree_children_hash(gconstpointer key) {
+	const GNode *child = (const GNode *)key;
+	guint hash = 17;
+
+	for (; child; child = child->next) {
+		hash = hash*31 + ((MassifgHeapTreeNode *)child->data)->subtree_hash;
+	}
+	return hash;
+}
+
+static gboolean
+massifg_heap_tree_children_equal(gconstpointer a, gconstpointer b) {
+	const GNode *child_a = (const GNode *)a;
+	const GNode *child_b = (const GNode *)b;
+	MassifgHeapTreeNode *node_a = NULL;
+	MassifgHeapTreeNode *node_b = NULL;
+
+	for (; child_a && child_b; child_a = child_a->next, child_b = child_b->next) {
+		node_a = (MassifgHeapTreeNode *)child_a->data;
+		node_b = (MassifgHeapTreeNode *)child_b->data;
+
+		if (child_a->children != child_b->children ||
+		    node_a->subtree_hash != node_b->subtree_hash ||
+		    node_a->total_mem_B != node_b->total_mem_B ||
+		    node_a->num_children != node_b->num_children ||
+		    node_a->parsing_depth != node_b->parsing_depth ||
+		    (node_a->label != node_b->label && !g_string_equal(node_a->label, node_b->label))) {
+			return FALSE;
+		}
+	}
+	return child_a == child_b; /* Both lists must end at the same time */
+}
+
+/* Drop the reference node has to its children, freeing them if no other node refers to them.
+ * Lists that are not in the subtrees of data are only referred to by node */
+static void
+massifg_heap_tree_free_children(MassifgOutputData *data, GNode *node) {
+	GHashTable *subtrees = data->subtrees;
+	GNode *child = node->children;
+	GNode *next = NULL;
+	gpointer shared_list = NULL;
+	gpointer refs = NULL;
+
+	node->children = NULL;
+	if (!child)
+		return;
+
+	if (g_hash_table_lookup_extended(subtrees, child, &shared_list, &refs) &&
+	    shared_list == child) {
+		if (GPOINTER_TO_INT(refs) > 1) {
+			g_hash_table_insert(subtrees, child, GINT_TO_POINTER(GPOINTER_TO_INT(refs)-1));
+			return;
+		}
+		g_hash_table_remove(subtrees, child);
+	}
+
+	while (child) {
+		next = child->next;
+		massifg_heap_tree_free_children(data, child);
+		massifg_heap_tree_node_free((MassifgHeapTreeNode *)child->data);
+		data->heap_trees_B -= HEAP_TREE_NODE_B;
+
+		/* Detach it first, the parent might already be gone */
+		child->parent = child->next = child->prev = NULL;
+		g_node_destroy(child);
+		child = next;
+	}
+}
+
+/* Free a heap tree, including the subtrees that are not shared with other trees */
+static void
+massifg_heap_tree_free(MassifgOutputData *data, GNode *heap_tree) {
+	massifg_heap_tree_free_children(data, heap_tree);
+	massifg_heap_tree_node_free((MassifgHeapTreeNode *)heap_tree->data);
+	data->heap_trees_B -= HEAP_TREE_NODE_B;
+	g_node_destroy(heap_tree);
+}
+
+/* Set the memory of node that is not under any of its children */
+static void
+massifg_heap_tree_node_set_self_mem(GNode *node) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	GNode *child = NULL;
+
+	n->self_mem_B = n->total_mem_B;
+	for (child = node->children; child; child = child->next) {
+		n->self_mem_B -= ((MassifgHeapTreeNode *)child->data)->total_mem_B;
+	}
+}
+
+/* Called when all the nodes in the subtree under node have been parsed.
+ * Replaces the children of node with an identical list from an earlier subtree, if any,
+ * and computes the memory of node itself and the structural hash of the subtree.
+ * The memory of node itself follows from the children, so it is not part of the hash */
+static void
+massifg_heap_tree_close_subtree(MassifgOutputData *data, GNode *node) {
+	GHashTable *subtrees = data->subtrees;
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	gint64 mem = n->total_mem_B;
+	gpointer shared_list = NULL;
+	gpointer refs = NULL;
+
+	if (node->children) {
+		if (g_hash_table_lookup_extended(subtrees, node->children, &shared_list, &refs)) {
+			g_hash_table_insert(subtrees, shared_list, GINT_TO_POINTER(GPOINTER_TO_INT(refs)+1));
+			massifg_heap_tree_free_children(data, node);
+			node->children = (GNode *)shared_list;
+		}
+		else {
+			g_hash_table_insert(subtrees, node->children, GINT_TO_POINTER(1));
+		}
+	}
+	massifg_heap_tree_node_set_self_mem(node);
+
+	n->subtree_hash = g_str_hash(n->label->str);
+	n->subtree_hash = n->subtree_hash*31 + (guint)(mem ^ (mem >> 32));
+	n->subtree_hash = n->subtree_hash*31 + (guint)n->parsing_depth;
+	n->subtree_hash = n->subtree_hash*31 + massifg_heap_tree_children_hash(node->children);
+}
+
 /* Find the parent the next node should go to after the end of a subtree has been reached
+ * The subtree under current_parent, and the subtrees of all parents that are completed
+ * by it, are closed with massifg_heap_tree_close_subtree()
  * Returns NULL if no suitable parent can be found */
 static GNode *
-massifg_heap_tree_get_next_parent(GNode *current_parent) {
+massifg_heap_tree_get_next_parent(MassifgParser *parser, GNode *current_parent) {
 	GNode *next_parent = current_parent->parent;
 
+	massifg_heap_tree_close_subtree(parser->output_data, current_parent);
 	while ( next_parent &&
 	((MassifgHeapTreeNode *)next_parent->data)->parsing_remaining_children == 0) {
-/*		g_message("%d, %s", ((MassifgHeapTreeNode *)next_parent->data)->parsing_remaining_children,*/
-/*			((MassifgHeapTreeNode *)next_parent->data)->label->str);*/
+		massifg_heap_tree_close_subtree(parser->output_data, next_parent);
 		next_parent = next_parent->parent;
 	}
-	if (next_parent)
-		g_debug("Found next parent, label: \"%s\"",
-			((MassifgHeapTreeNode *)next_parent->data)->label->str);
-	else
-		g_debug("Heap tree complete");
+	if (next_parent) {
+		MASSIFG_NOTE(PARSER, g_debug("Found next parent, label: \"%s\"",
+			((MassifgHeapTreeNode *)next_parent->data)->label->str));
+	}
+	else {
+		MASSIFG_NOTE(PARSER, g_debug("Heap tree complete"));
+	}
 	return next_parent;
 }
 
@@ -321,13 +593,19 @@ massifg_parse_heap_tree_node(MassifgParser *parser, const gchar *line) {
 	GNode *next_parent = parser->ht_current_parent;
 	MassifgHeapTreeNode *tmp_node = NULL;
 
-	/* Create a new node */
+	/* Create a new node, and share its label with the other nodes that have it */
 	MassifgHeapTreeNode *new_node = massifg_heap_tree_node_new(line);
+	GString *label = massifg_label_table_intern_string(parser->output_data->labels,
+				new_node->label->str, &new_node->label_id);
+	g_string_free(new_node->label, TRUE);
+	new_node->label = label;
+	parser->output_data->heap_trees_B += HEAP_TREE_NODE_B;
 
 	/* Add the node to the tree */
 	if (!snapshot->heap_tree) {
 		/* This is the first node, create the root */
-		g_debug("Creating heap tree root node");
+		MASSIFG_NOTE(PARSER, g_debug("Creating heap tree root node"));
+		massifg_trace_begin(&parser->heap_tree_span, "heap-tree");
 		snapshot->heap_tree = g_node_new((gpointer)new_node);
 		next_parent = snapshot->heap_tree;
 	}
@@ -343,19 +621,24 @@ massifg_parse_heap_tree_node(MassifgParser *parser, const gchar *line) {
 
 	/* Check if we are at the end of a tree */
 	if (new_node->num_children == 0) {
+		/* Check the depth first, closing the subtree can free new_node
+		 * if an identical subtree has been parsed before */
+		if (next_parent->parent) {
+			tmp_node = (MassifgHeapTreeNode *)parser->ht_current_parent->data;
+			g_assert(new_node->parsing_depth ==  tmp_node->parsing_depth+1);
+		}
+
 		/* End of a subtree, the next node belongs to a parent further up
 		 * This parent can be found by traversing back up the tree and locating the
 		 * first node with non-zero parsing_expected_children */
-		next_parent = massifg_heap_tree_get_next_parent(next_parent);
+		next_parent = massifg_heap_tree_get_next_parent(parser, next_parent);
 		if (!next_parent) {
 			/* No node has missing children, so this was the
 			 * last node in the heap tree,
 			 * and we expect a new snapshot to come next */
+			massifg_trace_end(&parser->heap_tree_span);
 			parser->current_state = STATE_SNAPSHOT;
-		}
-		else {
-			tmp_node = (MassifgHeapTreeNode *)parser->ht_current_parent->data;
-			g_assert(new_node->parsing_depth ==  tmp_node->parsing_depth+1);
+			massifg_parser_complete_snapshot(parser);
 		}
 	}
 
@@ -363,12 +646,36 @@ massifg_parse_heap_tree_node(MassifgParser *parser, const gchar *line) {
 	parser->ht_current_parent = next_parent;
 }
 
+/* Like massifg_parse_heap_tree_node(), but without building the heap tree.
+ * Only the children of the root are kept, as the allocators of the snapshot */
+static void
+massifg_summarize_heap_tree_node(MassifgParser *parser, const gchar *line) {
+	MassifgSummary *summary = parser->summary;
+	MassifgHeapTreeNode *node = massifg_heap_tree_node_new(line);
+	MassifgAllocator *allocator = NULL;
+
+	if (node->parsing_depth == 1) {
+		allocator = g_new(MassifgAllocator, 1);
+		allocator->label = g_strdup(node->label->str);
+		allocator->mem_B = node->total_mem_B;
+		g_ptr_array_add(summary->current_allocators, allocator);
+	}
+
+	/* The tree is complete when all the nodes the parents expect have been seen */
+	summary->remaining_nodes += node->num_children - 1;
+	massifg_heap_tree_node_free(node);
+	if (summary->remaining_nodes <= 0) {
+		parser->current_state = STATE_SNAPSHOT;
+		massifg_parser_complete_snapshot(parser);
+	}
+}
+
 /* Parse a single line, based on the current state of the parser
  * NOTE: function assumes that the line does not contain any trailing newline character */
 static void 
 massifg_parse_line(MassifgParser *parser, gchar const *line) {
-	g_debug("Parsing line %d: \"%s\". Parser state: %d", parser->current_line_number,
-		line, parser->current_state);
+	MASSIFG_NOTE(PARSER, g_debug("Parsing line %d: \"%s\". Parser state: %d",
+		parser->current_line_number, line, parser->current_state));
 
 	switch (parser->current_state) {
 
@@ -414,15 +721,19 @@ massifg_parse_line(MassifgParser *parser, gchar const *line) {
 		break;
 	/* Snapshot heap tree entries */
 	case STATE_SNAPSHOT_HEAP_TREE_NODE:
-		massifg_parse_heap_tree_node(parser, line);
+		if (parser->summary)
+			massifg_summarize_heap_tree_node(parser, line);
+		else
+			massifg_parse_heap_tree_node(parser, line);
 		break;
 	}
 }
 
 /* Allocate and initialize a MassifgOutputData structure, returning a pointer to it
- * Use massifg_output_data_free() to free */
+ * The labels are interned in labels if it is not NULL, else in a new table
+ * Release with massifg_output_data_unref() */
 static MassifgOutputData *
-massifg_output_data_new() {
+massifg_output_data_new(MassifgLabelTable *labels) {
 	MassifgOutputData *data;
 	data = (MassifgOutputData*) g_malloc(sizeof(MassifgOutputData));
 
@@ -435,21 +746,593 @@ massifg_output_data_new() {
 	data->max_time = 0;
 	data->max_mem_allocation = 0;
 
+	data->labels = labels ? massifg_label_table_ref(labels) : massifg_label_table_new();
+	data->label_index = massifg_label_index_new(data->labels);
+	data->union_tree = NULL;
+
+	data->subtrees = g_hash_table_new(massifg_heap_tree_children_hash,
+				massifg_heap_tree_children_equal);
+	data->ref_count = 1;
+
+	data->memory_budget_B = 0;
+	data->heap_trees_B = 0;
+	data->spill_lock = NULL;
+	data->resident = NULL;
+	data->spill_file = NULL;
+	data->spill_failed = FALSE;
+
 	return data;
 }
 
+/* Free a MassifgSnapshot, dropping its references to shared subtrees */
+static void
+massifg_snapshot_free(MassifgSnapshot *snapshot, MassifgOutputData *data) {
+	if (snapshot->resident_link) {
+		g_queue_delete_link(data->resident, snapshot->resident_link);
+	}
+	if (snapshot->heap_tree) {
+		massifg_heap_tree_free(data, snapshot->heap_tree);
+	}
+	g_string_free(snapshot->heap_tree_desc, TRUE);
+	g_free(snapshot);
+}
+
+/* Size of a GString, with its buffer */
+static gsize
+massifg_string_get_memory_size(GString *str) {
+	return sizeof(GString) + str->allocated_len;
+}
+
+/* Add the distinct nodes in the children lists under node to stats.
+ * counted holds the lists that have already been added, with the number of nodes under them,
+ * so that shared subtrees are only visited once.
+ * Returns the number of nodes under node, counting shared subtrees every time */
+static gsize
+massifg_heap_tree_add_memory_stats(GNode *node, GHashTable *counted, MassifgMemoryStats *stats) {
+	MassifgHeapTreeNode *heap_node = NULL;
+	GNode *child = NULL;
+	gpointer num_refs = NULL;
+	gsize refs = 0;
+
+	if (!node->children)
+		return 0;
+	if (g_hash_table_lookup_extended(counted, node->children, NULL, &num_refs))
+		return GPOINTER_TO_SIZE(num_refs);
+
+	for (child = node->children; child; child = child->next) {
+		heap_node = (MassifgHeapTreeNode *)child->data;
+		stats->num_nodes++;
+		stats->nodes_B += sizeof(MassifgHeapTreeNode);
+		if (heap_node->label_id == MASSIFG_LABEL_NONE && heap_node->label)
+			stats->nodes_B += massifg_string_get_memory_size(heap_node->label);
+		refs += 1 + massifg_heap_tree_add_memory_stats(child, counted, stats);
+	}
+	g_hash_table_insert(counted, node->children, GSIZE_TO_POINTER(refs));
+	return refs;
+}
+
+/* Append the nodes of the heap tree under node to records, in preorder */
+static void
+massifg_heap_tree_write_records(GNode *node, GArray *records) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	HeapTreeRecord record;
+	GNode *child = NULL;
+
+	record.label_id = n->label_id;
+	record.num_children = n->num_children;
+	record.total_mem_B = n->total_mem_B;
+	g_array_append_val(records, record);
+
+	for (child = node->children; child; child = child->next) {
+		massifg_heap_tree_write_records(child, records);
+	}
+}
+
+/* Build the heap tree under the next record, advancing record past it.
+ * Subtrees are closed like the parser closes them, so they are shared
+ * with the identical subtrees of the trees in memory */
+static GNode *
+massifg_heap_tree_read_records(MassifgOutputData *data, const HeapTreeRecord **record, gint depth) {
+	const HeapTreeRecord *r = (*record)++;
+	MassifgHeapTreeNode *n = g_new(MassifgHeapTreeNode, 1);
+	GNode *node = g_node_new(n);
+	GNode *last_child = NULL;
+	guint i;
+
+	n->num_children = r->num_children;
+	n->total_mem_B = r->total_mem_B;
+	n->self_mem_B = r->total_mem_B;
+	n->label_id = r->label_id;
+	n->label = massifg_label_table_get(data->labels, r->label_id);
+	n->parsing_remaining_children = 0;
+	n->parsing_depth = depth;
+	n->subtree_hash = 0;
+	data->heap_trees_B += HEAP_TREE_NODE_B;
+
+	for (i=0; i<r->num_children; i++) {
+		last_child = g_node_insert_after(node, last_child,
+				massifg_heap_tree_read_records(data, record, depth+1));
+	}
+	massifg_heap_tree_close_subtree(data, node);
+	return node;
+}
+
+/* Write the heap tree of snapshot to the spill file, unless it is there from an
+ * earlier time, and free it. With data->spill_lock held.
+ * If the spill file can not be written, spilling is disabled for data */
+static void
+massifg_snapshot_spill(MassifgOutputData *data, MassifgSnapshot *snapshot) {
+	GArray *records = NULL;
+	GError *error = NULL;
+	guint64 offset;
+
+	if (snapshot->spill_offset < 0) {
+		if (!data->spill_file) {
+			data->spill_file = massifg_spill_file_new(&error);
+		}
+		if (data->spill_file) {
+			records = g_array_new(FALSE, FALSE, sizeof(HeapTreeRecord));
+			massifg_heap_tree_write_records(snapshot->heap_tree, records);
+			if (massifg_spill_file_append(data->spill_file, records->data,
+					records->len*sizeof(HeapTreeRecord), &offset, &error)) {
+				snapshot->spill_offset = offset;
+				snapshot->spill_num_nodes = records->len;
+			}
+			g_array_free(records, TRUE);
+		}
+		if (error) {
+			g_warning("Keeping the heap trees in memory: %s", error->message);
+			g_error_free(error);
+			data->spill_failed = TRUE;
+			return;
+		}
+	}
+
+	MASSIFG_NOTE(PARSER, g_debug("Spilling heap tree of snapshot %d", snapshot->snapshot_no));
+	g_queue_delete_link(data->resident, snapshot->resident_link);
+	snapshot->resident_link = NULL;
+	massifg_heap_tree_free(data, snapshot->heap_tree);
+	snapshot->heap_tree = NULL;
+}
+
+/* Read the heap tree of snapshot back from the spill file. With data->spill_lock held */
+static void
+massifg_snapshot_load(MassifgOutputData *data, MassifgSnapshot *snapshot) {
+	const HeapTreeRecord *records = NULL;
+	GError *error = NULL;
+
+	records = (const HeapTreeRecord *)massifg_spill_file_read(data->spill_file, snapshot->spill_offset,
+			snapshot->spill_num_nodes*sizeof(HeapTreeRecord), &error);
+	if (!records) {
+		g_warning("Unable to read the heap tree of snapshot %d: %s",
+			snapshot->snapshot_no, error->message);
+		g_error_free(error);
+		return;
+	}
+
+	MASSIFG_NOTE(PARSER, g_debug("Loading heap tree of snapshot %d", snapshot->snapshot_no));
+	snapshot->heap_tree = massifg_heap_tree_read_records(data, &records, 0);
+	g_queue_push_tail(data->resident, snapshot);
+	snapshot->resident_link = data->resident->tail;
+}
+
+/* Spill the least recently used heap trees that are not in use, until the
+ * trees in memory fit in the budget. With data->spill_lock held */
+static void
+massifg_output_data_enforce_budget(MassifgOutputData *data) {
+	GList *l = data->resident->head;
+	GList *next = NULL;
+	MassifgSnapshot *snapshot = NULL;
+
+	while (l && data->heap_trees_B > data->memory_budget_B && !data->spill_failed) {
+		next = l->next;
+		snapshot = (MassifgSnapshot *)l->data;
+		if (snapshot->pin_count == 0) {
+			massifg_snapshot_spill(data, snapshot);
+		}
+		l = next;
+	}
+}
+
+/* Feed all the lines in io_channel to the parser
+ * Returns the status of the last read, G_IO_STATUS_EOF if all went well */
+static GIOStatus
+massifg_parser_run(MassifgParser *parser, GIOChannel *io_channel, GError **error) {
+	GString *line_string = g_string_new("initial string");
+	GIOStatus io_status = G_IO_STATUS_NORMAL;
+	MassifgTraceSpan span;
+
+	massifg_trace_begin(&span, "parse");
+	while (io_status == G_IO_STATUS_NORMAL) {
+		io_status = g_io_channel_read_line_string(io_channel, line_string, NULL, error);
+		parser->current_line_number++;
+		line_string->str = g_strchomp(line_string->str); /* Remove newline */
+		massifg_parse_line(parser, line_string->str);
+	}
+	MASSIFG_NOTE(PARSER, g_debug("Parsing DONE"));
+	massifg_trace_end(&span);
+
+	g_string_free(line_string, TRUE);
+	return io_status;
+}
+
+/* Parse from io_channel, interning the labels in labels, or in a new table if it is NULL */
+static MassifgOutputData *
+massifg_parse_iochannel_with_labels(GIOChannel *io_channel, MassifgLabelTable *labels,
+				GError **error) {
+	MassifgOutputData *output_data = NULL;
+	MassifgParser *parser = massifg_parser_new(labels);
+	GIOStatus io_status = G_IO_STATUS_NORMAL;
+
+	/* Parse file */
+	io_status = massifg_parser_run(parser, io_channel, error);
+	if (io_status != G_IO_STATUS_ERROR) {
+		output_data = massifg_parser_finish(parser, error);
+	}
+
+	massifg_parser_free(parser);
+	return output_data;
+}
+
+/* A file parsed by massifg_parse_files() */
+typedef struct {
+	const gchar *filename;
+	MassifgLabelTable *labels;
+	MassifgOutputData *output_data;
+	GError *error;
+} ParseFilesJob;
+
+/* Parse a single file, as a GFunc for a GThreadPool */
+static void
+massifg_parse_files_job(gpointer data, gpointer user_data) {
+	ParseFilesJob *job = (ParseFilesJob *)data;
+
+	job->output_data = massifg_parse_file_with_labels(job->filename, job->labels, &job->error);
+}
+
 /* Public functions */
 
 /**
- * massifg_output_data_free:
- * @data: the MassifgOutputData to free
+ * massifg_parser_new:
+ * @labels: #MassifgLabelTable to intern the labels in, or %NULL for a new table
+ * @Returns: a new #MassifgParser. Free with massifg_parser_free()
+ *
+ * Create a parser that is fed massif output a piece at a time with
+ * massifg_parser_feed(). This makes it possible to show the output while it is
+ * being read, or while massif is still writing it.
+ */
+MassifgParser *
+massifg_parser_new(MassifgLabelTable *labels) {
+	MassifgParser *parser = g_new(MassifgParser, 1);
+
+	parser->current_state = STATE_DESC;
+	parser->current_line_number = 0;
+	parser->current_snapshot = NULL;
+	parser->output_data = massifg_output_data_new(labels);
+	parser->last_snapshot = NULL;
+	parser->num_snapshots = 0;
+	parser->partial_line = g_string_new("");
+	parser->summary = NULL;
+	parser->ht_current_parent = NULL;
+	massifg_parser_set_memory_budget(parser, default_memory_budget_B);
+	massifg_parser_set_build_union_tree(parser, default_build_union_tree);
+
+	return parser;
+}
+
+/**
+ * massifg_parser_free:
+ * @parser: #MassifgParser to free
  *
- * Free a #MassifgOutputData.
+ * Free a #MassifgParser, including the #MassifgOutputData it has built
+ * unless it has been taken with massifg_parser_finish().
  */
-void massifg_output_data_free(MassifgOutputData *data) {
+void
+massifg_parser_free(MassifgParser *parser) {
+	if (parser->output_data) {
+		if (parser->current_snapshot) {
+			massifg_snapshot_free(parser->current_snapshot, parser->output_data);
+		}
+		massifg_output_data_unref(parser->output_data);
+	}
+	g_string_free(parser->partial_line, TRUE);
+	g_free(parser);
+}
 
-	g_list_foreach(data->snapshots, massifg_utils_free_foreach, NULL);
+/**
+ * massifg_parser_set_memory_budget:
+ * @parser: A #MassifgParser that has not parsed any snapshots yet
+ * @budget_B: The most memory the heap trees may use, in bytes, or 0 for no limit
+ *
+ * Limit the memory the heap trees of the output data may use. When they use more,
+ * the trees that have not been used for the longest time are spilled to a
+ * temporary file, see #MassifgOutputData. Trees that are in use, and the tree
+ * that is being parsed, are never spilled, so they can exceed the budget.
+ * The snapshots, labels and series are not counted.
+ *
+ * Parsers start with the default budget, see massifg_parser_set_default_memory_budget().
+ */
+void
+massifg_parser_set_memory_budget(MassifgParser *parser, gsize budget_B) {
+	MassifgOutputData *data = parser->output_data;
+
+	g_return_if_fail(data != NULL && data->snapshots == NULL);
+
+	data->memory_budget_B = budget_B;
+	if (budget_B && !data->spill_lock) {
+		data->spill_lock = g_mutex_new();
+		data->resident = g_queue_new();
+	}
+}
+
+/**
+ * massifg_parser_set_default_memory_budget:
+ * @budget_B: The memory budget in bytes, or 0 for no limit
+ *
+ * Set the memory budget of the parsers created from now on, including those
+ * massifg_parse_file() and the other parse functions create.
+ * See massifg_parser_set_memory_budget().
+ */
+void
+massifg_parser_set_default_memory_budget(gsize budget_B) {
+	default_memory_budget_B = budget_B;
+}
+
+/**
+ * massifg_parser_set_build_union_tree:
+ * @parser: A #MassifgParser that has not parsed any snapshots yet
+ * @build: %TRUE to build the union tree
+ *
+ * Have the parser merge the heap tree of every snapshot into the union tree of
+ * the output data as the snapshot is completed, see #MassifgUnionTree. This
+ * makes the time series of every call path available without walking the
+ * heap trees, at the cost of a column value for every node of every tree.
+ *
+ * Parsers start with the default, see massifg_parser_set_default_build_union_tree().
+ */
+void
+massifg_parser_set_build_union_tree(MassifgParser *parser, gboolean build) {
+	MassifgOutputData *data = parser->output_data;
+
+	g_return_if_fail(data != NULL && data->snapshots == NULL);
+
+	if (build && !data->union_tree) {
+		data->union_tree = massifg_union_tree_new();
+	}
+	else if (!build && data->union_tree) {
+		massifg_union_tree_free(data->union_tree);
+		data->union_tree = NULL;
+	}
+}
+
+/**
+ * massifg_parser_set_default_build_union_tree:
+ * @build: %TRUE to build the union tree
+ *
+ * Set whether the parsers created from now on build the union tree, including
+ * those massifg_parse_file() and the other parse functions create.
+ * See massifg_parser_set_build_union_tree().
+ */
+void
+massifg_parser_set_default_build_union_tree(gboolean build) {
+	default_build_union_tree = build;
+}
+
+/**
+ * massifg_parser_feed:
+ * @parser: A #MassifgParser
+ * @data: The next piece of the massif output
+ * @length: The length of @data in bytes, or -1 if it is nul-terminated
+ *
+ * Parse the next piece of the massif output. @data does not have to end at the
+ * end of a line, the rest of the line can come with the next piece.
+ */
+void
+massifg_parser_feed(MassifgParser *parser, const gchar *data, gssize length) {
+	const gchar *end = NULL;
+	const gchar *line_end = NULL;
+	MassifgTraceSpan span;
+
+	g_return_if_fail(parser->output_data != NULL);
+	massifg_trace_begin(&span, "parse");
+
+	if (length < 0)
+		length = strlen(data);
+	end = data + length;
+
+	while (data < end) {
+		line_end = memchr(data, '\n', end - data);
+		if (!line_end) {
+			g_string_append_len(parser->partial_line, data, end - data);
+			break;
+		}
+		g_string_append_len(parser->partial_line, data, line_end - data);
+
+		parser->current_line_number++;
+		g_strchomp(parser->partial_line->str); /* Remove \r, if any */
+		massifg_parse_line(parser, parser->partial_line->str);
+		g_string_truncate(parser->partial_line, 0);
+		data = line_end + 1;
+	}
+	massifg_trace_end(&span);
+}
+
+/**
+ * massifg_parser_get_output_data:
+ * @parser: A #MassifgParser
+ * @Returns: The #MassifgOutputData built so far. Owned by @parser
+ *
+ * Get the output data that is being built. It only has the snapshots that have
+ * been parsed completely, new snapshots are appended to the end of its list of
+ * snapshots as they are completed. The label index is only updated by
+ * massifg_parser_finish(), call massifg_label_index_update() before searching it.
+ */
+MassifgOutputData *
+massifg_parser_get_output_data(MassifgParser *parser) {
+	return parser->output_data;
+}
+
+/**
+ * massifg_parser_finish:
+ * @parser: A #MassifgParser
+ * @error: Location to store a #GError or %NULL
+ * @Returns: The #MassifgOutputData, or %NULL if no snapshots could be parsed.
+ * Release with massifg_output_data_unref()
+ *
+ * Tell the parser that the end of the massif output has been reached, and take
+ * the output data from it. The parser must still be freed with massifg_parser_free().
+ */
+MassifgOutputData *
+massifg_parser_finish(MassifgParser *parser, GError **error) {
+	MassifgOutputData *output_data = parser->output_data;
+	MassifgTraceSpan span;
+
+	g_return_val_if_fail(output_data != NULL, NULL);
+	massifg_trace_begin(&span, "parse-finish");
+
+	/* The last line might not end with a newline */
+	if (parser->partial_line->len > 0) {
+		parser->current_line_number++;
+		g_strchomp(parser->partial_line->str);
+		massifg_parse_line(parser, parser->partial_line->str);
+		g_string_truncate(parser->partial_line, 0);
+	}
+	massifg_parser_complete_snapshot(parser);
+	parser->output_data = NULL;
+
+	/* All the labels of this output are in the table now. Labels that other
+	 * parsers sharing the table add later can not be in this output,
+	 * so the index does not change any more */
+	massifg_label_index_update(output_data->label_index);
+	massifg_label_index_freeze(output_data->label_index);
+	if (output_data->union_tree)
+		massifg_union_tree_compact(output_data->union_tree);
+	massifg_trace_end(&span);
+
+	if (!output_data->snapshots) {
+		g_set_error_literal(error, MASSIFG_PARSE_ERROR, MASSIFG_PARSE_ERROR_NOSNAPSHOTS, "Could not parse any snapshots");
+		massifg_output_data_unref(output_data);
+		return NULL;
+	}
+	return output_data;
+}
+
+
+/**
+ * massifg_output_data_get_memory_stats:
+ * @data: A #MassifgOutputData
+ * @stats: The #MassifgMemoryStats to fill in
+ *
+ * Estimate how much memory the parsed data uses, and what it is used for.
+ * The cost is proportional to the number of distinct nodes in memory.
+ * The series of the graph are not known here, see massifg_graph_get_memory_stats().
+ */
+void
+massifg_output_data_get_memory_stats(MassifgOutputData *data, MassifgMemoryStats *stats) {
+	GHashTable *counted = g_hash_table_new(g_direct_hash, g_direct_equal);
+	MassifgSnapshot *snapshot = NULL;
+	MassifgHeapTreeNode *root = NULL;
+	GList *l = NULL;
+
+	memset(stats, 0, sizeof(MassifgMemoryStats));
+	if (data->spill_lock)
+		g_mutex_lock(data->spill_lock);
+
+	stats->snapshots_B = sizeof(MassifgOutputData) + massifg_string_get_memory_size(data->desc)
+		+ massifg_string_get_memory_size(data->cmd) + massifg_string_get_memory_size(data->time_unit);
+	for (l = data->snapshots; l; l = l->next) {
+		snapshot = (MassifgSnapshot *)l->data;
+		stats->num_snapshots++;
+		stats->snapshots_B += sizeof(MassifgSnapshot) + sizeof(GList)
+			+ massifg_string_get_memory_size(snapshot->heap_tree_desc);
+
+		/* The roots are never shared */
+		if (snapshot->heap_tree) {
+			root = (MassifgHeapTreeNode *)snapshot->heap_tree->data;
+			stats->num_nodes++;
+			stats->nodes_B += sizeof(MassifgHeapTreeNode);
+			if (root->label_id == MASSIFG_LABEL_NONE && root->label)
+				stats->nodes_B += massifg_string_get_memory_size(root->label);
+			stats->num_node_refs += 1 + massifg_heap_tree_add_memory_stats(snapshot->heap_tree, counted, stats);
+		}
+		else if (snapshot->has_heap_tree) {
+			stats->num_spilled_trees++;
+		}
+	}
+	g_hash_table_destroy(counted);
+	if (data->spill_file)
+		stats->spill_file_B = massifg_spill_file_get_size(data->spill_file);
+
+	stats->num_links = stats->num_nodes;
+	stats->links_B = stats->num_links*sizeof(GNode)
+		+ g_hash_table_size(data->subtrees)*(2*sizeof(gpointer) + sizeof(guint));
+
+	stats->num_labels = massifg_label_table_size(data->labels);
+	stats->num_label_refs = stats->num_node_refs;
+	stats->labels_B = massifg_label_table_get_memory_size(data->labels);
+	if (data->label_index)
+		stats->labels_B += massifg_label_index_get_memory_size(data->label_index);
+
+	if (data->union_tree) {
+		stats->num_union_nodes = data->union_tree->num_nodes;
+		stats->union_tree_B = massifg_union_tree_get_memory_size(data->union_tree);
+	}
+
+	stats->total_B = stats->snapshots_B + stats->nodes_B + stats->links_B + stats->labels_B
+		+ stats->union_tree_B;
+	if (data->spill_lock)
+		g_mutex_unlock(data->spill_lock);
+}
+
+/**
+ * massifg_output_data_ref:
+ * @data: A #MassifgOutputData
+ * @Returns: @data
+ *
+ * Increase the reference count of a #MassifgOutputData.
+ * Can be called from any thread.
+ */
+MassifgOutputData *
+massifg_output_data_ref(MassifgOutputData *data) {
+	g_atomic_int_inc(&data->ref_count);
+	return data;
+}
+
+/**
+ * massifg_output_data_unref:
+ * @data: A #MassifgOutputData
+ *
+ * Decrease the reference count of a #MassifgOutputData. When it reaches zero,
+ * the data is freed, including the snapshots and their heap trees.
+ * Can be called from any thread.
+ */
+void
+massifg_output_data_unref(MassifgOutputData *data) {
+	GList *l = NULL;
+
+	if (!g_atomic_int_dec_and_test(&data->ref_count))
+		return;
+
+	for (l = data->snapshots; l; l = l->next) {
+		massifg_snapshot_free((MassifgSnapshot *)l->data, data);
+	}
 	g_list_free(data->snapshots);
+	g_hash_table_destroy(data->subtrees);
+	if (data->union_tree) {
+		massifg_union_tree_free(data->union_tree);
+	}
+	if (data->spill_file) {
+		massifg_spill_file_free(data->spill_file);
+	}
+	if (data->spill_lock) {
+		g_queue_free(data->resident);
+		g_mutex_free(data->spill_lock);
+	}
+
+	if (data->label_index) {
+		massifg_label_index_free(data->label_index);
+	}
+	massifg_label_table_unref(data->labels);
 
 	g_string_free(data->time_unit, TRUE);
 	g_string_free(data->cmd, TRUE);
@@ -458,75 +1341,291 @@ void massifg_output_data_free(MassifgOutputData *data) {
 	g_free(data);
 }
 
+/**
+ * massifg_output_data_get_heap_tree:
+ * @data: A #MassifgOutputData
+ * @snapshot: One of the snapshots of @data
+ * @Returns: The heap tree of @snapshot, or %NULL if it has none
+ *
+ * Get the heap tree of a snapshot, reading it back from the spill file if it has
+ * been spilled. The tree stays in memory until it is released with
+ * massifg_output_data_release_heap_tree(), which must be called once for
+ * every tree that was returned. Can be called from any thread.
+ *
+ * Without a memory budget this is the same as using @snapshot->heap_tree.
+ */
+GNode *
+massifg_output_data_get_heap_tree(MassifgOutputData *data, MassifgSnapshot *snapshot) {
+	GNode *heap_tree = NULL;
+
+	if (!data->memory_budget_B)
+		return snapshot->heap_tree;
+
+	g_mutex_lock(data->spill_lock);
+	if (!snapshot->heap_tree && snapshot->spill_offset >= 0) {
+		massifg_snapshot_load(data, snapshot);
+	}
+	heap_tree = snapshot->heap_tree;
+	if (heap_tree) {
+		snapshot->pin_count++;
+		if (snapshot->resident_link) {
+			/* Now the most recently used */
+			g_queue_unlink(data->resident, snapshot->resident_link);
+			g_queue_push_tail_link(data->resident, snapshot->resident_link);
+		}
+		massifg_output_data_enforce_budget(data);
+	}
+	g_mutex_unlock(data->spill_lock);
+	return heap_tree;
+}
+
+/**
+ * massifg_output_data_release_heap_tree:
+ * @data: A #MassifgOutputData
+ * @snapshot: A snapshot whose heap tree was returned by massifg_output_data_get_heap_tree()
+ *
+ * Tell that the heap tree of a snapshot is no longer in use, so that it can be
+ * spilled. Does nothing if massifg_output_data_get_heap_tree() returned %NULL.
+ */
+void
+massifg_output_data_release_heap_tree(MassifgOutputData *data, MassifgSnapshot *snapshot) {
+	if (!data->memory_budget_B)
+		return;
+
+	g_mutex_lock(data->spill_lock);
+	if (snapshot->pin_count > 0) {
+		snapshot->pin_count--;
+		massifg_output_data_enforce_budget(data);
+	}
+	g_mutex_unlock(data->spill_lock);
+}
+
+/**
+ * massifg_snapshot_has_heap_tree:
+ * @snapshot: A #MassifgSnapshot of a #MassifgOutputData
+ * @Returns: %TRUE if the snapshot has a heap tree
+ *
+ * Check whether a snapshot has a heap tree, whether it is in memory or spilled.
+ */
+gboolean
+massifg_snapshot_has_heap_tree(MassifgSnapshot *snapshot) {
+	return snapshot->has_heap_tree;
+}
+
 /**
  * massifg_parse_iochannel:
  * @io_channel: #GIOChannel to parse the data from
  * @error: Location to store a #GError or %NULL
  * @Returns: a #MassifgOutputData that represents this data, or %NULL on failure.
- * Use massifg_output_data_free() to free.
+ * Release with massifg_output_data_unref().
  *
  * Parse massif output data from a #GIOChannel.
  */
 MassifgOutputData
 *massifg_parse_iochannel(GIOChannel *io_channel, GError **error) {
+	return massifg_parse_iochannel_with_labels(io_channel, NULL, error);
+}
+
+/**
+ * massifg_parse_file:
+ * @filename: Path to file to parse. %NULL is invalid
+ * @error: Location to store a #GError or %NULL
+ * @Returns: a #MassifgOutputData that represents this data, or %NULL on failure.
+ *
+ * Parse massif output data from file. See also massifg_parse_iochannel().
+ */
+MassifgOutputData
+*massifg_parse_file(const gchar *filename, GError **error) {
+	return massifg_parse_file_with_labels(filename, NULL, error);
+}
+
+/**
+ * massifg_parse_file_with_labels:
+ * @filename: Path to file to parse. %NULL is invalid
+ * @labels: #MassifgLabelTable to intern the labels in, or %NULL for a new table
+ * @error: Location to store a #GError or %NULL
+ * @Returns: a #MassifgOutputData that represents this data, or %NULL on failure.
+ *
+ * Parse massif output data from file, like massifg_parse_file(), but share the
+ * label table with other #MassifgOutputData. Their labels can then be compared by id.
+ * Several files can be parsed into the same table at the same time from different threads.
+ */
+MassifgOutputData
+*massifg_parse_file_with_labels(const gchar *filename, MassifgLabelTable *labels, GError **error) {
 	MassifgOutputData *output_data = NULL;
-	MassifgParser *parser = massifg_parser_new();
+	GIOChannel *io_channel = NULL;
+	MassifgTraceSpan span;
 
-	GString *line_string = NULL;
-	GIOStatus io_status = G_IO_STATUS_NORMAL;
+	g_return_val_if_fail(filename != NULL, NULL);
 
-	/* Initialize */
-	output_data = massifg_output_data_new();
-	parser->output_data = output_data;
+	MASSIFG_NOTE(PARSER, g_debug("Parsing file: %s", filename));
 
-	line_string = g_string_new("initial string");
+	massifg_trace_begin(&span, "open");
+	io_channel = g_io_channel_new_file(filename, "r", error);
+	massifg_trace_end(&span);
+	if (io_channel == NULL) {
+		return NULL;
+	}
 
-	/* Parse file */
-	while (io_status == G_IO_STATUS_NORMAL) {
-		io_status = g_io_channel_read_line_string(io_channel, line_string, NULL, error);
-		parser->current_line_number++;
-		line_string->str = g_strchomp(line_string->str); /* Remove newline */
-		massifg_parse_line(parser, line_string->str);
+	output_data = massifg_parse_iochannel_with_labels(io_channel, labels, error);
+	g_io_channel_unref(io_channel);
+	return output_data;
+}
+
+/**
+ * massifg_parse_files:
+ * @filenames: %NULL-terminated array of paths to the files to parse
+ * @error: Location to store a #GError or %NULL
+ * @Returns: #GPtrArray with a #MassifgOutputData for each file, in the same order
+ * as @filenames, or %NULL on failure. Free with g_ptr_array_free(), which also
+ * releases the #MassifgOutputData.
+ *
+ * Parse several massif output files at the same time, one thread for each file.
+ * All the #MassifgOutputData share the same #MassifgLabelTable, so that
+ * their labels can be compared by id.
+ * If any of the files can not be parsed, @error is set for the first of them.
+ */
+GPtrArray *
+massifg_parse_files(const gchar * const *filenames, GError **error) {
+	MassifgLabelTable *labels = massifg_label_table_new();
+	GPtrArray *output_datas = NULL;
+	ParseFilesJob *jobs = NULL;
+	GThreadPool *pool = NULL;
+	gboolean failed = FALSE;
+	guint num_files = g_strv_length((gchar **)filenames);
+	guint i;
+
+	g_return_val_if_fail(num_files > 0, NULL);
+
+	jobs = g_new0(ParseFilesJob, num_files);
+	for (i=0; i<num_files; i++) {
+		jobs[i].filename = filenames[i];
+		jobs[i].labels = labels;
+	}
+
+	if (g_thread_supported() && num_files > 1) {
+		pool = g_thread_pool_new(massifg_parse_files_job, NULL, num_files, TRUE, NULL);
+	}
+	for (i=0; i<num_files; i++) {
+		if (pool)
+			g_thread_pool_push(pool, &jobs[i], NULL);
+		else
+			massifg_parse_files_job(&jobs[i], NULL);
+	}
+	if (pool) {
+		/* Wait for all the files to be parsed */
+		g_thread_pool_free(pool, FALSE, TRUE);
 	}
-	g_debug("Parsing DONE");
 
-	if (io_status == G_IO_STATUS_ERROR) {
-		output_data = NULL;
+	output_datas = g_ptr_array_new_with_free_func((GDestroyNotify)massifg_output_data_unref);
+	for (i=0; i<num_files; i++) {
+		if (jobs[i].error && !failed) {
+			g_propagate_prefixed_error(error, jobs[i].error, "%s: ", jobs[i].filename);
+			jobs[i].error = NULL;
+		}
+		g_clear_error(&jobs[i].error);
+		failed |= !jobs[i].output_data;
+		if (jobs[i].output_data)
+			g_ptr_array_add(output_datas, jobs[i].output_data);
+	}
+	if (failed) {
+		g_ptr_array_free(output_datas, TRUE);
+		output_datas = NULL;
 	}
-	if (g_list_length(output_data->snapshots) < 1 ) {
-		output_data = NULL;
+
+	g_free(jobs);
+	massifg_label_table_unref(labels);
+	return output_datas;
+}
+
+/**
+ * massifg_summarize_iochannel:
+ * @io_channel: #GIOChannel to read the massif output from
+ * @num_allocators: The maximum number of allocators to keep for the peak
+ * @error: Location to store a #GError or %NULL
+ * @Returns: a new #MassifgSummary, or %NULL on failure. Free with massifg_summary_free()
+ *
+ * Summarize massif output data from a #GIOChannel without keeping the snapshots.
+ * This uses the same parser as massifg_parse_iochannel(), but no heap trees are built
+ * and each snapshot is freed as soon as the next one starts, so the memory used
+ * does not grow with the size of the output.
+ */
+MassifgSummary *
+massifg_summarize_iochannel(GIOChannel *io_channel, guint num_allocators, GError **error) {
+	MassifgParser *parser = massifg_parser_new(NULL);
+	MassifgOutputData *output_data = parser->output_data;
+	MassifgSummary *summary = g_new0(MassifgSummary, 1);
+	GIOStatus io_status;
+
+	summary->peak_snapshot_no = -1;
+	summary->peak_tree_snapshot_no = -1;
+	summary->peak_allocators = g_ptr_array_new_with_free_func((GDestroyNotify)massifg_allocator_free);
+	summary->num_allocators = num_allocators;
+	summary->current_allocators = g_ptr_array_new_with_free_func((GDestroyNotify)massifg_allocator_free);
+
+	parser->summary = summary;
+	io_status = massifg_parser_run(parser, io_channel, error);
+	massifg_parser_complete_snapshot(parser);
+
+	/* Keep the header */
+	summary->desc = output_data->desc;
+	summary->cmd = output_data->cmd;
+	summary->time_unit = output_data->time_unit;
+	summary->max_time = output_data->max_time;
+	output_data->desc = g_string_new("");
+	output_data->cmd = g_string_new("");
+	output_data->time_unit = g_string_new("");
+
+	if (io_status != G_IO_STATUS_ERROR && summary->num_snapshots < 1) {
 		g_set_error_literal(error, MASSIFG_PARSE_ERROR, MASSIFG_PARSE_ERROR_NOSNAPSHOTS, "Could not parse any snapshots");
 	}
+	if (io_status == G_IO_STATUS_ERROR || summary->num_snapshots < 1) {
+		massifg_summary_free(summary);
+		summary = NULL;
+	}
 
-	g_string_free(line_string, TRUE);
 	massifg_parser_free(parser);
-
-	return output_data;
+	return summary;
 }
 
 /**
- * massifg_parse_file:
- * @filename: Path to file to parse. %NULL is invalid
+ * massifg_summarize_file:
+ * @filename: Path to file to summarize. %NULL is invalid
+ * @num_allocators: The maximum number of allocators to keep for the peak
  * @error: Location to store a #GError or %NULL
- * @Returns: a #MassifgOutputData that represents this data, or %NULL on failure.
+ * @Returns: a new #MassifgSummary, or %NULL on failure. Free with massifg_summary_free()
  *
- * Parse massif output data from file. See also massifg_parse_iochannel().
+ * Summarize massif output data from file. See massifg_summarize_iochannel().
  */
-MassifgOutputData
-*massifg_parse_file(const gchar *filename, GError **error) {
-	MassifgOutputData *output_data = NULL;
+MassifgSummary *
+massifg_summarize_file(const gchar *filename, guint num_allocators, GError **error) {
+	MassifgSummary *summary = NULL;
 	GIOChannel *io_channel = NULL;
 
 	g_return_val_if_fail(filename != NULL, NULL);
 
-	g_debug("Parsing file: %s", filename);
-
 	io_channel = g_io_channel_new_file(filename, "r", error);
 	if (io_channel == NULL) {
 		return NULL;
 	}
 
-	output_data = massifg_parse_iochannel(io_channel, error);
+	summary = massifg_summarize_iochannel(io_channel, num_allocators, error);
 	g_io_channel_unref(io_channel);
-	return output_data;
+	return summary;
+}
+
+/**
+ * massifg_summary_free:
+ * @summary: #MassifgSummary to free
+ *
+ * Free a #MassifgSummary.
+ */
+void
+massifg_summary_free(MassifgSummary *summary) {
+	g_ptr_array_free(summary->peak_allocators, TRUE);
+	g_ptr_array_free(summary->current_allocators, TRUE);
+	g_string_free(summary->desc, TRUE);
+	g_string_free(summary->cmd, TRUE);
+	g_string_free(summary->time_unit, TRUE);
+	g_free(summary);
 }
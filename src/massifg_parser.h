@@ -24,27 +24,43 @@
 
 #include <glib.h>
 
+#include "massifg_labels.h"
+#include "massifg_spill.h"
+#include "massifg_union_tree.h"
+
 /* Data structures */
 
 /**
  * MassifgHeapTreeNode:
  * @num_children: The number of children this node has.
  * @total_mem_B: Memory usage under this node.
+ * @self_mem_B: The part of @total_mem_B that is not under any of the children,
+ * which is the memory allocated by the function of this node itself. Set by the
+ * parser when the subtree is complete, and equal to @total_mem_B before.
  * @label: String label identifying which function this is.
+ * Nodes created by the parser share the label with all other nodes with the same
+ * label, through the #MassifgLabelTable in #MassifgOutputData.
  * @parsing_remaining_children: Used internally by the parser. Should be 0 after correct parsing.
  * @parsing_depth: Used internally by the parser. Should be equal to the depth of the tree.
+ * @subtree_hash: Structural hash of the label, memory usage and children of the subtree
+ * under this node. Set by the parser when the subtree is complete.
+ * @label_id: Id of @label in the #MassifgLabelTable of the #MassifgOutputData,
+ * or %MASSIFG_LABEL_NONE if the node owns its label.
  *
  * Represents one node in the heap tree.
  */
 typedef struct _MassifgHeapTreeNode {
 	gint num_children;
 	glong total_mem_B;
+	glong self_mem_B;
 	GString *label;
 
 	/* Only used while parsing */
 	gint parsing_remaining_children;
 	gint parsing_depth; 
 
+	guint subtree_hash;
+	guint label_id;
 } MassifgHeapTreeNode;
 
 /**
@@ -56,9 +72,18 @@ typedef struct _MassifgHeapTreeNode {
  * @mem_stacks_B: Stack memory usage in bytes.
  * @heap_tree_desc: String describing what kind of heap tree we have.
  * @heap_tree: The heap tree as a tree of #MassifgHeapTreeNode objects.
+ * Can be %NULL while the tree is spilled to disk, if the data was parsed with a
+ * memory budget. Use massifg_output_data_get_heap_tree() to get it in that case.
  *
  *
  * Represents a single massif snapshot.
+ *
+ * Note: Identical subtrees are shared between the heap trees of different
+ * snapshots, see #MassifgOutputData. The trees must therefore be treated as
+ * read-only, and the parent pointer of a #GNode in a shared subtree may point
+ * into the heap tree of another snapshot, or into a tree that has been freed
+ * or spilled to disk. The parent pointers must never be followed, walk the
+ * trees from the root instead.
  */
 struct _MassifgSnapshot {
 	gint snapshot_no;
@@ -70,6 +95,13 @@ struct _MassifgSnapshot {
 
 	GString *heap_tree_desc;
 	GNode *heap_tree;
+
+	/*< private >*/
+	gboolean has_heap_tree;
+	gint64 spill_offset; /* -1 until the heap tree has been written to the spill file */
+	guint spill_num_nodes;
+	gint pin_count;
+	GList *resident_link; /* In the queue of heap trees in memory, if the tree is */
 };
 typedef struct _MassifgSnapshot MassifgSnapshot;
 
@@ -81,6 +113,11 @@ typedef struct _MassifgSnapshot MassifgSnapshot;
  * @time_unit: The time unit massif used. Possible values are "i"|"ms"|"b".
  * @max_time: The maximum value of the time.
  * @max_mem_allocation: The maximum value of total memory allocation.
+ * @labels: All the distinct heap tree labels. Can be shared with other #MassifgOutputData,
+ * see massifg_parse_files().
+ * @label_index: Index for searching in @labels.
+ * @union_tree: The heap trees of all the snapshots merged into one tree, or %NULL
+ * if the parser was not asked to build it, see massifg_parser_set_build_union_tree().
  *
  *
  * Represents all the data massif outputs.
@@ -88,6 +125,24 @@ typedef struct _MassifgSnapshot MassifgSnapshot;
  * Note: @max_time and @max_mem_allocation is not provided by the massif output
  * format directly but is provided by the parser. These attributes might go
  * away in a future version.
+ *
+ * The parser hash-conses the heap trees: when the children of a node are
+ * identical (same labels, memory usage and subtrees) to the children of a node
+ * parsed earlier, the earlier children are reused instead of keeping a copy.
+ * Since consecutive snapshots mostly differ in a few places, memory usage
+ * scales with the number of changes rather than with the number of snapshots.
+ *
+ * The data is reference counted. Once massifg_parser_finish() has returned it,
+ * it is not modified any more, so several graphs and analyses in other threads
+ * can share it without locking, each holding its own reference.
+ *
+ * With a memory budget, see massifg_parser_set_memory_budget(), the heap trees
+ * that have not been used for the longest time are written to a temporary
+ * spill file when the trees in memory exceed the budget, and read back when
+ * they are needed. The snapshots themselves always stay in memory, so the
+ * overview graph does not need the trees. The heap trees of such data must
+ * be accessed with massifg_output_data_get_heap_tree(), which takes care of
+ * the locking. The union tree is not counted in the budget, and is never spilled.
  */
 struct _MassifgOutputData {
 	GList *snapshots;
@@ -98,15 +153,160 @@ struct _MassifgOutputData {
 
 	gint64 max_time;
 	gint64 max_mem_allocation;
+
+	MassifgLabelTable *labels;
+	MassifgLabelIndex *label_index;
+
+	MassifgUnionTree *union_tree;
+
+	/*< private >*/
+	GHashTable *subtrees;
+	volatile gint ref_count;
+
+	/* Only used with a memory budget */
+	gsize memory_budget_B;
+	gsize heap_trees_B; /* Nodes of the heap trees in memory, with their links */
+	GMutex *spill_lock;
+	GQueue *resident; /* Snapshots with the heap tree in memory, least recently used first */
+	MassifgSpillFile *spill_file;
+	gboolean spill_failed;
 };
 typedef struct _MassifgOutputData MassifgOutputData;
 
+/**
+ * MassifgMemoryStats:
+ * @num_snapshots: Number of #MassifgSnapshot objects.
+ * @snapshots_B: Bytes used by the snapshots, with their list links and descriptions.
+ * @num_nodes: Number of distinct #MassifgHeapTreeNode objects. Shared subtrees are counted once.
+ * @nodes_B: Bytes used by the nodes, with the labels they own.
+ * @num_node_refs: Number of nodes as they appear in the heap trees, which is the
+ * number of nodes in the massif output. Shared subtrees are counted every time.
+ * @num_links: Number of #GNode objects linking the nodes into trees.
+ * @links_B: Bytes used by the #GNode objects, and by the table of shared children lists.
+ * @num_labels: Number of distinct labels in the #MassifgLabelTable.
+ * @num_label_refs: Number of uses of the labels, counting shared subtrees every time.
+ * The parser interns the label of every node, so this is the same as @num_node_refs.
+ * @labels_B: Bytes used by the #MassifgLabelTable and the #MassifgLabelIndex.
+ * @num_spilled_trees: Number of heap trees that are only in the spill file at the moment.
+ * @spill_file_B: Bytes written to the spill file, which are not counted in @total_B.
+ * @num_union_nodes: Number of nodes in the union call tree, if it was built.
+ * @union_tree_B: Bytes used by the union call tree, with the columns of its nodes.
+ * @num_series: Number of data series the graph has made for the data.
+ * @series_B: Bytes used by the values of those series, including the ones the
+ * graph has cached for the detailed view.
+ * @total_B: The sum of all the byte counts that are in memory.
+ *
+ * Estimated memory usage of a #MassifgOutputData, see massifg_output_data_get_memory_stats().
+ * The byte counts are estimates, since they do not include the overhead of the allocator.
+ */
+typedef struct {
+	guint64 num_snapshots;
+	guint64 snapshots_B;
+	guint64 num_nodes;
+	guint64 nodes_B;
+	guint64 num_node_refs;
+	guint64 num_links;
+	guint64 links_B;
+	guint64 num_labels;
+	guint64 num_label_refs;
+	guint64 labels_B;
+	guint64 num_spilled_trees;
+	guint64 spill_file_B;
+	guint64 num_union_nodes;
+	guint64 union_tree_B;
+	guint64 num_series;
+	guint64 series_B;
+	guint64 total_B;
+} MassifgMemoryStats;
+
+/**
+ * MassifgParser:
+ *
+ * A parser that is fed massif output a piece at a time, see massifg_parser_new().
+ */
+typedef struct _MassifgParser MassifgParser;
+
+/**
+ * MassifgAllocator:
+ * @label: The label of a child of the root of a heap tree.
+ * @mem_B: Memory usage under it, in bytes.
+ *
+ * An allocation function in a #MassifgSummary.
+ */
+typedef struct {
+	gchar *label;
+	gint64 mem_B;
+} MassifgAllocator;
+
+/**
+ * MassifgSummary:
+ * @desc: Description string, as in #MassifgOutputData.
+ * @cmd: The command massif executed.
+ * @time_unit: The time unit massif used.
+ * @max_time: The maximum value of the time.
+ * @num_snapshots: The number of snapshots.
+ * @peak_snapshot_no: The snapshot with the largest total memory usage,
+ * heap, heap overhead and stacks together.
+ * @peak_time: The time of that snapshot.
+ * @peak_mem_B: The total memory usage of that snapshot.
+ * @peak_tree_snapshot_no: The snapshot with the largest total memory usage among the
+ * ones with a heap tree, or -1 if there are none. Usually the same as @peak_snapshot_no.
+ * @peak_tree_mem_B: The total memory usage of that snapshot.
+ * @peak_allocators: #GPtrArray of #MassifgAllocator for the largest children of the root
+ * of the heap tree of @peak_tree_snapshot_no, largest first.
+ *
+ * The summary of a massif output, see massifg_summarize_file().
+ */
+typedef struct {
+	GString *desc;
+	GString *cmd;
+	GString *time_unit;
+	gint64 max_time;
+	gint num_snapshots;
+
+	gint peak_snapshot_no;
+	gint64 peak_time;
+	gint64 peak_mem_B;
+
+	gint peak_tree_snapshot_no;
+	gint64 peak_tree_mem_B;
+	GPtrArray *peak_allocators;
+
+	/*< private >*/
+	guint num_allocators;
+	GPtrArray *current_allocators;
+	gboolean in_heap_tree;
+	gint64 remaining_nodes;
+} MassifgSummary;
+
 /* Public functions */
 /* TODO: Rename to massfig_output_data_new_from_file()? and 
  * massfig_output_data_new_from_iochannel() ?
  */
 MassifgOutputData *massifg_parse_file(const gchar *filename, GError **error);
 MassifgOutputData *massifg_parse_iochannel(GIOChannel *io_channel, GError **error);
-void massifg_output_data_free(MassifgOutputData *data);
+MassifgOutputData *massifg_parse_file_with_labels(const gchar *filename, MassifgLabelTable *labels,
+				GError **error);
+GPtrArray *massifg_parse_files(const gchar * const *filenames, GError **error);
+MassifgOutputData *massifg_output_data_ref(MassifgOutputData *data);
+void massifg_output_data_unref(MassifgOutputData *data);
+void massifg_output_data_get_memory_stats(MassifgOutputData *data, MassifgMemoryStats *stats);
+GNode *massifg_output_data_get_heap_tree(MassifgOutputData *data, MassifgSnapshot *snapshot);
+void massifg_output_data_release_heap_tree(MassifgOutputData *data, MassifgSnapshot *snapshot);
+gboolean massifg_snapshot_has_heap_tree(MassifgSnapshot *snapshot);
+
+MassifgParser *massifg_parser_new(MassifgLabelTable *labels);
+void massifg_parser_free(MassifgParser *parser);
+void massifg_parser_set_memory_budget(MassifgParser *parser, gsize budget_B);
+void massifg_parser_set_default_memory_budget(gsize budget_B);
+void massifg_parser_set_build_union_tree(MassifgParser *parser, gboolean build);
+void massifg_parser_set_default_build_union_tree(gboolean build);
+void massifg_parser_feed(MassifgParser *parser, const gchar *data, gssize length);
+MassifgOutputData *massifg_parser_get_output_data(MassifgParser *parser);
+MassifgOutputData *massifg_parser_finish(MassifgParser *parser, GError **error);
+
+MassifgSummary *massifg_summarize_iochannel(GIOChannel *io_channel, guint num_allocators, GError **error);
+MassifgSummary *massifg_summarize_file(const gchar *filename, guint num_allocators, GError **error);
+void massifg_summary_free(MassifgSummary *summary);
 
 #endif /* MASSIFG_PARSER_H__ */
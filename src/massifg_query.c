@@ -0,0 +1,350 @@
+/*
+ *  MassifG - massifg_query.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_query
+ * @short_description: Memory attributed to heap tree labels over time
+ * @title: MassifG Queries
+ * @stability: Unstable
+ *
+ * A #MassifgQuery answers questions like "how many bytes were allocated
+ * from frames matching g_malloc between time 1000 and 2000".
+ * A query selects the heap tree nodes, down to a maximum depth, whose label
+ * contains a pattern, using the #MassifgLabelIndex of the output. Only the
+ * outermost matching node on each path is counted, so that memory is not
+ * counted twice when matching frames call each other.
+ *
+ * Only snapshots with a heap tree take part in queries.
+ *
+ * With a memory budget, see massifg_parser_set_memory_budget(), the sums of
+ * shared subtrees are only reused within a snapshot, since a spilled tree
+ * is read back into new nodes.
+ *
+ * The memory of each snapshot is computed once per pattern and depth, along
+ * with its prefix sums, and kept in the #MassifgQuery. Later queries with the
+ * same pattern and depth only need to look up the time range, so the total
+ * over any time range takes two binary searches and a subtraction.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "massifg_query.h"
+#include "massifg_parser.h"
+
+/* Private data structures */
+
+/* The memory usage for one pattern and depth, for all snapshots in a MassifgQuery */
+typedef struct {
+	gint64 *values;
+	gint64 *prefix_sums; /* prefix_sums[i] is the sum of values[0] to values[i-1] */
+} QueryCache;
+
+/* The labels matched by a pattern */
+typedef struct {
+	guint8 *mask; /* Indexed by label id. NULL if all labels match */
+	guint mask_len;
+	gchar *folded_pattern; /* For nodes that are not in the label table */
+
+	GHashTable *sums; /* Children list -> memory of the matching nodes under it */
+} QueryMatcher;
+
+/* Private functions */
+
+static void
+query_cache_free(QueryCache *cache) {
+	g_free(cache->values);
+	g_free(cache->prefix_sums);
+	g_free(cache);
+}
+
+static gboolean
+query_matcher_matches(QueryMatcher *matcher, MassifgHeapTreeNode *node) {
+	gchar *folded_label = NULL;
+	gboolean matches;
+
+	if (!matcher->mask)
+		return TRUE;
+
+	if (node->label_id != MASSIFG_LABEL_NONE) {
+		return node->label_id < matcher->mask_len && matcher->mask[node->label_id];
+	}
+
+	folded_label = g_ascii_strdown(node->label->str, -1);
+	matches = strstr(folded_label, matcher->folded_pattern) != NULL;
+	g_free(folded_label);
+	return matches;
+}
+
+/* Memory of the outermost matching nodes among children and their descendants.
+ * Identical children lists are shared between snapshots, and always at the
+ * same depth, so the sum of each list is only computed once */
+static gint64
+query_sum_children(QueryMatcher *matcher, GNode *children,
+			gint depth, gint max_depth) {
+	MassifgHeapTreeNode *n = NULL;
+	GNode *child = NULL;
+	gpointer cached = NULL;
+	gint64 *sum = NULL;
+
+	if (g_hash_table_lookup_extended(matcher->sums, children, NULL, &cached)) {
+		return *(gint64 *)cached;
+	}
+
+	sum = g_new0(gint64, 1);
+	for (child = children; child; child = child->next) {
+		n = (MassifgHeapTreeNode *)child->data;
+		if (query_matcher_matches(matcher, n)) {
+			*sum += n->total_mem_B;
+		}
+		else if (child->children && (max_depth < 0 || depth < max_depth)) {
+			*sum += query_sum_children(matcher, child->children, depth+1, max_depth);
+		}
+	}
+	g_hash_table_insert(matcher->sums, children, sum);
+	return *sum;
+}
+
+/* Get the cached memory usage for pattern and max_depth, computing it if needed */
+static QueryCache *
+query_get_cache(MassifgQuery *query, const gchar *pattern, gint max_depth) {
+	MassifgLabelIndex *index = query->data->label_index ? query->data->label_index : query->own_index;
+	QueryCache *cache = NULL;
+	QueryMatcher matcher;
+	GArray *ids = NULL;
+	GNode *heap_tree = NULL;
+	gchar *folded_pattern = NULL;
+	gchar *key = NULL;
+	guint i;
+
+	if (max_depth < 0)
+		max_depth = -1;
+	if (!pattern)
+		pattern = "";
+
+	folded_pattern = g_ascii_strdown(pattern, -1);
+	key = g_strdup_printf("%d:%s", max_depth, folded_pattern);
+	cache = (QueryCache *)g_hash_table_lookup(query->series, key);
+	if (cache) {
+		g_free(key);
+		g_free(folded_pattern);
+		return cache;
+	}
+
+	/* Find the matching labels */
+	matcher.mask = NULL;
+	matcher.mask_len = 0;
+	matcher.folded_pattern = folded_pattern;
+	matcher.sums = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	if (*folded_pattern) {
+		massifg_label_index_update(index);
+		matcher.mask_len = massifg_label_table_size(query->data->labels);
+		matcher.mask = g_new0(guint8, matcher.mask_len);
+		ids = massifg_label_index_search(index, folded_pattern);
+		for (i=0; i<ids->len; i++) {
+			matcher.mask[g_array_index(ids, guint, i)] = 1;
+		}
+		g_array_free(ids, TRUE);
+	}
+
+	cache = g_new(QueryCache, 1);
+	cache->values = g_new0(gint64, query->num_snapshots);
+	cache->prefix_sums = g_new0(gint64, query->num_snapshots+1);
+	for (i=0; i<query->num_snapshots; i++) {
+		heap_tree = massifg_output_data_get_heap_tree(query->data, query->snapshots[i]);
+		if (heap_tree && heap_tree->children) {
+			cache->values[i] = query_sum_children(&matcher, heap_tree->children, 1, max_depth);
+		}
+		massifg_output_data_release_heap_tree(query->data, query->snapshots[i]);
+
+		/* With a memory budget the tree can be spilled now, and the next tree
+		 * read back into the same memory, so the sums must not outlive it */
+		if (query->data->memory_budget_B)
+			g_hash_table_remove_all(matcher.sums);
+		cache->prefix_sums[i+1] = cache->prefix_sums[i] + cache->values[i];
+	}
+	g_hash_table_insert(query->series, key, cache);
+
+	g_hash_table_destroy(matcher.sums);
+	g_free(matcher.mask);
+	g_free(folded_pattern);
+	return cache;
+}
+
+/* Index of the first snapshot with a time of at least time */
+static guint
+query_find_time(MassifgQuery *query, gint64 time) {
+	guint low = 0, high = query->num_snapshots, mid;
+
+	while (low < high) {
+		mid = low + (high - low)/2;
+		if (query->times[mid] < time)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* Find the snapshots from time_start to time_end, inclusive */
+static void
+query_find_range(MassifgQuery *query, gint64 time_start, gint64 time_end,
+			guint *first, guint *end) {
+	*first = query_find_time(query, time_start);
+	*end = time_end < G_MAXINT64 ? query_find_time(query, time_end+1) : query->num_snapshots;
+	if (*end < *first)
+		*end = *first;
+}
+
+/* Public functions */
+
+/**
+ * massifg_query_new:
+ * @data: The #MassifgOutputData to query. Must stay alive as long as the query
+ * @Returns: A new #MassifgQuery. Free with massifg_query_free()
+ *
+ * Create a #MassifgQuery for the snapshots in @data.
+ */
+MassifgQuery *
+massifg_query_new(MassifgOutputData *data) {
+	MassifgQuery *query = NULL;
+	MassifgSnapshot *snapshot = NULL;
+	GList *l = NULL;
+	guint i = 0;
+
+	g_return_val_if_fail(data != NULL, NULL);
+
+	query = g_new0(MassifgQuery, 1);
+	query->data = data;
+	if (!data->label_index) {
+		query->own_index = massifg_label_index_new(data->labels);
+	}
+
+	for (l = data->snapshots; l; l = l->next) {
+		if (massifg_snapshot_has_heap_tree((MassifgSnapshot *)l->data))
+			query->num_snapshots++;
+	}
+	query->snapshots = g_new(MassifgSnapshot *, query->num_snapshots);
+	query->times = g_new(gint64, query->num_snapshots);
+	for (l = data->snapshots; l; l = l->next) {
+		snapshot = (MassifgSnapshot *)l->data;
+		if (massifg_snapshot_has_heap_tree(snapshot)) {
+			query->snapshots[i] = snapshot;
+			query->times[i] = snapshot->time;
+			i++;
+		}
+	}
+
+	query->series = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify)query_cache_free);
+	return query;
+}
+
+/**
+ * massifg_query_free:
+ * @query: #MassifgQuery to free
+ *
+ * Free a #MassifgQuery and everything it has cached.
+ */
+void
+massifg_query_free(MassifgQuery *query) {
+	if (query->own_index)
+		massifg_label_index_free(query->own_index);
+	g_hash_table_destroy(query->series);
+	g_free(query->snapshots);
+	g_free(query->times);
+	g_free(query);
+}
+
+/**
+ * massifg_query_series:
+ * @query: The #MassifgQuery
+ * @time_start: The first time to include
+ * @time_end: The last time to include. Use %G_MAXINT64 for the end of the output
+ * @pattern: The string the labels must contain, ignoring case.
+ * %NULL or "" matches all labels
+ * @max_depth: The deepest level of the heap trees to look at, where the children
+ * of the root are at level 1. Negative to look at the whole trees
+ * @Returns: The memory attributed to the matching labels for each snapshot with a
+ * heap tree, taken from @time_start to @time_end. Free with massifg_query_series_free()
+ *
+ * Get the memory attributed to the heap tree nodes whose labels contain @pattern,
+ * for each snapshot in a time range.
+ */
+MassifgQuerySeries *
+massifg_query_series(MassifgQuery *query, gint64 time_start, gint64 time_end,
+			const gchar *pattern, gint max_depth) {
+	MassifgQuerySeries *series = NULL;
+	QueryCache *cache = query_get_cache(query, pattern, max_depth);
+	guint first, end, i;
+
+	query_find_range(query, time_start, time_end, &first, &end);
+
+	series = g_new(MassifgQuerySeries, 1);
+	series->num_snapshots = end - first;
+	series->snapshot_nos = g_new(gint, series->num_snapshots);
+	series->times = g_memdup(query->times + first, series->num_snapshots*sizeof(gint64));
+	series->values = g_memdup(cache->values + first, series->num_snapshots*sizeof(gint64));
+	for (i=0; i<series->num_snapshots; i++) {
+		series->snapshot_nos[i] = query->snapshots[first+i]->snapshot_no;
+	}
+	return series;
+}
+
+/**
+ * massifg_query_total:
+ * @query: The #MassifgQuery
+ * @time_start: The first time to include
+ * @time_end: The last time to include. Use %G_MAXINT64 for the end of the output
+ * @pattern: The string the labels must contain, see massifg_query_series()
+ * @max_depth: The deepest level of the heap trees to look at, see massifg_query_series()
+ * @num_snapshots: Return location for the number of snapshots in the time range, or %NULL
+ * @Returns: The sum of the memory attributed to the matching labels over the snapshots
+ *
+ * Like massifg_query_series(), but sums up the memory over the time range.
+ * Divide by @num_snapshots for the average memory usage.
+ */
+gint64
+massifg_query_total(MassifgQuery *query, gint64 time_start, gint64 time_end,
+			const gchar *pattern, gint max_depth, guint *num_snapshots) {
+	QueryCache *cache = query_get_cache(query, pattern, max_depth);
+	guint first, end;
+
+	query_find_range(query, time_start, time_end, &first, &end);
+	if (num_snapshots)
+		*num_snapshots = end - first;
+	return cache->prefix_sums[end] - cache->prefix_sums[first];
+}
+
+/**
+ * massifg_query_series_free:
+ * @series: #MassifgQuerySeries to free
+ *
+ * Free a #MassifgQuerySeries.
+ */
+void
+massifg_query_series_free(MassifgQuerySeries *series) {
+	g_free(series->snapshot_nos);
+	g_free(series->times);
+	g_free(series->values);
+	g_free(series);
+}
@@ -0,0 +1,75 @@
+/*
+ *  MassifG - massifg_query.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_QUERY_H__
+#define MASSIFG_QUERY_H__
+
+#include <glib.h>
+
+#include "massifg_parser.h"
+
+/* Data structures */
+
+/**
+ * MassifgQuery:
+ *
+ * Answers queries about the memory usage in a #MassifgOutputData,
+ * caching what it computes for later queries.
+ */
+typedef struct {
+	/*< private >*/
+	MassifgOutputData *data;
+	MassifgLabelIndex *own_index;
+
+	guint num_snapshots;
+	MassifgSnapshot **snapshots;
+	gint64 *times;
+
+	GHashTable *series;
+} MassifgQuery;
+
+/**
+ * MassifgQuerySeries:
+ * @num_snapshots: Number of snapshots in the series.
+ * @snapshot_nos: The number of each snapshot, see #MassifgSnapshot.
+ * @times: The time of each snapshot.
+ * @values: The memory, in bytes, attributed to the matching labels in each snapshot.
+ *
+ * The result of massifg_query_series().
+ */
+typedef struct {
+	guint num_snapshots;
+	gint *snapshot_nos;
+	gint64 *times;
+	gint64 *values;
+} MassifgQuerySeries;
+
+/* Public functions */
+MassifgQuery *massifg_query_new(MassifgOutputData *data);
+void massifg_query_free(MassifgQuery *query);
+
+MassifgQuerySeries *massifg_query_series(MassifgQuery *query, gint64 time_start, gint64 time_end,
+				const gchar *pattern, gint max_depth);
+gint64 massifg_query_total(MassifgQuery *query, gint64 time_start, gint64 time_end,
+				const gchar *pattern, gint max_depth, guint *num_snapshots);
+void massifg_query_series_free(MassifgQuerySeries *series);
+
+#endif /* MASSIFG_QUERY_H__ */
@@ -0,0 +1,138 @@
+/*
+ *  MassifG - massifg_run.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_run
+ * @short_description: Running massif on a program
+ * @title: MassifG Runs
+ * @stability: Unstable
+ *
+ * Runs a program under massif, with the massif output written to a pipe
+ * instead of a file, so that it can be fed to a #MassifgParser as it is written.
+ *
+ * Valgrind is found in the PATH, unless the MASSIFG_VALGRIND environment
+ * variable names another program to run instead. That program is given the same
+ * arguments as valgrind would be, which the test suite uses to run a stand-in
+ * script that writes canned output.
+ */
+
+#include <errno.h>
+#include <fcntl.h> /* for fcntl() */
+#include <unistd.h> /* for pipe(), dup2() */
+
+#include <glib.h>
+
+#include "massifg_run.h"
+
+/* Private data structures */
+
+/* The file descriptor massif writes its output to, in the child */
+#define MASSIFG_RUN_OUTPUT_FD 3
+
+/* Private functions */
+
+/* Called in the child before it runs valgrind, as a GSpawnChildSetupFunc.
+ * All descriptors above stderr are closed on exec by then, so the write end
+ * of the pipe is made available to massif as MASSIFG_RUN_OUTPUT_FD */
+static void
+massifg_run_child_setup(gpointer user_data) {
+	gint fd = GPOINTER_TO_INT(user_data);
+
+	if (fd == MASSIFG_RUN_OUTPUT_FD) {
+		fcntl(fd, F_SETFD, 0);
+	}
+	else {
+		dup2(fd, MASSIFG_RUN_OUTPUT_FD);
+	}
+}
+
+/* Reap the child when it exits, as a GChildWatchFunc */
+static void
+massifg_run_child_exited(GPid pid, gint status, gpointer user_data) {
+	g_spawn_close_pid(pid);
+}
+
+/* Public functions */
+
+/**
+ * massifg_run_spawn:
+ * @argv: %NULL-terminated array with the program to run under massif, and its arguments
+ * @child_pid: Location to store the process id of valgrind, or %NULL
+ * @error: Location to store a #GError or %NULL
+ * @Returns: A #GIOChannel that the massif output can be read from, or %NULL on failure.
+ * Unref with g_io_channel_unref(), which closes the pipe
+ *
+ * Start running a program under massif. The channel is non-blocking, and reaches
+ * the end of the file when massif is done. The child is reaped from the main loop
+ * when it exits.
+ */
+GIOChannel *
+massifg_run_spawn(const gchar * const *argv, GPid *child_pid, GError **error) {
+	GIOChannel *io_channel = NULL;
+	GPtrArray *command = NULL;
+	const gchar *valgrind = NULL;
+	gint fds[2];
+	GPid pid;
+	gboolean spawned;
+	guint i;
+
+	g_return_val_if_fail(argv && argv[0], NULL);
+
+	if (pipe(fds) != 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+			"Could not create a pipe: %s", g_strerror(errno));
+		return NULL;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+	valgrind = g_getenv("MASSIFG_VALGRIND");
+	command = g_ptr_array_new_with_free_func(g_free);
+	g_ptr_array_add(command, g_strdup(valgrind ? valgrind : "valgrind"));
+	g_ptr_array_add(command, g_strdup("--tool=massif"));
+	g_ptr_array_add(command, g_strdup_printf("--massif-out-file=/dev/fd/%d", MASSIFG_RUN_OUTPUT_FD));
+	for (i=0; argv[i]; i++) {
+		g_ptr_array_add(command, g_strdup(argv[i]));
+	}
+	g_ptr_array_add(command, NULL);
+
+	spawned = g_spawn_async(NULL, (gchar **)command->pdata, NULL,
+			G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+			massifg_run_child_setup, GINT_TO_POINTER(fds[1]), &pid, error);
+	g_ptr_array_free(command, TRUE);
+
+	/* Only the child writes to the pipe, so that it ends when massif is done */
+	close(fds[1]);
+	if (!spawned) {
+		close(fds[0]);
+		return NULL;
+	}
+	g_child_watch_add(pid, massifg_run_child_exited, NULL);
+
+	io_channel = g_io_channel_unix_new(fds[0]);
+	g_io_channel_set_close_on_unref(io_channel, TRUE);
+	g_io_channel_set_encoding(io_channel, NULL, NULL);
+	g_io_channel_set_flags(io_channel, G_IO_FLAG_NONBLOCK, NULL);
+
+	if (child_pid) {
+		*child_pid = pid;
+	}
+	return io_channel;
+}
@@ -0,0 +1,30 @@
+/*
+ *  MassifG - massifg_run.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_RUN_H__
+#define MASSIFG_RUN_H__
+
+#include <glib.h>
+
+/* Public functions */
+GIOChannel *massifg_run_spawn(const gchar * const *argv, GPid *child_pid, GError **error);
+
+#endif /* MASSIFG_RUN_H__ */
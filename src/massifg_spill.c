@@ -0,0 +1,201 @@
+/*
+ *  MassifG - massifg_spill.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_spill
+ * @short_description: Temporary storage for data that does not fit in memory
+ * @title: MassifG Spill Files
+ * @stability: Unstable
+ *
+ * A spill file is an anonymous temporary file. Data is only ever appended to it,
+ * so data that has been written stays at the same offset until the file is freed.
+ * It is read back through a read-only memory mapping of the file, which is
+ * extended when data beyond its end is read. The file is removed as soon as it
+ * has been created, so it does not outlive the program.
+ *
+ * A #MassifgSpillFile does no locking, the caller must serialize the calls.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "massifg_spill.h"
+
+struct _MassifgSpillFile {
+	gint fd;
+	guint64 size;
+
+	gpointer map;
+	gsize map_size;
+};
+
+/* Private functions */
+
+/* Set error from errno, with a message about what failed */
+static void
+spill_file_set_error(GError **error, const gchar *what) {
+	gint saved_errno = errno;
+
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+		"Unable to %s spill file: %s", what, g_strerror(saved_errno));
+}
+
+/* Drop the current mapping, if any */
+static void
+spill_file_unmap(MassifgSpillFile *file) {
+	if (file->map) {
+		munmap(file->map, file->map_size);
+		file->map = NULL;
+		file->map_size = 0;
+	}
+}
+
+/* Public functions */
+
+/**
+ * massifg_spill_file_new:
+ * @error: Location to store a #GError or %NULL
+ * @Returns: A new, empty #MassifgSpillFile, or %NULL on failure.
+ * Free with massifg_spill_file_free()
+ *
+ * Create a spill file in the directory for temporary files, see g_get_tmp_dir().
+ */
+MassifgSpillFile *
+massifg_spill_file_new(GError **error) {
+	MassifgSpillFile *file = NULL;
+	gchar *path = NULL;
+	gint fd;
+
+	fd = g_file_open_tmp("massifg-spill-XXXXXX", &path, error);
+	if (fd < 0)
+		return NULL;
+
+	/* Only the descriptor refers to the file from now on */
+	g_unlink(path);
+	g_free(path);
+
+	file = g_new(MassifgSpillFile, 1);
+	file->fd = fd;
+	file->size = 0;
+	file->map = NULL;
+	file->map_size = 0;
+	return file;
+}
+
+/**
+ * massifg_spill_file_free:
+ * @file: #MassifgSpillFile to free
+ *
+ * Close a spill file, which releases the disk space it used.
+ */
+void
+massifg_spill_file_free(MassifgSpillFile *file) {
+	spill_file_unmap(file);
+	close(file->fd);
+	g_free(file);
+}
+
+/**
+ * massifg_spill_file_append:
+ * @file: A #MassifgSpillFile
+ * @buffer: The data to write
+ * @length: Length of @buffer in bytes
+ * @offset: Location to store the offset the data was written at
+ * @error: Location to store a #GError or %NULL
+ * @Returns: %TRUE if all of the data was written, %FALSE on failure
+ *
+ * Append data to the end of a spill file. If writing fails, the file is left
+ * as it was.
+ */
+gboolean
+massifg_spill_file_append(MassifgSpillFile *file, gconstpointer buffer, gsize length,
+				guint64 *offset, GError **error) {
+	const gchar *data = (const gchar *)buffer;
+	gsize written = 0;
+	gssize result;
+
+	while (written < length) {
+		result = write(file->fd, data + written, length - written);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result < 0) {
+			spill_file_set_error(error, "write");
+			/* Later appends overwrite the part that was written */
+			if (lseek(file->fd, file->size, SEEK_SET) < 0) {
+				g_warning("Unable to seek in spill file: %s", g_strerror(errno));
+			}
+			return FALSE;
+		}
+		written += result;
+	}
+
+	*offset = file->size;
+	file->size += length;
+	return TRUE;
+}
+
+/**
+ * massifg_spill_file_read:
+ * @file: A #MassifgSpillFile
+ * @offset: Offset of the data, as stored by massifg_spill_file_append()
+ * @length: Length of the data in bytes
+ * @error: Location to store a #GError or %NULL
+ * @Returns: The data, or %NULL on failure. Owned by @file, and only valid until
+ * the next call to massifg_spill_file_read() or massifg_spill_file_free()
+ *
+ * Get data that has been written to a spill file. The file is mapped into memory
+ * again if the data is beyond the end of the current mapping, so the pages
+ * of data that is read often are kept in memory by the operating system.
+ */
+gconstpointer
+massifg_spill_file_read(MassifgSpillFile *file, guint64 offset, gsize length, GError **error) {
+	gpointer map = NULL;
+
+	g_return_val_if_fail(offset + length <= file->size, NULL);
+
+	if (offset + length > file->map_size) {
+		spill_file_unmap(file);
+		map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+		if (map == MAP_FAILED) {
+			spill_file_set_error(error, "map");
+			return NULL;
+		}
+		file->map = map;
+		file->map_size = file->size;
+	}
+	return (const gchar *)file->map + offset;
+}
+
+/**
+ * massifg_spill_file_get_size:
+ * @file: A #MassifgSpillFile
+ * @Returns: The number of bytes that have been written to @file
+ *
+ * Get the size of a spill file.
+ */
+guint64
+massifg_spill_file_get_size(MassifgSpillFile *file) {
+	return file->size;
+}
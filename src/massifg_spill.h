@@ -0,0 +1,46 @@
+/*
+ *  MassifG - massifg_spill.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_SPILL_H__
+#define MASSIFG_SPILL_H__
+
+#include <glib.h>
+
+/* Data structures */
+
+/**
+ * MassifgSpillFile:
+ *
+ * A temporary file that data is appended to, and read back from through a
+ * memory mapping. See massifg_spill_file_new().
+ */
+typedef struct _MassifgSpillFile MassifgSpillFile;
+
+/* Public functions */
+MassifgSpillFile *massifg_spill_file_new(GError **error);
+void massifg_spill_file_free(MassifgSpillFile *file);
+gboolean massifg_spill_file_append(MassifgSpillFile *file, gconstpointer buffer, gsize length,
+				guint64 *offset, GError **error);
+gconstpointer massifg_spill_file_read(MassifgSpillFile *file, guint64 offset, gsize length,
+				GError **error);
+guint64 massifg_spill_file_get_size(MassifgSpillFile *file);
+
+#endif /* MASSIFG_SPILL_H__ */
@@ -0,0 +1,193 @@
+/*
+ *  MassifG - massifg_trace.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_trace
+ * @short_description: Timing the phases of the program
+ * @title: MassifG Tracing
+ * @stability: Unstable
+ *
+ * Spans around the expensive phases, such as opening and parsing a file,
+ * building the heap trees, the detailed table and the graph series, and rendering.
+ * When the environment variable MASSIFG_TRACE is set to a file name, the spans
+ * are written to that file in the trace event format of Chrome, which can be
+ * loaded in chrome://tracing. Each span is written when it ends, as a complete event.
+ *
+ * When tracing is disabled, beginning and ending a span only tests a global flag,
+ * so the spans are always compiled in.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h> /* for atexit() */
+#include <unistd.h> /* for getpid() */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "massifg_trace.h"
+
+gboolean massifg_trace_enabled = FALSE;
+
+static FILE *trace_file = NULL;
+static GMutex *trace_lock = NULL;
+static GTimer *trace_timer = NULL;
+static GHashTable *trace_threads = NULL; /* GThread -> small thread id, for the viewer */
+static gboolean trace_has_events = FALSE;
+
+/* Private functions */
+
+/* Microseconds since tracing started */
+static gdouble
+trace_now(void) {
+	return g_timer_elapsed(trace_timer, NULL)*G_USEC_PER_SEC;
+}
+
+/* Id of the calling thread, with trace_lock held */
+static guint
+trace_thread_id(void) {
+	GThread *self = g_thread_self();
+	guint id = GPOINTER_TO_UINT(g_hash_table_lookup(trace_threads, self));
+
+	if (!id) {
+		id = g_hash_table_size(trace_threads) + 1;
+		g_hash_table_insert(trace_threads, self, GUINT_TO_POINTER(id));
+	}
+	return id;
+}
+
+/* Public functions */
+
+/**
+ * massifg_trace_span_begin:
+ * @span: The #MassifgTraceSpan to begin
+ * @name: Name of the span, a static string that needs no escaping in JSON
+ *
+ * Begin a span. Use the massifg_trace_begin() macro instead, which only calls
+ * this when tracing is enabled.
+ */
+void
+massifg_trace_span_begin(MassifgTraceSpan *span, const gchar *name) {
+	span->name = name;
+	span->start = trace_now();
+}
+
+/**
+ * massifg_trace_span_end:
+ * @span: A #MassifgTraceSpan
+ *
+ * End a span and write it. Use the massifg_trace_end() macro instead.
+ * Can be called from any thread.
+ */
+void
+massifg_trace_span_end(MassifgTraceSpan *span) {
+	gdouble end = trace_now();
+
+	g_mutex_lock(trace_lock);
+	if (trace_file) {
+		fprintf(trace_file, "%s{\"name\":\"%s\",\"cat\":\"massifg\",\"ph\":\"X\","
+			"\"ts\":%.0f,\"dur\":%.0f,\"pid\":%d,\"tid\":%u}",
+			trace_has_events ? ",\n" : "", span->name,
+			span->start, end - span->start, (gint)getpid(), trace_thread_id());
+		trace_has_events = TRUE;
+	}
+	g_mutex_unlock(trace_lock);
+}
+
+/**
+ * massifg_trace_start:
+ * @filename: Path to the trace file to write. Overwritten if it exists
+ * @error: Location to store a #GError or %NULL
+ * @Returns: %TRUE if tracing was started, %FALSE on failure
+ *
+ * Start writing spans to @filename, until massifg_trace_stop() is called.
+ * Tracing must not start while spans are in progress.
+ */
+gboolean
+massifg_trace_start(const gchar *filename, GError **error) {
+	FILE *file = NULL;
+
+	massifg_trace_stop();
+
+	file = g_fopen(filename, "w");
+	if (!file) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+			"Unable to open trace file %s: %s", filename, g_strerror(errno));
+		return FALSE;
+	}
+	fputs("[\n", file);
+
+	/* Kept when tracing stops, spans that are ending might still use them */
+	if (!trace_lock) {
+		trace_lock = g_mutex_new();
+		trace_timer = g_timer_new();
+	}
+	trace_threads = g_hash_table_new(g_direct_hash, g_direct_equal);
+	trace_has_events = FALSE;
+	trace_file = file;
+	massifg_trace_enabled = TRUE;
+	return TRUE;
+}
+
+/**
+ * massifg_trace_stop:
+ *
+ * Stop tracing and finish writing the trace file. Does nothing if tracing is disabled.
+ */
+void
+massifg_trace_stop(void) {
+	if (!massifg_trace_enabled)
+		return;
+
+	g_mutex_lock(trace_lock);
+	massifg_trace_enabled = FALSE;
+	fputs("\n]\n", trace_file);
+	fclose(trace_file);
+	trace_file = NULL;
+	g_hash_table_destroy(trace_threads);
+	trace_threads = NULL;
+	g_mutex_unlock(trace_lock);
+}
+
+/**
+ * massifg_trace_init:
+ *
+ * Checks for the environment variable MASSIFG_TRACE, and if it is set,
+ * starts writing the spans to the file it names. The file is finished
+ * when the program exits.
+ */
+void
+massifg_trace_init(void) {
+	static gboolean initialized = FALSE;
+	const gchar *filename = g_getenv("MASSIFG_TRACE");
+	GError *error = NULL;
+
+	if (initialized || !filename || !*filename)
+		return;
+	initialized = TRUE;
+
+	if (!massifg_trace_start(filename, &error)) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+		return;
+	}
+	atexit(massifg_trace_stop);
+}
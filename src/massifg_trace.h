@@ -0,0 +1,75 @@
+/*
+ *  MassifG - massifg_trace.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_TRACE_H__
+#define MASSIFG_TRACE_H__
+
+#include <glib.h>
+
+/* Data structures */
+
+/**
+ * MassifgTraceSpan:
+ * @name: Name of the span, a static string
+ * @start: Time the span began, in microseconds since tracing started
+ *
+ * A timed phase of the program, such as parsing a file. Usually on the stack,
+ * between massifg_trace_begin() and massifg_trace_end().
+ */
+typedef struct {
+	const gchar *name;
+	gdouble start;
+} MassifgTraceSpan;
+
+/* Only for use by the macros below */
+extern gboolean massifg_trace_enabled;
+void massifg_trace_span_begin(MassifgTraceSpan *span, const gchar *name);
+void massifg_trace_span_end(MassifgTraceSpan *span);
+
+/**
+ * massifg_trace_begin:
+ * @span: The #MassifgTraceSpan to begin
+ * @span_name: Name of the span, a static string
+ *
+ * Begin a span. When tracing is disabled this is a single test of a global flag.
+ */
+#define massifg_trace_begin(span, span_name) G_STMT_START { \
+	if (G_UNLIKELY(massifg_trace_enabled)) \
+		massifg_trace_span_begin((span), (span_name)); \
+} G_STMT_END
+
+/**
+ * massifg_trace_end:
+ * @span: A #MassifgTraceSpan begun with massifg_trace_begin()
+ *
+ * End a span and write it to the trace file.
+ */
+#define massifg_trace_end(span) G_STMT_START { \
+	if (G_UNLIKELY(massifg_trace_enabled)) \
+		massifg_trace_span_end(span); \
+} G_STMT_END
+
+/* Public functions */
+void massifg_trace_init(void);
+gboolean massifg_trace_start(const gchar *filename, GError **error);
+void massifg_trace_stop(void);
+
+#endif /* MASSIFG_TRACE_H__ */
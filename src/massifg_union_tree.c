@@ -0,0 +1,326 @@
+/*
+ *  MassifG - massifg_union_tree.c
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:massifg_union_tree
+ * @short_description: The heap trees of all snapshots merged into one tree
+ * @title: MassifG Union Call Tree
+ * @stability: Unstable
+ *
+ * A union call tree has one node for every call path that appears in any of
+ * the heap trees, where a call path is the sequence of labels from the root
+ * to a node. Each node holds a column with the memory usage of its call path
+ * in every snapshot it appears in, so the time series of a call path can be
+ * read directly instead of walking the heap trees of all the snapshots.
+ *
+ * The heap trees are added in the order of the snapshots, which keeps each
+ * column sorted by snapshot and lets the values be appended. The roots of
+ * the heap trees are all merged into the root of the union tree, whatever
+ * their labels. Children with the same label under the same parent are merged
+ * into one node, and their memory usage is added.
+ *
+ * The parser builds the union tree while parsing when asked to,
+ * see massifg_parser_set_build_union_tree().
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "massifg_parser.h"
+#include "massifg_union_tree.h"
+
+/* Private data structures */
+
+/* Number of children at which a node starts looking them up in a hash table
+ * instead of going through the list of children */
+#define UNION_NODE_HASH_MIN_CHILDREN 8
+
+/* Number of values the column of a new node has room for */
+#define UNION_NODE_INITIAL_VALUES 4
+
+/* Private functions */
+
+/* Create a node for a call path ending with label_id, with an empty column */
+static GNode *
+union_node_new(MassifgUnionTree *tree, guint label_id) {
+	MassifgUnionNode *node = g_new(MassifgUnionNode, 1);
+
+	node->label_id = label_id;
+	node->num_values = 0;
+	node->allocated_values = UNION_NODE_INITIAL_VALUES;
+	node->snapshots = g_new(guint, node->allocated_values);
+	node->values = g_new(gint64, node->allocated_values);
+	node->children_by_label = NULL;
+
+	tree->num_nodes++;
+	return g_node_new(node);
+}
+
+/* Free the data of a union node. Used as a GNodeTraverseFunc */
+static gboolean
+union_node_free(GNode *node, gpointer user_data) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+
+	if (n->children_by_label)
+		g_hash_table_destroy(n->children_by_label);
+	g_free(n->snapshots);
+	g_free(n->values);
+	g_free(n);
+	return FALSE;
+}
+
+/* Add mem_B to the value of the node in a snapshot. Snapshots must be added in order */
+static void
+union_node_add_value(MassifgUnionTree *tree, MassifgUnionNode *node, guint snapshot_index, gint64 mem_B) {
+	if (node->num_values && node->snapshots[node->num_values-1] == snapshot_index) {
+		/* Another child with the same label under the same parent */
+		node->values[node->num_values-1] += mem_B;
+		return;
+	}
+
+	if (node->num_values == node->allocated_values) {
+		node->allocated_values *= 2;
+		node->snapshots = g_renew(guint, node->snapshots, node->allocated_values);
+		node->values = g_renew(gint64, node->values, node->allocated_values);
+	}
+	node->snapshots[node->num_values] = snapshot_index;
+	node->values[node->num_values] = mem_B;
+	node->num_values++;
+	tree->num_values++;
+}
+
+/* Get the child of a union node with label_id, creating it if there is none */
+static GNode *
+union_node_get_child(MassifgUnionTree *tree, GNode *node, guint label_id) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+	GNode *child = massifg_union_node_find_child(node, label_id);
+
+	if (child)
+		return child;
+
+	child = g_node_append(node, union_node_new(tree, label_id));
+	if (n->children_by_label) {
+		g_hash_table_insert(n->children_by_label, GUINT_TO_POINTER(label_id), child);
+	}
+	else if (g_node_n_children(node) >= UNION_NODE_HASH_MIN_CHILDREN) {
+		n->children_by_label = g_hash_table_new(g_direct_hash, g_direct_equal);
+		for (child = node->children; child; child = child->next) {
+			g_hash_table_insert(n->children_by_label,
+				GUINT_TO_POINTER(((MassifgUnionNode *)child->data)->label_id), child);
+		}
+		child = g_node_last_child(node);
+	}
+	return child;
+}
+
+/* Add a heap tree node and the subtree under it to the union node of its call path */
+static void
+union_node_add_heap_tree(MassifgUnionTree *tree, GNode *union_node, GNode *heap_node,
+				guint snapshot_index) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)heap_node->data;
+	GNode *child = NULL;
+
+	union_node_add_value(tree, (MassifgUnionNode *)union_node->data, snapshot_index, n->total_mem_B);
+	for (child = heap_node->children; child; child = child->next) {
+		union_node_add_heap_tree(tree,
+			union_node_get_child(tree, union_node, ((MassifgHeapTreeNode *)child->data)->label_id),
+			child, snapshot_index);
+	}
+}
+
+/* Give the column of a union node back the room it does not use. Used as a GNodeTraverseFunc */
+static gboolean
+union_node_compact(GNode *node, gpointer user_data) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+
+	if (n->allocated_values > n->num_values && n->num_values) {
+		n->allocated_values = n->num_values;
+		n->snapshots = g_renew(guint, n->snapshots, n->allocated_values);
+		n->values = g_renew(gint64, n->values, n->allocated_values);
+	}
+	return FALSE;
+}
+
+/* Add the memory size of a union node to the gsize user_data points to. Used as a GNodeTraverseFunc */
+static gboolean
+union_node_add_memory_size(GNode *node, gpointer user_data) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+	gsize *size = (gsize *)user_data;
+
+	*size += sizeof(MassifgUnionNode) + sizeof(GNode)
+		+ n->allocated_values*(sizeof(guint) + sizeof(gint64));
+	if (n->children_by_label)
+		*size += g_hash_table_size(n->children_by_label)*(2*sizeof(gpointer) + sizeof(guint));
+	return FALSE;
+}
+
+/* Public functions */
+
+/**
+ * massifg_union_tree_new:
+ * @Returns: A new, empty #MassifgUnionTree. Free with massifg_union_tree_free()
+ *
+ * Create a union call tree, to add the heap trees of the snapshots to
+ * with massifg_union_tree_add_heap_tree().
+ */
+MassifgUnionTree *
+massifg_union_tree_new(void) {
+	MassifgUnionTree *tree = g_new(MassifgUnionTree, 1);
+
+	tree->root = NULL;
+	tree->num_nodes = 0;
+	tree->num_values = 0;
+	return tree;
+}
+
+/**
+ * massifg_union_tree_free:
+ * @tree: #MassifgUnionTree to free
+ *
+ * Free a #MassifgUnionTree and all its nodes.
+ */
+void
+massifg_union_tree_free(MassifgUnionTree *tree) {
+	if (tree->root) {
+		g_node_traverse(tree->root, G_PRE_ORDER, G_TRAVERSE_ALL, -1, union_node_free, NULL);
+		g_node_destroy(tree->root);
+	}
+	g_free(tree);
+}
+
+/**
+ * massifg_union_tree_add_heap_tree:
+ * @tree: A #MassifgUnionTree
+ * @snapshot_index: Index of the snapshot in the list of snapshots of the output data.
+ * Must not be smaller than the index of any heap tree added before
+ * @heap_tree: The heap tree of the snapshot, as a tree of #MassifgHeapTreeNode
+ *
+ * Merge a heap tree into the union tree, adding a value to the column of
+ * the node of every call path in it. The labels must have been interned in
+ * the same #MassifgLabelTable as the trees added before.
+ * The cost is one lookup per node in the heap tree.
+ */
+void
+massifg_union_tree_add_heap_tree(MassifgUnionTree *tree, guint snapshot_index, GNode *heap_tree) {
+	if (!tree->root)
+		tree->root = union_node_new(tree, ((MassifgHeapTreeNode *)heap_tree->data)->label_id);
+	union_node_add_heap_tree(tree, tree->root, heap_tree, snapshot_index);
+}
+
+/**
+ * massifg_union_tree_compact:
+ * @tree: A #MassifgUnionTree
+ *
+ * Free the room the columns have for values that are yet to be added.
+ * Heap trees can still be added afterwards.
+ */
+void
+massifg_union_tree_compact(MassifgUnionTree *tree) {
+	if (tree->root)
+		g_node_traverse(tree->root, G_PRE_ORDER, G_TRAVERSE_ALL, -1, union_node_compact, NULL);
+}
+
+/**
+ * massifg_union_tree_get_memory_size:
+ * @tree: A #MassifgUnionTree
+ * @Returns: Estimated size of the tree in bytes
+ *
+ * Estimate how much memory the union tree uses, with the columns of its nodes.
+ */
+gsize
+massifg_union_tree_get_memory_size(MassifgUnionTree *tree) {
+	gsize size = sizeof(MassifgUnionTree);
+
+	if (tree->root)
+		g_node_traverse(tree->root, G_PRE_ORDER, G_TRAVERSE_ALL, -1, union_node_add_memory_size, &size);
+	return size;
+}
+
+/**
+ * massifg_union_node_find_child:
+ * @node: A node in a #MassifgUnionTree
+ * @label_id: The label id of the child
+ * @Returns: The child of @node with @label_id, or %NULL if there is none
+ *
+ * Find the node of the call path of @node followed by @label_id.
+ */
+GNode *
+massifg_union_node_find_child(GNode *node, guint label_id) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+	GNode *child = NULL;
+
+	if (n->children_by_label)
+		return (GNode *)g_hash_table_lookup(n->children_by_label, GUINT_TO_POINTER(label_id));
+
+	for (child = node->children; child; child = child->next) {
+		if (((MassifgUnionNode *)child->data)->label_id == label_id)
+			return child;
+	}
+	return NULL;
+}
+
+/**
+ * massifg_union_node_get_value:
+ * @node: A #MassifgUnionNode
+ * @snapshot_index: Index of a snapshot in the list of snapshots of the output data
+ * @Returns: The memory usage of the call path of @node in the snapshot,
+ * or 0 if it does not appear in it
+ *
+ * Get the value of @node in one snapshot, with a binary search of its column.
+ */
+gint64
+massifg_union_node_get_value(MassifgUnionNode *node, guint snapshot_index) {
+	guint low = 0;
+	guint high = node->num_values;
+	guint middle;
+
+	while (low < high) {
+		middle = low + (high - low)/2;
+		if (node->snapshots[middle] < snapshot_index)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low < node->num_values && node->snapshots[low] == snapshot_index)
+		return node->values[low];
+	return 0;
+}
+
+/**
+ * massifg_union_node_get_series:
+ * @node: A #MassifgUnionNode
+ * @series: Array of @num_snapshots values to fill in
+ * @num_snapshots: Number of snapshots in the output data
+ *
+ * Get the memory usage of the call path of @node in every snapshot, with 0 for
+ * the snapshots it does not appear in. The cost is proportional to
+ * @num_snapshots, not to the size of the heap trees.
+ */
+void
+massifg_union_node_get_series(MassifgUnionNode *node, gdouble *series, guint num_snapshots) {
+	guint i;
+
+	memset(series, 0, num_snapshots*sizeof(gdouble));
+	for (i=0; i<node->num_values && node->snapshots[i] < num_snapshots; i++) {
+		series[node->snapshots[i]] = node->values[i];
+	}
+}
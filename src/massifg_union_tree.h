@@ -0,0 +1,77 @@
+/*
+ *  MassifG - massifg_union_tree.h
+ *
+ *  Copyright (C) 2010 Openismus GmbH
+ *
+ *  Author: Jon Nordby <jonn@openismus.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASSIFG_UNION_TREE_H__
+#define MASSIFG_UNION_TREE_H__
+
+#include <glib.h>
+
+/* Data structures */
+
+/**
+ * MassifgUnionNode:
+ * @label_id: Id of the label of the node, in the #MassifgLabelTable of the output data.
+ * @num_values: The number of snapshots the call path of this node appears in.
+ * @snapshots: Indexes of those snapshots in the list of snapshots of the output data,
+ * in increasing order.
+ * @values: The memory usage under this node in each of those snapshots, in bytes.
+ *
+ * One call path in a #MassifgUnionTree, with its column of values. The
+ * column is sparse: snapshots the call path does not appear in have no value.
+ */
+typedef struct {
+	guint label_id;
+	guint num_values;
+	guint *snapshots;
+	gint64 *values;
+
+	/*< private >*/
+	guint allocated_values;
+	GHashTable *children_by_label; /* Label id -> child GNode, once there are many children */
+} MassifgUnionNode;
+
+/**
+ * MassifgUnionTree:
+ * @root: The merged roots of the heap trees, as a #GNode tree of #MassifgUnionNode,
+ * or %NULL if no heap tree has been added.
+ * @num_nodes: The number of nodes, which is the number of distinct call paths.
+ * @num_values: The number of values in the columns of all the nodes together.
+ *
+ * The heap trees of all the snapshots merged into one tree, see massifg_union_tree_new().
+ */
+typedef struct {
+	GNode *root;
+	guint num_nodes;
+	guint64 num_values;
+} MassifgUnionTree;
+
+/* Public functions */
+MassifgUnionTree *massifg_union_tree_new(void);
+void massifg_union_tree_free(MassifgUnionTree *tree);
+void massifg_union_tree_add_heap_tree(MassifgUnionTree *tree, guint snapshot_index, GNode *heap_tree);
+void massifg_union_tree_compact(MassifgUnionTree *tree);
+gsize massifg_union_tree_get_memory_size(MassifgUnionTree *tree);
+
+GNode *massifg_union_node_find_child(GNode *node, guint label_id);
+gint64 massifg_union_node_get_value(MassifgUnionNode *node, guint snapshot_index);
+void massifg_union_node_get_series(MassifgUnionNode *node, gdouble *series, guint num_snapshots);
+
+#endif /* MASSIFG_UNION_TREE_H__ */
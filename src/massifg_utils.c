@@ -32,81 +32,11 @@
 #include <glib.h>
 #include "config.h"
 
-/* Private functions */
-
-/* Search system directories for given filename, as given by the glib function g_get_system_data_dirs()
- * Caller is responsible for freeing the returned array
- * Returns an absolute path, or NULL on */
-static gchar *
-get_system_file(const gchar *progam_name, const gchar *filename)
-{
-   gchar *pathname = NULL;
-   const gchar* const *system_data_dirs;
-
-   /* Iterate over array of strings to find system data files. */
-   for (system_data_dirs = g_get_system_data_dirs (); *system_data_dirs != NULL; system_data_dirs++)
-   {
-      pathname = g_build_filename(*system_data_dirs, progam_name, filename, NULL);
-      if (g_file_test(pathname, G_FILE_TEST_EXISTS))
-      {
-         break;
-      }
-      else
-      {
-         g_free (pathname);
-         pathname = NULL;
-      }
-   }
-   return pathname;
-}
-
-/* Public functions */
-
-/**
- * massifg_utils_get_resource_file:
- * @filename: file to search for
- * @Returns: the path to the file as a newly allocated string (free with g_free()), or NULL on failure
- *
- * Find a resource file
- *
- * First checks ./data/ in case the program is running from the build dir.
- * Secondly, INSTALL_PREFIX/share in case of running from a non-system prefix.
- * Then, checks the system folders as given by g_get_system_data_dirs()
- *
- * Note: Not suitable for use in other applications, hardcodes the application name to "massifg"
- */
-gchar *
-massifg_utils_get_resource_file(const gchar *filename) {
-	gchar *pathname = NULL;
-	gchar *run_prefix = NULL;
-	const gchar *application_name = PACKAGE_TARNAME;
-
-	/* Check in ./data/ */
-	run_prefix = g_get_current_dir();
-	pathname = g_build_filename(run_prefix, "data", filename, NULL);
-	if (!g_file_test(pathname, G_FILE_TEST_EXISTS)) {
-		g_free(pathname);
-		pathname = NULL;
-	}
-	g_free((gpointer)run_prefix);
-
-	/* If the file was not found, check in INSTALL_PREFIX/share/APPNAME/ */
-	if (!pathname) {
-		pathname = g_build_filename(INSTALL_PREFIX, "share", application_name, filename, NULL);
-		if (!g_file_test(pathname, G_FILE_TEST_EXISTS)) {
-			g_free(pathname);
-			pathname = NULL;
-		}
-	}
+#include "massifg_utils.h"
 
-	/* If the file was not found, check in system directories */
-	if (!pathname) {
-		pathname = get_system_file(application_name, filename);
-	}
+guint massifg_debug_flags = 0;
 
-	g_debug("Path to resource file \"%s\": %s", filename, pathname);
-	return pathname;
-}
+/* Public functions */
 
 /**
  * massifg_utils_log_ignore:
@@ -141,18 +71,24 @@ void massifg_utils_free_foreach(gpointer data, gpointer user_data) {
 /**
  * massifg_utils_configure_debug_output:
  *
- * Checks for the environment variable MASSIFG_DEBUG,
- * if it is not "enable" or "all", debug output will be ignored.
+ * Checks for the environment variable MASSIFG_DEBUG, a list of the
+ * #MassifgDebugFlags categories to enable, separated by commas or colons,
+ * for instance "parser,graph". "enable" or "all" enables all of them.
+ * If no category is enabled, all debug output will be ignored.
  */
 void
 massifg_utils_configure_debug_output(void) {
-	/* TODO: Allow enabling debug output for just the UI, grapher or parser */
-	GDebugKey debug_keys[] = { {"enable", 1<<0}, };
+	const GDebugKey debug_keys[] = {
+		{"parser", MASSIFG_DEBUG_PARSER},
+		{"graph", MASSIFG_DEBUG_GRAPH},
+		{"ui", MASSIFG_DEBUG_UI},
+		{"enable", MASSIFG_DEBUG_PARSER | MASSIFG_DEBUG_GRAPH | MASSIFG_DEBUG_UI},
+	};
 	const guint num_debug_keys = G_N_ELEMENTS(debug_keys);
 	const gchar* debug_string = g_getenv("MASSIFG_DEBUG");
 
-	guint debug = g_parse_debug_string(debug_string, debug_keys, num_debug_keys);
-	if (!debug) {
+	massifg_debug_flags = g_parse_debug_string(debug_string, debug_keys, num_debug_keys);
+	if (!massifg_debug_flags) {
 		g_log_set_handler(NULL, G_LOG_LEVEL_DEBUG, massifg_utils_log_ignore, NULL); 
 	}
 }
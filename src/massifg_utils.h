@@ -22,7 +22,43 @@
 #ifndef MASSIFG_UTILS_H__
 #define MASSIFG_UTILS_H__
 
-gchar *massifg_utils_get_resource_file(const gchar *filename);
+/**
+ * MassifgDebugFlags:
+ * @MASSIFG_DEBUG_PARSER: Debug output of the parser, for every line and heap tree node
+ * @MASSIFG_DEBUG_GRAPH: Debug output of the graph
+ * @MASSIFG_DEBUG_UI: Debug output of the user interface
+ *
+ * Categories of debug output, enabled by listing them in the environment
+ * variable MASSIFG_DEBUG, see massifg_utils_configure_debug_output().
+ */
+typedef enum {
+	MASSIFG_DEBUG_PARSER = 1 << 0,
+	MASSIFG_DEBUG_GRAPH = 1 << 1,
+	MASSIFG_DEBUG_UI = 1 << 2
+} MassifgDebugFlags;
+
+extern guint massifg_debug_flags;
+
+/**
+ * MASSIFG_NOTE:
+ * @category: The category, PARSER, GRAPH or UI
+ * @action: Statement to run if debug output is enabled for @category,
+ * usually a g_debug() call
+ *
+ * Run @action only when the debug output of @category is enabled. The arguments
+ * are not evaluated otherwise, so this costs one test of a global flag.
+ * When configured with --disable-debug-notes, @action is not compiled in at all.
+ * Files using this must include config.h first.
+ */
+#ifdef MASSIFG_DISABLE_DEBUG_NOTES
+#define MASSIFG_NOTE(category, action) G_STMT_START { } G_STMT_END
+#else
+#define MASSIFG_NOTE(category, action) G_STMT_START { \
+	if (G_UNLIKELY(massifg_debug_flags & MASSIFG_DEBUG_##category)) \
+		{ action; } \
+} G_STMT_END
+#endif
+
 void massifg_utils_log_ignore(const gchar *log_domain, GLogLevelFlags log_level,
 			const gchar *message,
 			gpointer user_data);
@@ -31,6 +67,6 @@ void massifg_utils_configure_debug_output(void);
 
 gchar *massifg_str_cut_region(const gchar *src, const guint cut_start, const guint cut_end);
 guint massifg_str_count_char(const gchar *str, gchar c);
-gchar *massifg_str_copy_region(gchar *src, gint start_idx, gint stop_idx);
+gchar *massifg_str_copy_region(const gchar *src, guint start_idx, guint stop_idx);
 
 #endif /* MASSIFG_UTILS_H__ */
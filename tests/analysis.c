@@ -0,0 +1,394 @@
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <massifg_analysis.h>
+#include <massifg_parser.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+void
+analysis_find_leaks(void) {
+	MassifgOutputData *data;
+	MassifgLeakSite *site, *prev = NULL;
+	GList *leak_sites, *l;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	leak_sites = massifg_analysis_find_leaks(data, 10);
+	g_assert_cmpint(g_list_length(leak_sites), ==, 10);
+
+	for (l = leak_sites; l; l = l->next) {
+		site = (MassifgLeakSite *)l->data;
+		g_assert(site->label != NULL);
+		g_assert_cmpfloat(site->slope, >, 0);
+		g_assert_cmpfloat(site->r_squared, >=, 0);
+		g_assert_cmpfloat(site->r_squared, <=, 1.0 + 1e-9);
+		g_assert_cmpint(site->peak_mem_B, >=, site->last_mem_B);
+
+		/* Ranked with the most likely leak first */
+		if (prev) {
+			g_assert_cmpfloat(prev->slope*prev->r_squared, >=, site->slope*site->r_squared);
+		}
+		prev = site;
+	}
+	massifg_analysis_leaks_free(leak_sites);
+
+	g_assert(massifg_analysis_find_leaks(data, 0) == NULL);
+	massifg_output_data_unref(data);
+}
+
+/* Label of the first child of the root in the output of the generator, which
+ * always gets the largest share of the heap, and so leaks the most */
+#define GENERATED_LEAK_LABEL "0x00400010: function_1 (file_1.c:2)"
+
+/* Fit a straight line to the memory usage under the children of the roots
+ * with the given label, over the time since the first detailed snapshot */
+static void
+fit_site(MassifgOutputData *data, const gchar *label, gdouble *slope, gdouble *r_squared) {
+	GArray *xs = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	GArray *ys = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	MassifgSnapshot *s = NULL;
+	MassifgHeapTreeNode *n = NULL;
+	GNode *child = NULL;
+	GList *l = NULL;
+	gdouble mean_x = 0, mean_y = 0, sxx = 0, syy = 0, sxy = 0;
+	gdouble x, y;
+	gint64 first_time = -1;
+	guint i;
+
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (!s->heap_tree)
+			continue;
+		if (first_time < 0)
+			first_time = s->time;
+
+		x = (gdouble)(s->time - first_time);
+		y = 0;
+		for (child = s->heap_tree->children; child; child = child->next) {
+			n = (MassifgHeapTreeNode *)child->data;
+			if (strcmp(n->label->str, label) == 0)
+				y += n->total_mem_B;
+		}
+		g_array_append_val(xs, x);
+		g_array_append_val(ys, y);
+		mean_x += x;
+		mean_y += y;
+	}
+	mean_x /= xs->len;
+	mean_y /= ys->len;
+
+	for (i=0; i<xs->len; i++) {
+		x = g_array_index(xs, gdouble, i) - mean_x;
+		y = g_array_index(ys, gdouble, i) - mean_y;
+		sxx += x*x;
+		syy += y*y;
+		sxy += x*y;
+	}
+	*slope = sxy/sxx;
+	*r_squared = sxy*sxy/(sxx*syy);
+
+	g_array_free(xs, TRUE);
+	g_array_free(ys, TRUE);
+}
+
+/* A site that is known to leak ranks first, with the same line as a direct fit */
+void
+analysis_find_leaks_generated(void) {
+	MassifgOutputData *data;
+	MassifgParser *parser;
+	MassifgLeakSite *site;
+	GList *leak_sites;
+	gchar *output = NULL;
+	gdouble slope, r_squared;
+	gint exit_status;
+	gchar *argv[] = {TEST_GENERATOR, "--snapshots=200", "--detailed-freq=2", "--depth=1",
+			"--fanout=3", "--labels=1000", "--growth=leak", "--seed=7", NULL};
+
+	g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, &output, NULL, &exit_status, NULL));
+	g_assert_cmpint(exit_status, ==, 0);
+
+	parser = massifg_parser_new(NULL);
+	massifg_parser_feed(parser, output, -1);
+	data = massifg_parser_finish(parser, NULL);
+	massifg_parser_free(parser);
+	g_free(output);
+	g_assert(data != NULL);
+
+	leak_sites = massifg_analysis_find_leaks(data, 3);
+	g_assert(leak_sites != NULL);
+	site = (MassifgLeakSite *)leak_sites->data;
+	g_assert_cmpstr(site->label, ==, GENERATED_LEAK_LABEL);
+
+	fit_site(data, GENERATED_LEAK_LABEL, &slope, &r_squared);
+	g_assert_cmpfloat(slope, >, 0);
+	g_assert_cmpfloat(ABS(site->slope - slope), <=, 1e-6*slope);
+	g_assert_cmpfloat(ABS(site->r_squared - r_squared), <=, 1e-6);
+
+	massifg_analysis_leaks_free(leak_sites);
+	massifg_output_data_unref(data);
+}
+
+/* Check that the memory of each node is its own plus that of its callers */
+static void
+check_inverted_node(MassifgInvertedNode *node) {
+	GList *callers = massifg_inverted_node_get_callers(node);
+	GList *l;
+	gint64 callers_B = 0;
+	gint64 prev_B = G_MAXINT64;
+
+	for (l = callers; l; l = l->next) {
+		MassifgInvertedNode *caller = (MassifgInvertedNode *)l->data;
+		g_assert_cmpint(caller->inclusive_B, <=, prev_B);
+		prev_B = caller->inclusive_B;
+
+		callers_B += caller->inclusive_B;
+		check_inverted_node(caller);
+	}
+	g_assert_cmpint(node->exclusive_B, >=, 0);
+	g_assert_cmpint(node->inclusive_B, ==, node->exclusive_B + callers_B);
+	g_list_free(callers);
+}
+
+/* Check that two inverted trees have the same frames and memory usage */
+static void
+check_inverted_nodes_equal(MassifgInvertedNode *a, MassifgInvertedNode *b) {
+	GList *callers = massifg_inverted_node_get_callers(a);
+	GList *l;
+
+	g_assert_cmpuint(a->frame_id, ==, b->frame_id);
+	g_assert_cmpstr(a->frame, ==, b->frame);
+	g_assert_cmpint(a->inclusive_B, ==, b->inclusive_B);
+	g_assert_cmpint(a->exclusive_B, ==, b->exclusive_B);
+	g_assert_cmpint(a->callers ? g_hash_table_size(a->callers) : 0, ==,
+			b->callers ? g_hash_table_size(b->callers) : 0);
+
+	for (l = callers; l; l = l->next) {
+		MassifgInvertedNode *caller = (MassifgInvertedNode *)l->data;
+		check_inverted_nodes_equal(caller,
+			(MassifgInvertedNode *)g_hash_table_lookup(b->callers, GUINT_TO_POINTER(caller->frame_id)));
+	}
+	g_list_free(callers);
+}
+
+/* Find the caller of an inverted node with the given frame */
+static MassifgInvertedNode *
+find_inverted_caller(MassifgInvertedNode *node, const gchar *frame) {
+	GHashTableIter iter;
+	MassifgInvertedNode *caller = NULL;
+
+	g_hash_table_iter_init(&iter, node->callers);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&caller)) {
+		if (strcmp(caller->frame, frame) == 0)
+			return caller;
+	}
+	return NULL;
+}
+
+void
+analysis_inverted_trees(void) {
+	MassifgOutputData *data;
+	MassifgInvertedTrees *trees, *serial_trees;
+	MassifgInvertedNode *root, *node;
+	GList *callers, *l;
+	guint i;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	trees = massifg_analysis_build_inverted_trees(data, 4);
+	g_assert_cmpint(trees->snapshot_trees->len, ==, g_list_length(data->snapshots));
+
+	for (i=0; i<trees->snapshot_trees->len; i++) {
+		root = (MassifgInvertedNode *)g_ptr_array_index(trees->snapshot_trees, i);
+		g_assert(root != NULL);
+		g_assert(root->frame == NULL);
+		g_assert_cmpuint(root->frame_id, ==, MASSIFG_LABEL_NONE);
+
+		callers = massifg_inverted_node_get_callers(root);
+		for (l = callers; l; l = l->next) {
+			node = (MassifgInvertedNode *)l->data;
+			g_assert(!g_str_has_prefix(node->frame, "0x"));
+			g_assert(g_str_has_suffix(massifg_label_table_get(data->labels, node->frame_id)->str, node->frame));
+			check_inverted_node(node);
+		}
+		g_list_free(callers);
+	}
+
+	/* A helper which is reached from many callers */
+	node = find_inverted_caller(trees->merged, "g_malloc0 (gmem.c:151)");
+	g_assert(node != NULL);
+	g_assert_cmpint(g_hash_table_size(node->callers), >, 1);
+	check_inverted_node(node);
+
+	/* Building with a single thread gives the same result */
+	serial_trees = massifg_analysis_build_inverted_trees(data, 1);
+	check_inverted_nodes_equal(trees->merged, serial_trees->merged);
+
+	massifg_analysis_inverted_trees_free(serial_trees);
+	massifg_analysis_inverted_trees_free(trees);
+	massifg_output_data_unref(data);
+}
+
+void
+analysis_group_usage(void) {
+	MassifgOutputData *data;
+	MassifgGroupedUsage *usage, *by_function;
+	MassifgGroupBy group_by;
+	MassifgSnapshot *s;
+	GNode *child;
+	GList *l;
+	gdouble sum;
+	guint i, j;
+	gboolean found_std = FALSE;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	by_function = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	for (group_by=MASSIFG_GROUP_BY_FUNCTION; group_by<MASSIFG_GROUP_BY_LAST; group_by++) {
+		usage = massifg_analysis_group_usage(data, group_by, NULL);
+		g_assert_cmpuint(usage->num_snapshots, ==, g_list_length(data->snapshots));
+		g_assert_cmpuint(usage->names->len, ==, usage->series->len);
+		g_assert_cmpuint(usage->series->len, <=, by_function->series->len);
+
+		/* Every grouping accounts for all of the memory of the allocation sites */
+		for (l = data->snapshots, i = 0; l; l = l->next, i++) {
+			s = (MassifgSnapshot *)l->data;
+			sum = 0;
+			for (child = s->heap_tree ? s->heap_tree->children : NULL; child; child = child->next) {
+				sum += ((MassifgHeapTreeNode *)child->data)->total_mem_B;
+			}
+			for (j=0; j<usage->series->len; j++) {
+				sum -= ((gdouble *)g_ptr_array_index(usage->series, j))[i];
+			}
+			g_assert_cmpfloat(sum, ==, 0);
+		}
+
+		if (group_by == MASSIFG_GROUP_BY_NAMESPACE) {
+			for (j=0; j<usage->names->len; j++) {
+				found_std |= !g_strcmp0(g_ptr_array_index(usage->names, j), "std");
+			}
+		}
+		massifg_analysis_grouped_usage_free(usage);
+	}
+	g_assert(found_std);
+	massifg_analysis_grouped_usage_free(by_function);
+
+	massifg_output_data_unref(data);
+}
+
+void
+analysis_compare_peaks(void) {
+	const gchar *filenames[3] = { NULL, NULL, NULL };
+	GPtrArray *datasets;
+	MassifgOutputData *long_data, *short_data;
+	MassifgFunctionDelta *delta, *prev = NULL;
+	GList *deltas, *l;
+
+	filenames[0] = get_test_file(TEST_INPUT_LONG);
+	filenames[1] = get_test_file(TEST_INPUT_SHORT);
+	datasets = massifg_parse_files(filenames, NULL);
+	g_free((gchar *)filenames[0]);
+	g_free((gchar *)filenames[1]);
+	g_assert(datasets != NULL);
+	long_data = (MassifgOutputData *)g_ptr_array_index(datasets, 0);
+	short_data = (MassifgOutputData *)g_ptr_array_index(datasets, 1);
+
+	/* Comparing an output with itself changes nothing */
+	deltas = massifg_analysis_compare_peaks(long_data, long_data);
+	g_assert(deltas != NULL);
+	for (l = deltas; l; l = l->next) {
+		delta = (MassifgFunctionDelta *)l->data;
+		g_assert_cmpint(delta->before_B, ==, delta->after_B);
+		g_assert_cmpint(delta->delta_B, ==, 0);
+	}
+	massifg_analysis_deltas_free(deltas);
+
+	/* Ranked with the largest change first */
+	deltas = massifg_analysis_compare_peaks(long_data, short_data);
+	g_assert(deltas != NULL);
+	for (l = deltas; l; l = l->next) {
+		delta = (MassifgFunctionDelta *)l->data;
+		g_assert(delta->function != NULL);
+		g_assert_cmpint(delta->delta_B, ==, delta->after_B - delta->before_B);
+		if (prev) {
+			g_assert_cmpint(ABS(prev->delta_B), >=, ABS(delta->delta_B));
+		}
+		prev = delta;
+	}
+	massifg_analysis_deltas_free(deltas);
+
+	g_ptr_array_free(datasets, TRUE);
+}
+
+#define SHARED_DATA_THREADS 4
+
+/* Group the usage of the data, then release the reference the thread was given */
+static gpointer
+shared_data_thread(gpointer user_data) {
+	MassifgOutputData *data = (MassifgOutputData *)user_data;
+	MassifgGroupedUsage *usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+
+	massifg_output_data_unref(data);
+	return usage;
+}
+
+/* Threads analyze the same data at once, each holding a reference,
+ * and the last one to finish frees it */
+void
+analysis_shared_data(void) {
+	MassifgOutputData *data;
+	MassifgGroupedUsage *expected, *usage;
+	GThread *threads[SHARED_DATA_THREADS];
+	guint i, j;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+	expected = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+
+	for (i=0; i<SHARED_DATA_THREADS; i++) {
+		threads[i] = g_thread_create(shared_data_thread, massifg_output_data_ref(data), TRUE, NULL);
+		g_assert(threads[i] != NULL);
+	}
+	massifg_output_data_unref(data);
+
+	for (i=0; i<SHARED_DATA_THREADS; i++) {
+		usage = (MassifgGroupedUsage *)g_thread_join(threads[i]);
+		g_assert_cmpuint(usage->num_snapshots, ==, expected->num_snapshots);
+		g_assert_cmpuint(usage->names->len, ==, expected->names->len);
+		for (j=0; j<usage->names->len; j++) {
+			g_assert_cmpstr(g_ptr_array_index(usage->names, j), ==,
+					g_ptr_array_index(expected->names, j));
+			g_assert(memcmp(g_ptr_array_index(usage->series, j), g_ptr_array_index(expected->series, j),
+					usage->num_snapshots*sizeof(gdouble)) == 0);
+		}
+		massifg_analysis_grouped_usage_free(usage);
+	}
+	massifg_analysis_grouped_usage_free(expected);
+}
+
+int
+main (int argc, char **argv) {
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/analysis/find-leaks", analysis_find_leaks);
+	g_test_add_func("/analysis/find-leaks-generated", analysis_find_leaks_generated);
+	g_test_add_func("/analysis/inverted-trees", analysis_inverted_trees);
+	g_test_add_func("/analysis/group-usage", analysis_group_usage);
+	g_test_add_func("/analysis/compare-peaks", analysis_compare_peaks);
+	g_test_add_func("/analysis/shared-data", analysis_shared_data);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
@@ -1,6 +1,9 @@
 
 
+#include <stdio.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <massifg_application.h>
 #include <massifg_gtkui.h>
@@ -84,6 +87,101 @@ disable_details_cb(gpointer data) {
 	return FALSE;
 }
 
+/* How often the follow-file test checks the graph, and how long it waits at most */
+#define FOLLOW_FILE_POLL_INTERVAL_MS 50
+#define FOLLOW_FILE_TIMEOUT_SECONDS 60
+
+/* State of the follow-file test */
+typedef struct {
+	MassifgApplication *app;
+	gchar *contents;
+	gsize length;
+	gchar *path;
+	guint first_half_snapshots; /* Snapshots shown once the first half has been read */
+	gboolean appended;
+} FollowFileTest;
+
+/* Get the number of snapshots the graph shows */
+guint
+follow_file_num_snapshots(FollowFileTest *test) {
+	MassifgOutputData *data = massifg_graph_get_data(test->app->graph);
+
+	return data ? g_list_length(data->snapshots) : 0;
+}
+
+/* Write the first half of the output, and start following the file */
+gboolean
+follow_file_start_cb(gpointer data) {
+	FollowFileTest *test = (FollowFileTest *)data;
+
+	g_assert(g_file_set_contents(test->path, test->contents, test->length/2, NULL));
+	massifg_application_set_follow(test->app, TRUE);
+	g_assert(massifg_application_load_file(test->app, test->path, NULL));
+	return FALSE;
+}
+
+/* Append the second half, as massif would while it is still running */
+void
+follow_file_append(FollowFileTest *test) {
+	FILE *file = NULL;
+
+	file = fopen(test->path, "a");
+	g_assert(file);
+	g_assert_cmpuint(fwrite(test->contents + test->length/2, 1, test->length - test->length/2, file),
+			==, test->length - test->length/2);
+	fclose(file);
+	test->appended = TRUE;
+}
+
+/* Append the second half once the first half is shown, and quit once all the
+ * snapshots are shown */
+gboolean
+follow_file_poll_cb(gpointer data) {
+	FollowFileTest *test = (FollowFileTest *)data;
+	guint num_snapshots = follow_file_num_snapshots(test);
+
+	if (!test->appended) {
+		if (num_snapshots == test->first_half_snapshots) {
+			follow_file_append(test);
+		}
+		return TRUE;
+	}
+	if (num_snapshots < 68) {
+		return TRUE;
+	}
+
+	g_assert_cmpuint(num_snapshots, ==, 68);
+	massifg_application_quit(test->app);
+	return FALSE;
+}
+
+/* The snapshots did not show up in time */
+gboolean
+follow_file_timeout_cb(gpointer data) {
+	FollowFileTest *test = (FollowFileTest *)data;
+
+	g_error("Only %u snapshots shown after %d seconds",
+		follow_file_num_snapshots(test), FOLLOW_FILE_TIMEOUT_SECONDS);
+	return FALSE;
+}
+
+/* State of the startup benchmark */
+typedef struct {
+	MassifgApplication *app;
+	GTimer *timer;
+} StartupTest;
+
+/* Runs once the main window has been drawn */
+gboolean
+startup_shown_cb(gpointer data) {
+	StartupTest *test = (StartupTest *)data;
+	gdouble elapsed = g_timer_elapsed(test->timer, NULL);
+
+	g_test_minimized_result(elapsed, "Startup time: %.3f seconds", elapsed);
+	massifg_application_quit(test->app);
+	return FALSE;
+}
+
 /* Tests */
 void
 application_start_quit(void) {
@@ -181,6 +279,117 @@ application_toogle_legend(void) {
 
 }
 
+/* Summarizing does not open a window, so run() returns right away */
+void
+application_summary(void) {
+	MassifgApplication *app;
+	int argc = 3;
+	char **argv = g_new(char *, argc+1);
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	argv[0] = "bin/massifg";
+	argv[1] = "--summary";
+	argv[2] = path;
+	argv[3] = NULL;
+
+	/* The options are removed from argv when parsed */
+	app = massifg_application_new(&argc, &argv);
+	g_assert_cmpint(massifg_application_run(app), ==, 0);
+	massifg_application_free(app);
+	g_free(path);
+}
+
+/* Rendering does not open a window either, and writes a file for each input */
+void
+application_render(void) {
+	MassifgApplication *app;
+	int argc = 6;
+	char **argv = g_new(char *, argc+1);
+	gchar *path_long = get_test_file(TEST_INPUT_LONG);
+	gchar *path_800 = get_test_file(TEST_INPUT_800);
+	gchar *output_long = g_strdup_printf("tests/render-%s.png", TEST_INPUT_LONG);
+	gchar *output_800 = g_strdup_printf("tests/render-%s.png", TEST_INPUT_800);
+	argv[0] = "bin/massifg";
+	argv[1] = "--render=tests/render.png";
+	argv[2] = "--size";
+	argv[3] = "640x480";
+	argv[4] = path_long;
+	argv[5] = path_800;
+	argv[6] = NULL;
+
+	app = massifg_application_new(&argc, &argv);
+	g_assert_cmpint(massifg_application_run(app), ==, 0);
+	massifg_application_free(app);
+
+	g_assert(g_file_test(output_long, G_FILE_TEST_IS_REGULAR));
+	g_assert(g_file_test(output_800, G_FILE_TEST_IS_REGULAR));
+	g_unlink(output_long);
+	g_unlink(output_800);
+
+	g_free(output_long);
+	g_free(output_800);
+	g_free(path_long);
+	g_free(path_800);
+}
+
+/* Time from creating the application until the main window is drawn */
+void
+application_startup_time(void) {
+	StartupTest test;
+	int argc = 1;
+	char **argv = g_new(char *, argc);
+	argv[0] = "bin/massifg";
+
+	test.timer = g_timer_new();
+	test.app = massifg_application_new(&argc, &argv);
+	/* Lower priority than redrawing */
+	g_idle_add_full(G_PRIORITY_LOW, startup_shown_cb, &test, NULL);
+
+	massifg_application_run(test.app);
+
+	massifg_application_free(test.app);
+	g_timer_destroy(test.timer);
+	g_usleep(G_USEC_PER_SEC*1);
+}
+
+/* Snapshots written to a followed file are picked up */
+void
+application_follow_file(void) {
+	FollowFileTest test;
+	MassifgParser *parser = NULL;
+	guint timeout_id;
+	int argc = 1;
+	char **argv = g_new(char *, argc);
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	argv[0] = "bin/massifg";
+
+	g_assert(g_file_get_contents(path, &test.contents, &test.length, NULL));
+	test.path = g_strdup("tests/follow.out");
+	test.appended = FALSE;
+
+	/* The loader parses the same way, so it shows as many snapshots once it has read the first half */
+	parser = massifg_parser_new(NULL);
+	massifg_parser_feed(parser, test.contents, test.length/2);
+	test.first_half_snapshots = g_list_length(massifg_parser_get_output_data(parser)->snapshots);
+	massifg_parser_free(parser);
+	g_assert_cmpuint(test.first_half_snapshots, >, 0);
+	g_assert_cmpuint(test.first_half_snapshots, <, 68);
+
+	test.app = massifg_application_new(&argc, &argv);
+	g_idle_add(follow_file_start_cb, &test);
+	g_timeout_add(FOLLOW_FILE_POLL_INTERVAL_MS, follow_file_poll_cb, &test);
+	timeout_id = g_timeout_add_seconds(FOLLOW_FILE_TIMEOUT_SECONDS, follow_file_timeout_cb, &test);
+
+	massifg_application_run(test.app);
+	g_source_remove(timeout_id);
+
+	massifg_application_free(test.app);
+	g_unlink(test.path);
+	g_free(test.path);
+	g_free(test.contents);
+	g_free(path);
+	g_usleep(G_USEC_PER_SEC*1);
+}
+
 int
 main (int argc, char **argv) {
 /*	g_mem_set_vtable(glib_mem_profiler_table);
@@ -193,12 +402,19 @@ main (int argc, char **argv) {
 
 	g_test_add_func("/application/start-quit", application_start_quit);
 	g_test_add_func("/application/start-open-file", application_start_open_file);
+	g_test_add_func("/application/summary", application_summary);
+	g_test_add_func("/application/render", application_render);
 
 	g_test_add_func("/application/open-many-files", application_open_many_files);
+	g_test_add_func("/application/follow-file", application_follow_file);
 
 	g_test_add_func("/application/toggle-details", application_toogle_detailed_view);
 	g_test_add_func("/application/toggle-legend", application_toogle_legend);
 
+	if (g_test_perf()) {
+		g_test_add_func("/application/startup-time", application_startup_time);
+	}
+
 
 	massifg_utils_configure_debug_output();
 	return g_test_run();
@@ -0,0 +1,430 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "config.h"
+
+#include <massifg_parser.h>
+#include <massifg_analysis.h>
+#include <massifg_graph.h>
+#include <massifg_trace.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* Upper bound for the memory the parsed data of the huge input may use
+ * for each node in the file, to catch regressions in the data structures */
+#define MAX_DATA_B_PER_NODE 150.0
+
+/* Benchmarks, only run with -m perf. Use make perf-report to collect the results
+ * The huge input is written by TEST_GENERATOR, about 60 MB, or 480 MB with -m slow */
+#define HUGE_INPUT_PATH "tests/benchmark-huge.out"
+#define HUGE_INPUT_SNAPSHOTS 1000
+#define HUGE_INPUT_SNAPSHOTS_SLOW 8000
+#define RENDER_OUTPUT_PATH "tests/benchmark-render.png"
+
+/* Memory budget for the heap trees in /benchmark/memory-budget */
+#define MEMORY_BUDGET_B (16*1024*1024)
+
+/* Threads to compare with a single thread in /benchmark/inverted-trees */
+#define INVERTED_TREES_THREADS 4
+
+typedef struct {
+	const gchar *name;
+	const gchar *filename; /* In the tests directory, or NULL for the huge input */
+} BenchmarkInput;
+
+static const BenchmarkInput inputs[] = {
+	{"small", TEST_INPUT_800},
+	{"medium", TEST_INPUT_LONG},
+	{"huge", NULL},
+};
+
+/* Write the huge input with the generator, with a heap tree in every snapshot */
+static void
+write_huge_input(guint num_snapshots) {
+	gchar *snapshots_arg = g_strdup_printf("--snapshots=%u", num_snapshots);
+	gchar *argv[] = {TEST_GENERATOR, snapshots_arg, "--detailed-freq=1", "--depth=6",
+			"--fanout=3", "--labels=5000", "--growth=leak", "--output=" HUGE_INPUT_PATH, NULL};
+	gint exit_status;
+
+	g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, NULL, NULL, &exit_status, NULL));
+	g_assert_cmpint(exit_status, ==, 0);
+	g_free(snapshots_arg);
+}
+
+/* Get the path to an input, generating the huge input the first time it is needed */
+static gchar *
+get_input_path(const BenchmarkInput *input) {
+	if (input->filename)
+		return get_test_file(input->filename);
+
+	if (!g_file_test(HUGE_INPUT_PATH, G_FILE_TEST_IS_REGULAR)) {
+		write_huge_input(g_test_slow() ? HUGE_INPUT_SNAPSHOTS_SLOW : HUGE_INPUT_SNAPSHOTS);
+	}
+	return g_strdup(HUGE_INPUT_PATH);
+}
+
+static gdouble
+get_file_size_MB(const gchar *path) {
+	struct stat buf;
+
+	g_assert(g_stat(path, &buf) == 0);
+	return buf.st_size/(1024.0*1024.0);
+}
+
+/* Start measuring the peak resident set size from the current one.
+ * Only Linux supports this, elsewhere the peak of the process is measured */
+static void
+reset_peak_rss(void) {
+	FILE *file = fopen("/proc/self/clear_refs", "w");
+
+	if (file) {
+		fputs("5", file);
+		fclose(file);
+	}
+}
+
+static void
+report_peak_rss(void) {
+	guint64 peak = get_proc_status_KiB("VmHWM");
+
+	if (peak)
+		g_test_minimized_result(peak, "Peak RSS %" G_GUINT64_FORMAT " KiB", peak);
+}
+
+/* Count the heap tree nodes of all snapshots, as written in the file */
+static guint64
+count_nodes(GNode *node) {
+	guint64 count = 1;
+
+	for (node = node->children; node; node = node->next) {
+		count += count_nodes(node);
+	}
+	return count;
+}
+
+static guint64
+count_all_nodes(MassifgOutputData *data) {
+	MassifgSnapshot *snapshot = NULL;
+	guint64 count = 0;
+	GList *l = NULL;
+
+	for (l = data->snapshots; l; l = l->next) {
+		snapshot = (MassifgSnapshot *)l->data;
+		if (snapshot->heap_tree)
+			count += count_nodes(snapshot->heap_tree);
+	}
+	return count;
+}
+
+static MassifgOutputData *
+parse_input(const BenchmarkInput *input) {
+	gchar *path = get_input_path(input);
+	MassifgOutputData *data = massifg_parse_file(path, NULL);
+
+	g_assert(data);
+	g_free(path);
+	return data;
+}
+
+/* Benchmarks */
+
+/* Parse throughput, including building the heap trees */
+void
+benchmark_parse(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	gchar *path = get_input_path(input);
+	MassifgOutputData *data = NULL;
+	MassifgMemoryStats stats;
+	gdouble size_MB = get_file_size_MB(path);
+	gdouble elapsed, B_per_node;
+	guint64 num_nodes;
+
+	reset_peak_rss();
+	g_test_timer_start();
+	data = massifg_parse_file(path, NULL);
+	elapsed = g_test_timer_elapsed();
+	g_assert(data);
+
+	num_nodes = count_all_nodes(data);
+	g_test_message("Parsed %.1f MB with %" G_GUINT64_FORMAT " nodes in %.3f s",
+			size_MB, num_nodes, elapsed);
+	g_test_maximized_result(size_MB/elapsed, "Parsed %.1f MB/s", size_MB/elapsed);
+	g_test_maximized_result(num_nodes/elapsed, "Built %.0f nodes/s", num_nodes/elapsed);
+	report_peak_rss();
+
+	/* Catch regressions in the memory the data uses */
+	massifg_output_data_get_memory_stats(data, &stats);
+	B_per_node = (gdouble)stats.total_B/MAX(stats.num_node_refs, 1);
+	g_test_minimized_result(stats.total_B, "Data uses %" G_GUINT64_FORMAT " bytes, %.1f per node",
+			stats.total_B, B_per_node);
+	if (!input->filename) {
+		g_assert_cmpfloat(B_per_node, <, MAX_DATA_B_PER_NODE);
+	}
+
+	massifg_output_data_unref(data);
+	g_free(path);
+}
+
+/* Parsing with the debug output of the parser disabled, and enabled but ignored,
+ * which is what every parse cost before the debug output had categories.
+ * Configured with --disable-debug-notes, both cost the same */
+void
+benchmark_debug_notes(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	gchar *path = get_input_path(input);
+	guint saved_flags = massifg_debug_flags;
+	gdouble elapsed[2];
+	gboolean enabled;
+	guint handler_id;
+
+	handler_id = g_log_set_handler(NULL, G_LOG_LEVEL_DEBUG, massifg_utils_log_ignore, NULL);
+	for (enabled=FALSE; enabled<=TRUE; enabled++) {
+		massifg_debug_flags = enabled ? MASSIFG_DEBUG_PARSER : 0;
+		g_test_timer_start();
+		massifg_output_data_unref(massifg_parse_file(path, NULL));
+		elapsed[enabled] = g_test_timer_elapsed();
+		g_test_minimized_result(elapsed[enabled], "Parsed with debug output %s in %.3f s",
+				enabled ? "enabled and ignored" : "disabled", elapsed[enabled]);
+	}
+	massifg_debug_flags = saved_flags;
+	g_log_remove_handler(NULL, handler_id);
+
+#ifdef MASSIFG_DISABLE_DEBUG_NOTES
+	g_test_message("Debug output is compiled out");
+#endif
+	g_test_message("Ignored debug output makes parsing %.1f times slower", elapsed[TRUE]/elapsed[FALSE]);
+	g_free(path);
+}
+
+/* Parsing with a memory budget, and then summing the heap usage of the allocation
+ * sites, which reads every spilled heap tree back */
+void
+benchmark_memory_budget(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	gchar *path = get_input_path(input);
+	MassifgOutputData *data = NULL;
+	MassifgGroupedUsage *usage = NULL;
+	MassifgMemoryStats stats;
+	gdouble elapsed;
+
+	massifg_parser_set_default_memory_budget(MEMORY_BUDGET_B);
+	reset_peak_rss();
+	g_test_timer_start();
+	data = massifg_parse_file(path, NULL);
+	elapsed = g_test_timer_elapsed();
+	massifg_parser_set_default_memory_budget(0);
+	g_assert(data);
+	g_assert_cmpuint(data->heap_trees_B, <=, MEMORY_BUDGET_B);
+
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_test_minimized_result(elapsed, "Parsed within the budget in %.3f s, %" G_GUINT64_FORMAT
+			" heap trees spilled to %" G_GUINT64_FORMAT " bytes",
+			elapsed, stats.num_spilled_trees, stats.spill_file_B);
+	report_peak_rss();
+
+	g_test_timer_start();
+	usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Grouped the usage within the budget in %.3f s", elapsed);
+	g_assert_cmpuint(data->heap_trees_B, <=, MEMORY_BUDGET_B);
+
+	massifg_analysis_grouped_usage_free(usage);
+	massifg_output_data_unref(data);
+	g_free(path);
+}
+
+/* Summing the heap usage of the allocation sites, for the detailed view */
+void
+benchmark_detailed_table(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	MassifgOutputData *data = parse_input(input);
+	MassifgGroupedUsage *usage = NULL;
+	MassifgGroupBy group_by;
+	gdouble elapsed;
+	guint64 num_sites = 0;
+	GList *l = NULL;
+
+	for (l = data->snapshots; l; l = l->next) {
+		if (((MassifgSnapshot *)l->data)->heap_tree)
+			num_sites += g_node_n_children(((MassifgSnapshot *)l->data)->heap_tree);
+	}
+
+	for (group_by=0; group_by<MASSIFG_GROUP_BY_LAST; group_by++) {
+		reset_peak_rss();
+		g_test_timer_start();
+		usage = massifg_analysis_group_usage(data, group_by, NULL);
+		elapsed = g_test_timer_elapsed();
+		g_test_message("Grouped %" G_GUINT64_FORMAT " allocation sites into %u groups in %.3f s",
+				num_sites, usage->names->len, elapsed);
+		g_test_maximized_result(num_sites/elapsed, "Grouped %.0f nodes/s", num_sites/elapsed);
+		report_peak_rss();
+		massifg_analysis_grouped_usage_free(usage);
+	}
+
+	massifg_output_data_unref(data);
+}
+
+/* Building the union tree while parsing, and summing the detailed table
+ * from it instead of from the heap trees */
+void
+benchmark_union_tree(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	gchar *path = get_input_path(input);
+	MassifgOutputData *data = NULL;
+	MassifgGroupedUsage *usage = NULL;
+	MassifgMemoryStats stats;
+	gdouble elapsed;
+
+	massifg_parser_set_default_build_union_tree(TRUE);
+	reset_peak_rss();
+	g_test_timer_start();
+	data = massifg_parse_file(path, NULL);
+	elapsed = g_test_timer_elapsed();
+	massifg_parser_set_default_build_union_tree(FALSE);
+	g_assert(data && data->union_tree);
+
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_test_minimized_result(elapsed, "Parsed with the union tree in %.3f s, %" G_GUINT64_FORMAT
+			" call paths with %" G_GUINT64_FORMAT " values in %" G_GUINT64_FORMAT " bytes",
+			elapsed, stats.num_union_nodes, data->union_tree->num_values, stats.union_tree_B);
+	report_peak_rss();
+
+	g_test_timer_start();
+	usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Grouped the usage from the union tree in %.6f s", elapsed);
+
+	massifg_analysis_grouped_usage_free(usage);
+	massifg_output_data_unref(data);
+	g_free(path);
+}
+
+/* Building the inverted call trees with a single thread, and with several */
+void
+benchmark_inverted_trees(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	MassifgOutputData *data = parse_input(input);
+	MassifgInvertedTrees *trees = NULL;
+	guint64 num_nodes = count_all_nodes(data);
+	gdouble elapsed[2];
+	guint num_threads[2] = {1, INVERTED_TREES_THREADS};
+	guint i;
+
+	for (i=0; i<G_N_ELEMENTS(num_threads); i++) {
+		g_test_timer_start();
+		trees = massifg_analysis_build_inverted_trees(data, num_threads[i]);
+		elapsed[i] = g_test_timer_elapsed();
+		g_test_maximized_result(num_nodes/elapsed[i], "Inverted %.0f nodes/s with %u threads",
+				num_nodes/elapsed[i], num_threads[i]);
+		massifg_analysis_inverted_trees_free(trees);
+	}
+	g_test_maximized_result(elapsed[0]/elapsed[1], "%u threads are %.2f times as fast as one",
+			INVERTED_TREES_THREADS, elapsed[0]/elapsed[1]);
+
+	massifg_output_data_unref(data);
+}
+
+/* Creating the data series of the simple and the detailed view */
+void
+benchmark_series(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	MassifgOutputData *data = parse_input(input);
+	MassifgGraph *graph = massifg_graph_new();
+	guint num_snapshots = g_list_length(data->snapshots);
+	gdouble elapsed;
+
+	reset_peak_rss();
+	g_test_timer_start();
+	massifg_graph_set_data(graph, data);
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Simple series of %u snapshots in %.6f s", num_snapshots, elapsed);
+
+	g_test_timer_start();
+	massifg_graph_set_show_details(graph, TRUE);
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Detailed series of %u snapshots in %.6f s", num_snapshots, elapsed);
+	report_peak_rss();
+
+	massifg_graph_free(graph);
+	massifg_output_data_unref(data);
+}
+
+/* Rendering the simple and the detailed view to a PNG file */
+void
+benchmark_render(gconstpointer user_data) {
+	const BenchmarkInput *input = (const BenchmarkInput *)user_data;
+	MassifgOutputData *data = parse_input(input);
+	MassifgGraph *graph = massifg_graph_new();
+	gboolean detailed;
+	gdouble elapsed;
+
+	massifg_graph_set_data(graph, data);
+
+	for (detailed=FALSE; detailed<=TRUE; detailed++) {
+		massifg_graph_set_show_details(graph, detailed);
+		reset_peak_rss();
+		g_test_timer_start();
+		g_assert(massifg_graph_render_to_png(graph, RENDER_OUTPUT_PATH, 1600, 1200));
+		elapsed = g_test_timer_elapsed();
+		g_test_minimized_result(elapsed, "Rendered %s view in %.3f s",
+				detailed ? "detailed" : "simple", elapsed);
+		report_peak_rss();
+		g_unlink(RENDER_OUTPUT_PATH);
+	}
+
+	massifg_graph_free(graph);
+	massifg_output_data_unref(data);
+}
+
+int
+main (int argc, char **argv) {
+	gchar *test_path = NULL;
+	guint i;
+	gint retval;
+
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+	g_test_init(&argc, &argv, NULL);
+
+	if (g_test_perf()) {
+		for (i=0; i<G_N_ELEMENTS(inputs); i++) {
+			test_path = g_strdup_printf("/benchmark/parse/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_parse);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/debug-notes/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_debug_notes);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/memory-budget/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_memory_budget);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/detailed-table/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_detailed_table);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/union-tree/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_union_tree);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/inverted-trees/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_inverted_trees);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/series/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_series);
+			g_free(test_path);
+			test_path = g_strdup_printf("/benchmark/render/%s", inputs[i].name);
+			g_test_add_data_func(test_path, &inputs[i], benchmark_render);
+			g_free(test_path);
+		}
+	}
+
+	massifg_utils_configure_debug_output();
+	massifg_trace_init();
+	massifg_graph_init();
+	retval = g_test_run();
+
+	g_unlink(HUGE_INPUT_PATH);
+	return retval;
+}
@@ -1,4 +1,5 @@
 
+#include <string.h>
 
 /* Files that the test suite needs to access
  * A test-case checks that these exists and can be found */
@@ -7,6 +8,9 @@
 #define TEST_INPUT_800 "massif-output-broken-800.txt"
 #define TEST_INPUT_BOGUS "parser.c"
 
+/* Writes synthetic massif output. Built in the build directory by make check */
+#define TEST_GENERATOR "tests/massif-generator"
+
 /* Utility function for finding the test input files. Especially important for distcheck
  * Caller should free return value using g_free () */
 gchar *
@@ -16,3 +20,22 @@ get_test_file(const gchar *filename) {
 	gchar *path = g_build_filename(srcdir, "tests", filename, NULL);
 	return path;
 }
+
+/* A field of /proc/self/status in KiB, such as "VmRSS" for the resident set size,
+ * or 0 if it is not known. Only Linux has it */
+guint64
+get_proc_status_KiB(const gchar *field) {
+	gchar *status = NULL;
+	gchar *line = NULL;
+	gchar *prefix = g_strconcat(field, ":", NULL);
+	guint64 value = 0;
+
+	if (g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+		line = strstr(status, prefix);
+		if (line)
+			value = g_ascii_strtoull(line + strlen(prefix), NULL, 10);
+		g_free(status);
+	}
+	g_free(prefix);
+	return value;
+}
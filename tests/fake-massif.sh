@@ -0,0 +1,22 @@
+#!/bin/sh
+# Stand-in for valgrind in the tests, see massifg_run_spawn().
+# Writes canned massif output to the --massif-out-file in pieces, with delays,
+# like massif does while the program is running
+input="${MASSIFG_FAKE_INPUT:-$top_srcdir/tests/massif-output-glom.txt}"
+pieces=4
+
+for arg; do
+	case "$arg" in
+	--massif-out-file=*) output="${arg#--massif-out-file=}" ;;
+	esac
+done
+test -n "$output" || exit 1
+
+size=`wc -c < "$input"`
+piece_size=`expr $size / $pieces + 1`
+i=0
+while test $i -lt $pieces; do
+	dd if="$input" bs=$piece_size skip=$i count=1 2>/dev/null >> "$output" || exit 1
+	sleep 1
+	i=`expr $i + 1`
+done
@@ -4,18 +4,56 @@
 
 #include <massifg_graph.h>
 #include <massifg_graph_private.h>
+#include <massifg_parser.h>
 #include <massifg_utils.h>
 
 #include "common.h"
 
-void
-test_short_function_label(void) {
-	gchar *str;
-	str = massifg_graph_get_short_function_label("function (type, tupe, type) (in blabla something.so)");
+/* Number of times the soak test shows a file before it measures the
+ * resident set size, and how many times it shows one after that */
+#define SOAK_WARMUP_RELOADS 20
+#define SOAK_RELOADS 300
+/* Allowed growth of the resident set size over SOAK_RELOADS, for the heap
+ * to settle. Leaking more than about 14 KiB for each reload exceeds it */
+#define SOAK_MAX_GROWTH_KiB 4096
+
+/* Show a file in graph, parsed with massifg_parse_file(), or fed a piece
+ * at a time and shown while it is parsed, like massifg_application_load_file() does */
+static void
+soak_show_file(MassifgGraph *graph, const gchar *path, gboolean feed) {
+	const gsize chunk_size = 64*1024;
+	MassifgParser *parser = NULL;
+	MassifgOutputData *data = NULL;
+	gchar *contents = NULL;
+	gboolean shown = FALSE;
+	gsize length, offset;
 
-	str = massifg_graph_get_short_function_label("std::string::_Rep::_S_create(unsigned int, unsigned int, std::allocator<char> const&) (in /usr/lib/libstdc++.so.6.0.13)");
-	g_assert_cmpstr(str, ==, "std::string::_Rep::_S_create (in /usr/lib/libstdc++.so.6.0.13)");
+	if (!feed) {
+		data = massifg_parse_file(path, NULL);
+		massifg_graph_set_data(graph, data);
+		massifg_output_data_unref(data);
+		return;
+	}
 
+	g_assert(g_file_get_contents(path, &contents, &length, NULL));
+	parser = massifg_parser_new(NULL);
+	for (offset = 0; offset < length; offset += chunk_size) {
+		massifg_parser_feed(parser, contents + offset, MIN(chunk_size, length - offset));
+		data = massifg_parser_get_output_data(parser);
+		if (shown) {
+			massifg_graph_append_snapshots(graph);
+		}
+		else if (data->snapshots) {
+			massifg_graph_set_partial_data(graph, data);
+			shown = TRUE;
+		}
+	}
+	/* Adds the rest of the snapshots if the data was shown */
+	data = massifg_parser_finish(parser, NULL);
+	massifg_graph_set_data(graph, data);
+	massifg_output_data_unref(data);
+	massifg_parser_free(parser);
+	g_free(contents);
 }
 
 void
@@ -36,15 +74,121 @@ graph_save_png(void) {
 	g_assert(g_file_test(output_path, G_FILE_TEST_IS_REGULAR));
 
 	g_unlink(output_path);
+	massifg_graph_free(graph);
+	massifg_output_data_unref(data);
+}
+
+/* Render to each supported format, without creating the graph widget */
+void
+graph_render_to_file(void) {
+	MassifgOutputData *data;
+	MassifgGraph *graph;
+	GError *error = NULL;
+	const gchar *output_paths[] = { "tests/graph-render.png", "tests/graph-render.svg",
+			"tests/graph-render.pdf" };
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	guint i;
+
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+	graph = massifg_graph_new();
+	massifg_graph_set_data(graph, data);
+
+	for (i=0; i<G_N_ELEMENTS(output_paths); i++) {
+		g_assert(!g_file_test(output_paths[i], G_FILE_TEST_IS_REGULAR));
+		g_assert(massifg_graph_render_to_file(graph, output_paths[i], 800, 400, &error));
+		g_assert_no_error(error);
+		g_assert(g_file_test(output_paths[i], G_FILE_TEST_IS_REGULAR));
+		g_unlink(output_paths[i]);
+	}
+	g_assert(graph->widget == NULL);
+
+	/* Unknown format */
+	g_assert(!massifg_graph_render_to_file(graph, "tests/graph-render.bmp", 800, 400, &error));
+	g_assert(error != NULL);
+	g_error_free(error);
+
+	massifg_graph_free(graph);
+	massifg_output_data_unref(data);
+}
+
+/* Two graphs show the same data, which lives until the last reference is dropped */
+void
+graph_shared_data(void) {
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	MassifgOutputData *data = massifg_parse_file(path, NULL);
+	MassifgGraph *simple = massifg_graph_new();
+	MassifgGraph *detailed = massifg_graph_new();
+
+	massifg_graph_set_data(simple, data);
+	massifg_graph_set_data(detailed, data);
+	massifg_graph_set_show_details(detailed, TRUE);
+	g_assert_cmpint(data->ref_count, ==, 3);
+
+	/* Setting the same data again keeps one reference */
+	massifg_graph_set_data(simple, data);
+	g_assert_cmpint(data->ref_count, ==, 3);
+
+	massifg_output_data_unref(data);
+	massifg_graph_free(simple);
+	g_assert_cmpint(data->ref_count, ==, 1);
+	g_assert(massifg_graph_get_data(detailed) == data);
+	g_assert(massifg_graph_render_to_png(detailed, "tests/graph-shared.png", 400, 300));
+	g_unlink("tests/graph-shared.png");
+
+	massifg_graph_free(detailed);
+	g_free(path);
+}
+
+/* Show files many times, switching between the views like a long session does,
+ * and check that the resident set size stays flat. All that the parser and the
+ * graph allocate for a file must be freed when the next file is shown */
+void
+graph_reload_soak(void) {
+	const gchar *inputs[] = { TEST_INPUT_LONG, TEST_INPUT_800, TEST_INPUT_SHORT };
+	MassifgGraph *graph = massifg_graph_new();
+	gchar *paths[G_N_ELEMENTS(inputs)];
+	guint64 rss_start = 0, rss_end;
+	guint i;
+
+	for (i=0; i<G_N_ELEMENTS(inputs); i++) {
+		paths[i] = get_test_file(inputs[i]);
+	}
+
+	for (i=0; i<SOAK_WARMUP_RELOADS + SOAK_RELOADS; i++) {
+		if (i == SOAK_WARMUP_RELOADS) {
+			rss_start = get_proc_status_KiB("VmRSS");
+		}
+		soak_show_file(graph, paths[i % G_N_ELEMENTS(paths)], i % 2);
+		massifg_graph_set_show_details(graph, TRUE);
+		massifg_graph_set_group_by(graph, MASSIFG_GROUP_BY_FILE);
+		massifg_graph_set_label_filter(graph, "glom");
+		massifg_graph_set_label_filter(graph, NULL);
+		massifg_graph_set_group_by(graph, MASSIFG_GROUP_BY_FUNCTION);
+		massifg_graph_set_show_details(graph, FALSE);
+	}
+	rss_end = get_proc_status_KiB("VmRSS");
+
+	g_test_message("Resident set size went from %" G_GUINT64_FORMAT " KiB to %" G_GUINT64_FORMAT
+			" KiB over %u reloads", rss_start, rss_end, SOAK_RELOADS);
+	if (rss_start) {
+		g_assert_cmpuint(rss_end, <, rss_start + SOAK_MAX_GROWTH_KiB);
+	}
+
+	for (i=0; i<G_N_ELEMENTS(paths); i++) {
+		g_free(paths[i]);
+	}
+	massifg_graph_free(graph);
 }
 
 int
 main (int argc, char **argv) {
 	g_test_init(&argc, &argv, NULL);
 
-	g_test_add_func("/graph/internal/short-function-label", test_short_function_label);
-
 	g_test_add_func("/graph/render-to-png", graph_save_png);
+	g_test_add_func("/graph/render-to-file", graph_render_to_file);
+	g_test_add_func("/graph/shared-data", graph_shared_data);
+	g_test_add_func("/graph/reload-soak", graph_reload_soak);
 
 	massifg_utils_configure_debug_output();
 	massifg_graph_init();
@@ -0,0 +1,252 @@
+
+
+#include <string.h>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include <massifg_heap_tree_model.h>
+#include <massifg_parser.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* Walk the rows under parent, checking that they are consistent.
+ * Returns the number of rows walked */
+static guint
+walk_rows(GtkTreeModel *model, GtkTreeIter *parent) {
+	GtkTreeIter iter, iter_parent, iter_from_path;
+	GtkTreePath *path = NULL;
+	gint64 parent_bytes, parent_self_bytes, bytes, previous_bytes = G_MAXINT64;
+	gint64 sum = 0;
+	guint num_rows = 0;
+	gint n = 0;
+	gboolean valid;
+
+	gtk_tree_model_get(model, parent, MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES, &parent_bytes,
+		MASSIFG_HEAP_TREE_MODEL_COLUMN_SELF_BYTES, &parent_self_bytes, -1);
+
+	for (valid = gtk_tree_model_iter_children(model, &iter, parent); valid;
+	     valid = gtk_tree_model_iter_next(model, &iter)) {
+		gtk_tree_model_get(model, &iter, MASSIFG_HEAP_TREE_MODEL_COLUMN_BYTES, &bytes, -1);
+
+		/* Sorted by bytes, largest first */
+		g_assert_cmpint(bytes, <=, previous_bytes);
+		previous_bytes = bytes;
+		sum += bytes;
+
+		g_assert(gtk_tree_model_iter_parent(model, &iter_parent, &iter));
+		g_assert(iter_parent.user_data == parent->user_data);
+
+		path = gtk_tree_model_get_path(model, &iter);
+		g_assert(gtk_tree_model_get_iter(model, &iter_from_path, path));
+		g_assert(iter_from_path.user_data == iter.user_data);
+		gtk_tree_path_free(path);
+
+		n++;
+		num_rows += 1 + walk_rows(model, &iter);
+	}
+	g_assert_cmpint(n, ==, gtk_tree_model_iter_n_children(model, parent));
+	g_assert(gtk_tree_model_iter_has_child(model, parent) == (n > 0));
+	g_assert_cmpint(sum, <=, parent_bytes);
+	g_assert_cmpint(parent_self_bytes, ==, parent_bytes - sum);
+	return num_rows;
+}
+
+/* Get the snapshot with the largest heap tree */
+static MassifgSnapshot *
+get_largest_tree(MassifgOutputData *data) {
+	MassifgSnapshot *snapshot, *largest = NULL;
+	GList *l;
+
+	for (l = data->snapshots; l; l = l->next) {
+		snapshot = (MassifgSnapshot *)l->data;
+		if (snapshot->heap_tree && (!largest ||
+		    g_node_n_nodes(snapshot->heap_tree, G_TRAVERSE_ALL) >
+		    g_node_n_nodes(largest->heap_tree, G_TRAVERSE_ALL))) {
+			largest = snapshot;
+		}
+	}
+	return largest;
+}
+
+/* The model has the same rows as the heap tree has nodes */
+void
+heaptreemodel_functest(void) {
+	MassifgOutputData *data;
+	MassifgHeapTreeModel *model;
+	MassifgSnapshot *snapshot;
+	GtkTreeIter root;
+	gchar *label = NULL;
+	gdouble percent;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	snapshot = get_largest_tree(data);
+	model = massifg_heap_tree_model_new(data, snapshot);
+	g_assert_cmpint(gtk_tree_model_get_n_columns(GTK_TREE_MODEL(model)), ==, MASSIFG_HEAP_TREE_MODEL_N_COLUMNS);
+	g_assert_cmpint(gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model), NULL), ==, 1);
+
+	g_assert(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &root));
+	gtk_tree_model_get(GTK_TREE_MODEL(model), &root,
+		MASSIFG_HEAP_TREE_MODEL_COLUMN_LABEL, &label,
+		MASSIFG_HEAP_TREE_MODEL_COLUMN_PERCENT, &percent, -1);
+	g_assert_cmpstr(label, ==, ((MassifgHeapTreeNode *)snapshot->heap_tree->data)->label->str);
+	g_assert_cmpfloat(percent, ==, 100.0);
+	g_assert(!gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &root));
+	g_free(label);
+
+	g_assert(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &root));
+	g_assert_cmpuint(1 + walk_rows(GTK_TREE_MODEL(model), &root), ==,
+		g_node_n_nodes(snapshot->heap_tree, G_TRAVERSE_ALL));
+	g_assert_cmpuint(massifg_heap_tree_model_get_num_rows(model), ==,
+		g_node_n_nodes(snapshot->heap_tree, G_TRAVERSE_ALL));
+
+	g_object_unref(model);
+	massifg_output_data_unref(data);
+}
+
+/* Rows are only created when they are needed */
+void
+heaptreemodel_lazy(void) {
+	MassifgOutputData *data;
+	MassifgHeapTreeModel *model;
+	MassifgSnapshot *snapshot;
+	GtkTreeIter root, child;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	snapshot = get_largest_tree(data);
+	model = massifg_heap_tree_model_new(data, snapshot);
+	g_assert_cmpuint(massifg_heap_tree_model_get_num_rows(model), ==, 1);
+
+	/* Showing the expander does not create the children */
+	g_assert(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &root));
+	g_assert(gtk_tree_model_iter_has_child(GTK_TREE_MODEL(model), &root));
+	g_assert_cmpuint(massifg_heap_tree_model_get_num_rows(model), ==, 1);
+
+	/* Expanding the root creates its children, but not theirs */
+	g_assert(gtk_tree_model_iter_children(GTK_TREE_MODEL(model), &child, &root));
+	g_assert_cmpuint(massifg_heap_tree_model_get_num_rows(model), ==,
+		1 + g_node_n_children(snapshot->heap_tree));
+	g_assert_cmpuint(massifg_heap_tree_model_get_num_rows(model), <,
+		g_node_n_nodes(snapshot->heap_tree, G_TRAVERSE_ALL));
+
+	g_object_unref(model);
+	massifg_output_data_unref(data);
+}
+
+/* Count the nodes that have a label containing str, ignoring case, in their subtree */
+static guint
+count_matching_nodes(GNode *node, const gchar *str, gboolean *matches) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	gchar *folded_label = g_ascii_strdown(n->label->str, -1);
+	gboolean child_matches;
+	guint count = 0;
+
+	*matches = strstr(folded_label, str) != NULL;
+	for (node = node->children; node; node = node->next) {
+		count += count_matching_nodes(node, str, &child_matches);
+		*matches = *matches || child_matches;
+	}
+	g_free(folded_label);
+	return count + (*matches ? 1 : 0);
+}
+
+/* Count the rows under parent, which are all matching rows */
+static guint
+count_filtered_rows(GtkTreeModel *filter, GtkTreeIter *parent) {
+	GtkTreeIter iter, child_iter;
+	GtkTreeModel *model = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(filter));
+	guint num_rows = 0;
+	gboolean valid;
+
+	for (valid = gtk_tree_model_iter_children(filter, &iter, parent); valid;
+	     valid = gtk_tree_model_iter_next(filter, &iter)) {
+		gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(filter), &child_iter, &iter);
+		g_assert(massifg_heap_tree_model_row_matches(model, &child_iter, NULL));
+		num_rows += 1 + count_filtered_rows(filter, &iter);
+	}
+	return num_rows;
+}
+
+/* A filter over the model only shows the rows leading to matching labels */
+void
+heaptreemodel_label_filter(void) {
+	const gchar *filters[] = {"gmem.c", "USTRING", "no such label", ""};
+	MassifgOutputData *data;
+	MassifgHeapTreeModel *model;
+	MassifgSnapshot *snapshot;
+	GtkTreeModel *filter;
+	gboolean matches;
+	gchar *folded;
+	guint i;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	snapshot = get_largest_tree(data);
+	model = massifg_heap_tree_model_new(data, snapshot);
+	filter = gtk_tree_model_filter_new(GTK_TREE_MODEL(model), NULL);
+	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(filter),
+			massifg_heap_tree_model_row_matches, NULL, NULL);
+
+	for (i=0; i<G_N_ELEMENTS(filters); i++) {
+		massifg_heap_tree_model_set_label_filter(model, filters[i]);
+		gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(filter));
+
+		folded = g_ascii_strdown(filters[i], -1);
+		g_assert_cmpuint(count_filtered_rows(filter, NULL), ==,
+				count_matching_nodes(snapshot->heap_tree, folded, &matches));
+		g_free(folded);
+	}
+
+	g_object_unref(filter);
+	g_object_unref(model);
+	massifg_output_data_unref(data);
+}
+
+/* Snapshots without a heap tree give an empty model */
+void
+heaptreemodel_empty(void) {
+	MassifgOutputData *data;
+	MassifgHeapTreeModel *model;
+	MassifgSnapshot *snapshot = NULL;
+	GtkTreeIter iter;
+	GList *l;
+
+	gchar *path = get_test_file(TEST_INPUT_800);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	for (l = data->snapshots; l && !snapshot; l = l->next) {
+		if (!((MassifgSnapshot *)l->data)->heap_tree)
+			snapshot = (MassifgSnapshot *)l->data;
+	}
+	g_assert(snapshot != NULL);
+	model = massifg_heap_tree_model_new(data, snapshot);
+	g_assert_cmpint(gtk_tree_model_iter_n_children(GTK_TREE_MODEL(model), NULL), ==, 0);
+	g_assert(!gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &iter));
+
+	g_object_unref(model);
+	massifg_output_data_unref(data);
+}
+
+int
+main (int argc, char **argv) {
+	g_type_init();
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/heaptreemodel/functest", heaptreemodel_functest);
+	g_test_add_func("/heaptreemodel/lazy", heaptreemodel_lazy);
+	g_test_add_func("/heaptreemodel/empty", heaptreemodel_empty);
+	g_test_add_func("/heaptreemodel/label-filter", heaptreemodel_label_filter);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
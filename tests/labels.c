@@ -0,0 +1,327 @@
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <massifg_labels.h>
+#include <massifg_parser.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* Number of labels used in the performance test */
+#define PERF_NUM_LABELS 100000
+
+/* Number of labels interned while another thread looks them up */
+#define CONCURRENT_NUM_LABELS 20000
+
+/* Check a search result against a linear scan over all the labels */
+static void
+check_search(MassifgLabelTable *table, MassifgLabelIndex *index, const gchar *str) {
+	GArray *result = massifg_label_index_search(index, str);
+	gchar *folded_str = g_ascii_strdown(str, -1);
+	gchar *folded_label = NULL;
+	guint id, n = 0;
+
+	for (id=0; id<massifg_label_table_size(table); id++) {
+		folded_label = g_ascii_strdown(massifg_label_table_get(table, id)->str, -1);
+		if (strstr(folded_label, folded_str)) {
+			g_assert_cmpuint(n, <, result->len);
+			g_assert_cmpuint(g_array_index(result, guint, n), ==, id);
+			n++;
+		}
+		g_free(folded_label);
+	}
+	g_assert_cmpuint(n, ==, result->len);
+
+	g_free(folded_str);
+	g_array_free(result, TRUE);
+}
+
+void
+labels_intern(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	guint id_a, id_b;
+
+	id_a = massifg_label_table_intern(table, "0x4E0A: g_malloc (gmem.c:131)");
+	id_b = massifg_label_table_intern(table, "0x4E0B: g_realloc (gmem.c:170)");
+	g_assert_cmpuint(id_a, ==, 0);
+	g_assert_cmpuint(id_b, ==, 1);
+
+	/* Interning again gives the same id and the same string */
+	g_assert_cmpuint(massifg_label_table_intern(table, "0x4E0A: g_malloc (gmem.c:131)"), ==, id_a);
+	g_assert_cmpuint(massifg_label_table_size(table), ==, 2);
+	g_assert_cmpstr(massifg_label_table_get(table, id_b)->str, ==, "0x4E0B: g_realloc (gmem.c:170)");
+
+	massifg_label_table_unref(table);
+}
+
+/* Check the parts of a label, NULL for the parts it should not have */
+static void
+check_fields(MassifgLabelTable *table, const gchar *label, guint64 address,
+		const gchar *function, const gchar *file, guint line, const gchar *object) {
+	guint id = massifg_label_table_intern(table, label);
+	const MassifgLabelFields *fields = massifg_label_table_get_fields(table, id);
+
+	g_assert_cmpuint(fields->address, ==, address);
+	g_assert_cmpuint(fields->line, ==, line);
+
+	if (function)
+		g_assert_cmpstr(massifg_label_table_get(table->functions, fields->function_id)->str, ==, function);
+	else
+		g_assert_cmpuint(fields->function_id, ==, MASSIFG_LABEL_NONE);
+
+	if (file)
+		g_assert_cmpstr(massifg_label_table_get(table->files, fields->file_id)->str, ==, file);
+	else
+		g_assert_cmpuint(fields->file_id, ==, MASSIFG_LABEL_NONE);
+
+	if (object)
+		g_assert_cmpstr(massifg_label_table_get(table->objects, fields->object_id)->str, ==, object);
+	else
+		g_assert_cmpuint(fields->object_id, ==, MASSIFG_LABEL_NONE);
+}
+
+void
+labels_fields(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	const MassifgLabelFields *a, *b;
+
+	check_fields(table, "0x5792ABD: dictresize (dictobject.c:517)",
+			0x5792ABD, "dictresize", "dictobject.c", 517, NULL);
+	check_fields(table, "0x54A26EE: ??? (in /lib/libselinux.so.1)",
+			0x54A26EE, "???", NULL, 0, "/lib/libselinux.so.1");
+	check_fields(table, "0x4E0A: std::string::_Rep::_S_create(unsigned int, unsigned int, std::allocator<char> const&) (in /usr/lib/libstdc++.so.6.0.13)",
+			0x4E0A, "std::string::_Rep::_S_create(unsigned int, unsigned int, std::allocator<char> const&)",
+			NULL, 0, "/usr/lib/libstdc++.so.6.0.13");
+	check_fields(table, "0x80B3: main",
+			0x80B3, "main", NULL, 0, NULL);
+	check_fields(table, "in 3 places, all below massif's threshold (01.00%)",
+			0, NULL, NULL, 0, NULL);
+	check_fields(table, "(heap allocation functions) malloc/new/new[], --alloc-fns, etc.",
+			0, NULL, NULL, 0, NULL);
+
+	/* The same function in different places has the same function id */
+	a = massifg_label_table_get_fields(table, massifg_label_table_intern(table, "0x1: g_malloc (gmem.c:131)"));
+	b = massifg_label_table_get_fields(table, massifg_label_table_intern(table, "0x2: g_malloc (gmem.c:135)"));
+	g_assert_cmpuint(a->function_id, ==, b->function_id);
+	g_assert_cmpuint(a->file_id, ==, b->file_id);
+
+	massifg_label_table_unref(table);
+}
+
+void
+labels_short_label(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	gchar *str;
+
+	str = massifg_label_table_get_short_label(table, massifg_label_table_intern(table,
+		"0x4E0A: std::string::_Rep::_S_create(unsigned int, unsigned int, std::allocator<char> const&) (in /usr/lib/libstdc++.so.6.0.13)"));
+	g_assert_cmpstr(str, ==, "std::string::_Rep::_S_create (in /usr/lib/libstdc++.so.6.0.13)");
+	g_free(str);
+
+	str = massifg_label_table_get_short_label(table, massifg_label_table_intern(table,
+		"0x5792ABD: dictresize (dictobject.c:517)"));
+	g_assert_cmpstr(str, ==, "dictresize (dictobject.c:517)");
+	g_free(str);
+
+	str = massifg_label_table_get_short_label(table, massifg_label_table_intern(table,
+		"in 1 place, below massif's threshold (01.00%)"));
+	g_assert_cmpstr(str, ==, "in 1 place, below massif's threshold (01.00%)");
+	g_free(str);
+
+	massifg_label_table_unref(table);
+}
+
+void
+labels_search(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	MassifgLabelIndex *index = NULL;
+	GArray *result = NULL;
+
+	massifg_label_table_intern(table, "0x4E0A: g_malloc (gmem.c:131)");
+	massifg_label_table_intern(table, "0x4E0B: g_realloc (gmem.c:170)");
+	massifg_label_table_intern(table, "0x5792ABD: dictresize (dictobject.c:517)");
+	index = massifg_label_index_new(table);
+
+	check_search(table, index, "");
+	check_search(table, index, "g");
+	check_search(table, index, "G_MALLOC");
+	check_search(table, index, "gmem.c");
+	check_search(table, index, "dict");
+	check_search(table, index, "not there");
+
+	/* All the trigrams are there, but not in this order */
+	result = massifg_label_index_search(index, "mallocgmem");
+	g_assert_cmpuint(result->len, ==, 0);
+	g_array_free(result, TRUE);
+
+	/* Labels added later are found after an update */
+	massifg_label_table_intern(table, "0x4E0C: g_malloc0 (gmem.c:151)");
+	massifg_label_index_update(index);
+	check_search(table, index, "malloc");
+
+	massifg_label_index_free(index);
+	massifg_label_table_unref(table);
+}
+
+/* The parser interns labels, so nodes with the same label share it */
+void
+labels_parsed(void) {
+	MassifgOutputData *data;
+	GList *l;
+	MassifgSnapshot *s;
+	GNode *child;
+	MassifgHeapTreeNode *node;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	g_assert(data->label_index != NULL);
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (!s->heap_tree)
+			continue;
+		for (child = s->heap_tree->children; child; child = child->next) {
+			node = (MassifgHeapTreeNode *)child->data;
+			g_assert(massifg_label_table_get(data->labels, node->label_id) == node->label);
+		}
+	}
+	check_search(data->labels, data->label_index, "gmem.c");
+	check_search(data->labels, data->label_index, "Glib::ustring");
+
+	massifg_output_data_unref(data);
+}
+
+/* The index of parsed data is frozen, so labels that other files add
+ * to the shared table later do not change it */
+void
+labels_frozen(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	MassifgOutputData *short_data, *long_data;
+	guint num_indexed;
+	gchar *path;
+
+	path = get_test_file(TEST_INPUT_SHORT);
+	short_data = massifg_parse_file_with_labels(path, table, NULL);
+	g_free(path);
+	num_indexed = short_data->label_index->num_indexed;
+	g_assert_cmpuint(num_indexed, ==, massifg_label_table_size(table));
+
+	path = get_test_file(TEST_INPUT_LONG);
+	long_data = massifg_parse_file_with_labels(path, table, NULL);
+	g_free(path);
+	g_assert_cmpuint(massifg_label_table_size(table), >, num_indexed);
+
+	massifg_label_index_update(short_data->label_index);
+	g_assert_cmpuint(short_data->label_index->num_indexed, ==, num_indexed);
+	g_assert_cmpuint(long_data->label_index->num_indexed, ==, massifg_label_table_size(table));
+
+	massifg_output_data_unref(short_data);
+	massifg_output_data_unref(long_data);
+	massifg_label_table_unref(table);
+}
+
+/* Intern labels whose line number is their index */
+static gpointer
+intern_thread(gpointer user_data) {
+	MassifgLabelTable *table = (MassifgLabelTable *)user_data;
+	gchar *label = NULL;
+	guint i;
+
+	for (i=0; i<CONCURRENT_NUM_LABELS; i++) {
+		label = g_strdup_printf("0x%08X: function_%u (file.c:%u)", i*16, i, i);
+		massifg_label_table_intern(table, label);
+		g_free(label);
+	}
+	return NULL;
+}
+
+/* Labels and their parts can be looked up while another thread interns
+ * labels, and stay where they are as the table grows */
+void
+labels_concurrent_lookup(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	const MassifgLabelFields *first_fields = NULL;
+	const MassifgLabelFields *fields = NULL;
+	GString *first_label = NULL;
+	GThread *thread = NULL;
+	guint id = 0;
+
+	thread = g_thread_create(intern_thread, table, TRUE, NULL);
+	g_assert(thread != NULL);
+
+	while (id < CONCURRENT_NUM_LABELS) {
+		if (id >= massifg_label_table_size(table))
+			continue;
+		fields = massifg_label_table_get_fields(table, id);
+		g_assert_cmpuint(fields->address, ==, id*16);
+		g_assert_cmpuint(fields->line, ==, id);
+		g_assert(g_str_has_prefix(massifg_label_table_get(table, id)->str, "0x"));
+		if (id == 0) {
+			first_fields = fields;
+			first_label = massifg_label_table_get(table, 0);
+		}
+		id++;
+	}
+	g_thread_join(thread);
+
+	g_assert(massifg_label_table_get_fields(table, 0) == first_fields);
+	g_assert(massifg_label_table_get(table, 0) == first_label);
+	g_assert_cmpuint(massifg_label_table_size(table), ==, CONCURRENT_NUM_LABELS);
+
+	massifg_label_table_unref(table);
+}
+
+void
+labels_search_perf(void) {
+	MassifgLabelTable *table = massifg_label_table_new();
+	MassifgLabelIndex *index = NULL;
+	GArray *result = NULL;
+	gchar *label = NULL;
+	gdouble elapsed;
+	guint i;
+
+	for (i=0; i<PERF_NUM_LABELS; i++) {
+		label = g_strdup_printf("0x%08X: function_%u (file_%u.c:%u)", i*16, i, i % 997, i % 4001);
+		massifg_label_table_intern(table, label);
+		g_free(label);
+	}
+
+	g_test_timer_start();
+	index = massifg_label_index_new(table);
+	elapsed = g_test_timer_elapsed();
+	g_test_message("Indexed %d labels in %.3f s", PERF_NUM_LABELS, elapsed);
+
+	g_test_timer_start();
+	result = massifg_label_index_search(index, "function_4242 ");
+	elapsed = g_test_timer_elapsed();
+	g_assert_cmpuint(result->len, ==, 1);
+	g_array_free(result, TRUE);
+	g_test_minimized_result(elapsed, "Searched %d labels in %.6f s", PERF_NUM_LABELS, elapsed);
+
+	check_search(table, index, "file_42.c");
+
+	massifg_label_index_free(index);
+	massifg_label_table_unref(table);
+}
+
+int
+main (int argc, char **argv) {
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/labels/intern", labels_intern);
+	g_test_add_func("/labels/fields", labels_fields);
+	g_test_add_func("/labels/short-label", labels_short_label);
+	g_test_add_func("/labels/search", labels_search);
+	g_test_add_func("/labels/parsed", labels_parsed);
+	g_test_add_func("/labels/frozen", labels_frozen);
+	g_test_add_func("/labels/concurrent-lookup", labels_concurrent_lookup);
+	g_test_add_func("/labels/search-perf", labels_search_perf);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
@@ -0,0 +1,236 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+/* Writes synthetic massif output, for testing how the parser and the graph scale
+ * with inputs too large to be part of the test suite.
+ * The same options and seed always give the same output.
+ *
+ * The heap trees have the same shape in every detailed snapshot, with the labels
+ * chosen by the position of a node in the tree, like the stack traces of a
+ * real program. Only the sizes vary */
+
+typedef enum {
+	GROWTH_LINEAR,
+	GROWTH_SAWTOOTH,
+	GROWTH_LEAK,
+	GROWTH_RANDOM
+} Growth;
+
+static const gchar *growth_names[] = {"linear", "sawtooth", "leak", "random"};
+
+typedef struct {
+	guint num_snapshots;
+	guint detailed_freq;
+	guint depth;
+	guint fanout;
+	guint num_labels;
+	Growth growth;
+	guint32 seed;
+} GeneratorOptions;
+
+/* Size of the heap, in bytes, in snapshot i */
+static gint64
+heap_size(const GeneratorOptions *options, GRand *rand, guint i, gint64 previous) {
+	const gint64 step = 4096;
+	gint64 size;
+
+	switch (options->growth) {
+	case GROWTH_LINEAR:
+		return step*(i+1);
+	case GROWTH_SAWTOOTH:
+		/* Grows over 100 snapshots, then drops, each time to a slightly higher level */
+		return step*(i % 100 + 1) + step*10*(i/100);
+	case GROWTH_LEAK:
+		/* A steady leak under a working set that comes and goes */
+		return step*i/4 + step*g_rand_int_range(rand, 50, 150);
+	case GROWTH_RANDOM:
+		size = previous + step*g_rand_int_range(rand, -20, 21);
+		return MAX(size, step);
+	}
+	g_return_val_if_reached(0);
+}
+
+/* The label of a child is given by the label of its parent and its position */
+static guint
+child_label(const GeneratorOptions *options, guint parent_label, guint child) {
+	return (parent_label*31 + child*7919 + 1) % options->num_labels;
+}
+
+static void
+write_label(FILE *file, guint label) {
+	fprintf(file, "0x%08X: function_%u (file_%u.c:%u)\n",
+		0x400000 + label*16, label, label % 97, label % 4001 + 1);
+}
+
+/* Write the node with the given label and size and all its descendants.
+ * scratch has room for 2*fanout values for each level of the tree */
+static void
+write_node(FILE *file, const GeneratorOptions *options, GRand *rand, gint64 *scratch,
+	guint depth, guint label, gint64 size) {
+	gint64 *sizes = scratch + 2*options->fanout*depth;
+	gint64 *weights = sizes + options->fanout;
+	gint64 total_weight = 0, rest = size, tmp;
+	guint num_children = 0;
+	guint i, j;
+
+	/* Small nodes and the deepest ones have no children, like main() */
+	if (depth < options->depth && size >= (gint64)options->fanout*16) {
+		num_children = options->fanout;
+	}
+
+	/* Split the size between the children, the first ones getting the most */
+	for (i=0; i<num_children; i++) {
+		weights[i] = (num_children - i)*g_rand_int_range(rand, 80, 121);
+		total_weight += weights[i];
+	}
+	for (i=0; i<num_children; i++) {
+		sizes[i] = i+1 < num_children ? size*weights[i]/total_weight : rest;
+		rest -= sizes[i];
+	}
+	/* Massif writes the children sorted by size */
+	for (i=1; i<num_children; i++) {
+		for (j=i; j>0 && sizes[j] > sizes[j-1]; j--) {
+			tmp = sizes[j];
+			sizes[j] = sizes[j-1];
+			sizes[j-1] = tmp;
+		}
+	}
+
+	fprintf(file, "%*sn%u: %" G_GINT64_FORMAT " ", depth, "", num_children, size);
+	if (depth == 0)
+		fputs("(heap allocation functions) malloc/new/new[], --alloc-fns, etc.\n", file);
+	else
+		write_label(file, label);
+
+	for (i=0; i<num_children; i++) {
+		write_node(file, options, rand, scratch, depth+1, child_label(options, label, i), sizes[i]);
+	}
+}
+
+static void
+write_output(FILE *file, const GeneratorOptions *options) {
+	GRand *rand = g_rand_new_with_seed(options->seed);
+	gint64 *sizes = g_new(gint64, options->num_snapshots);
+	gint64 *scratch = g_new(gint64, 2*options->fanout*(options->depth+1));
+	gint64 time = 0, previous = 0;
+	guint peak = 0;
+	guint i;
+	gboolean detailed;
+
+	/* The sizes come first, to know which detailed snapshot is the peak */
+	for (i=0; i<options->num_snapshots; i++) {
+		sizes[i] = previous = heap_size(options, rand, i, previous);
+		if (i % options->detailed_freq == 0 && sizes[i] > sizes[peak])
+			peak = i;
+	}
+
+	fprintf(file, "desc: --detailed-freq=%u\n", options->detailed_freq);
+	fprintf(file, "cmd: massif-generator --seed=%u\n", options->seed);
+	fprintf(file, "time_unit: i\n");
+
+	for (i=0; i<options->num_snapshots; i++) {
+		detailed = i % options->detailed_freq == 0;
+
+		fprintf(file, "#-----------\nsnapshot=%u\n#-----------\n", i);
+		fprintf(file, "time=%" G_GINT64_FORMAT "\n", time);
+		fprintf(file, "mem_heap_B=%" G_GINT64_FORMAT "\n", sizes[i]);
+		fprintf(file, "mem_heap_extra_B=%" G_GINT64_FORMAT "\n", sizes[i]/16);
+		fprintf(file, "mem_stacks_B=0\n");
+		fprintf(file, "heap_tree=%s\n", !detailed ? "empty" : (i == peak ? "peak" : "detailed"));
+		if (detailed) {
+			write_node(file, options, rand, scratch, 0, 0, sizes[i]);
+		}
+		time += g_rand_int_range(rand, 1000, 100000);
+	}
+
+	g_free(scratch);
+	g_free(sizes);
+	g_rand_free(rand);
+}
+
+int
+main (int argc, char **argv) {
+	GeneratorOptions options = {1000, 10, 6, 3, 1000, GROWTH_LINEAR, 0};
+	gint num_snapshots = options.num_snapshots;
+	gint detailed_freq = options.detailed_freq;
+	gint depth = options.depth;
+	gint fanout = options.fanout;
+	gint num_labels = options.num_labels;
+	gint seed = options.seed;
+	gchar *growth = NULL;
+	gchar *output = NULL;
+	GOptionContext *context = NULL;
+	GError *error = NULL;
+	FILE *file = stdout;
+	guint i;
+
+	GOptionEntry entries[] = {
+		{ "snapshots", 'n', 0, G_OPTION_ARG_INT, &num_snapshots,
+		  "Number of snapshots, default 1000", "N" },
+		{ "detailed-freq", 'd', 0, G_OPTION_ARG_INT, &detailed_freq,
+		  "Every Nth snapshot has a heap tree, default 10", "N" },
+		{ "depth", 0, 0, G_OPTION_ARG_INT, &depth,
+		  "Depth of the heap trees, default 6", "N" },
+		{ "fanout", 0, 0, G_OPTION_ARG_INT, &fanout,
+		  "Number of children of the inner nodes of the heap trees, default 3", "N" },
+		{ "labels", 0, 0, G_OPTION_ARG_INT, &num_labels,
+		  "Number of distinct function labels, default 1000", "N" },
+		{ "growth", 'g', 0, G_OPTION_ARG_STRING, &growth,
+		  "How the heap grows: linear, sawtooth, leak or random. Default linear", "PATTERN" },
+		{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+		  "Seed for the random numbers, default 0", "SEED" },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+		  "Write to FILE instead of the standard output", "FILE" },
+		{ NULL }
+	};
+
+	context = g_option_context_new("- write synthetic massif output");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (num_snapshots < 1 || detailed_freq < 1 || depth < 1 || fanout < 1 || num_labels < 1) {
+		g_printerr("The counts must be at least 1\n");
+		return 1;
+	}
+	options.num_snapshots = num_snapshots;
+	options.detailed_freq = detailed_freq;
+	options.depth = depth;
+	options.fanout = fanout;
+	options.num_labels = num_labels;
+	options.seed = seed;
+
+	if (growth) {
+		for (i=0; i<G_N_ELEMENTS(growth_names) && strcmp(growth, growth_names[i]); i++)
+			;
+		if (i == G_N_ELEMENTS(growth_names)) {
+			g_printerr("Unknown growth pattern %s\n", growth);
+			return 1;
+		}
+		options.growth = (Growth)i;
+		g_free(growth);
+	}
+
+	if (output) {
+		file = fopen(output, "w");
+		if (!file) {
+			g_printerr("Unable to open %s\n", output);
+			return 1;
+		}
+		g_free(output);
+	}
+
+	write_output(file, &options);
+	if (fclose(file) != 0) {
+		g_printerr("Unable to write the output\n");
+		return 1;
+	}
+	return 0;
+}
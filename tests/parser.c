@@ -1,4 +1,6 @@
 
+#include <string.h>
+
 #include <glib.h>
 
 #include <massifg_parser.h>
@@ -97,6 +99,7 @@ parser_heaptree_attributes_1(void) {
 
 	MassifgHeapTreeNode *node = massifg_heap_tree_node_new(test_str);
 	g_assert_cmpint(node->total_mem_B, ==, 1411172);
+	g_assert_cmpint(node->self_mem_B, ==, 1411172);
 	g_assert_cmpint(node->num_children, ==, 13);
 	g_assert_cmpstr(node->label->str, ==, "(heap allocation functions) malloc/new/new[], --alloc-fns, etc.");
 
@@ -226,17 +229,501 @@ parser_heaptree_subtrees(void) {
 	g_assert_cmpstr(n->label->str, ==, "0x554E715: xmlHashCreate (hash.c:156)");
 }
 
+/* Compare two heap trees node by node */
+static gboolean
+heap_trees_equal(GNode *a, GNode *b) {
+	MassifgHeapTreeNode *node_a = (MassifgHeapTreeNode *)a->data;
+	MassifgHeapTreeNode *node_b = (MassifgHeapTreeNode *)b->data;
+
+	if (node_a->total_mem_B != node_b->total_mem_B ||
+	    node_a->self_mem_B != node_b->self_mem_B ||
+	    g_node_n_children(a) != g_node_n_children(b) ||
+	    g_strcmp0(node_a->label->str, node_b->label->str) != 0) {
+		return FALSE;
+	}
+	for (a = a->children, b = b->children; a && b; a = a->next, b = b->next) {
+		if (!heap_trees_equal(a, b))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Check that every node in a heap tree has the memory that is not under its children
+ * as its own. Returns the number of nodes */
+static guint
+check_self_mem(GNode *node) {
+	MassifgHeapTreeNode *n = (MassifgHeapTreeNode *)node->data;
+	GNode *child = NULL;
+	glong children_mem_B = 0;
+	guint num_nodes = 1;
+
+	for (child = node->children; child; child = child->next) {
+		children_mem_B += ((MassifgHeapTreeNode *)child->data)->total_mem_B;
+		num_nodes += check_self_mem(child);
+	}
+	g_assert_cmpint(n->self_mem_B, ==, n->total_mem_B - children_mem_B);
+	g_assert_cmpint(n->self_mem_B, >=, 0);
+	return num_nodes;
+}
+
+/* The parser sets the memory of each node itself, also in a tree cut short */
+void
+parser_heaptree_self_mem(void) {
+	MassifgOutputData *data;
+	MassifgParser *parser;
+	MassifgSnapshot *s;
+	MassifgHeapTreeNode *root;
+	GList *l;
+	gchar *contents = NULL;
+	const gchar *end;
+	gsize length;
+	guint num_nodes = 0;
+	gint i;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_assert(g_file_get_contents(path, &contents, &length, NULL));
+	g_free(path);
+
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (s->heap_tree)
+			num_nodes += check_self_mem(s->heap_tree);
+	}
+	g_assert_cmpuint(num_nodes, ==, 21561);
+	massifg_output_data_unref(data);
+
+	/* End the output a few nodes into the last heap tree */
+	end = g_strrstr(contents, "heap_tree=detailed");
+	g_assert(end != NULL);
+	for (i=0; i<5; i++) {
+		end = strchr(end, '\n') + 1;
+	}
+	parser = massifg_parser_new(NULL);
+	massifg_parser_feed(parser, contents, end - contents);
+	data = massifg_parser_finish(parser, NULL);
+	massifg_parser_free(parser);
+	g_free(contents);
+
+	s = (MassifgSnapshot *)g_list_last(data->snapshots)->data;
+	g_assert(s->heap_tree != NULL);
+	root = (MassifgHeapTreeNode *)s->heap_tree->data;
+	g_assert_cmpint(g_node_n_children(s->heap_tree), <, root->num_children);
+	check_self_mem(s->heap_tree);
+	massifg_output_data_unref(data);
+}
+
+/* Test that identical subtrees in consecutive snapshots are shared */
+void
+parser_heaptree_shared_subtrees(void) {
+	GList *list;
+	GNode *a, *b;
+	MassifgOutputData *data;
+	MassifgSnapshot *s, *prev = NULL;
+	gint num_shared = 0;
+
+	/* Run the parser */
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	for (list = data->snapshots; list; list = list->next) {
+		s = (MassifgSnapshot *)list->data;
+		if (!s->heap_tree)
+			continue;
+
+		if (prev) {
+			for (a = s->heap_tree->children; a; a = a->next) {
+				for (b = prev->heap_tree->children; b; b = b->next) {
+					if (a->children && heap_trees_equal(a, b)) {
+						g_assert(a->children == b->children);
+						num_shared++;
+					}
+				}
+			}
+		}
+		prev = s;
+	}
+	g_assert_cmpint(num_shared, >, 0);
+
+	massifg_output_data_unref(data);
+}
+
+/* Snapshots after the peak snapshot were lost, the peak has a heap tree too */
+void
+parser_heaptree_peak(void) {
+	MassifgOutputData *data;
+	MassifgSnapshot *s;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	g_assert_cmpint(g_list_length(data->snapshots), ==, 68);
+
+	s = (MassifgSnapshot *)g_list_nth_data(data->snapshots, 52);
+	g_assert_cmpint(s->snapshot_no, ==, 52);
+	g_assert_cmpstr(s->heap_tree_desc->str, ==, "peak");
+	g_assert(s->heap_tree != NULL);
+	g_assert_cmpint(((MassifgHeapTreeNode *)s->heap_tree->data)->total_mem_B, ==, 7157818);
+
+	s = (MassifgSnapshot *)g_list_nth_data(data->snapshots, 53);
+	g_assert_cmpint(s->snapshot_no, ==, 53);
+
+	massifg_output_data_unref(data);
+}
+
+/* Feeding the file in small pieces gives the same data as parsing it at once,
+ * and the data only ever has complete snapshots */
+void
+parser_feed(void) {
+	MassifgOutputData *expected, *data;
+	MassifgParser *parser;
+	MassifgSnapshot *s, *e;
+	GList *a, *b;
+	gchar *contents = NULL;
+	gsize length, offset, piece;
+	guint num_snapshots = 0;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	expected = massifg_parse_file(path, NULL);
+	g_assert(g_file_get_contents(path, &contents, &length, NULL));
+	g_free(path);
+
+	parser = massifg_parser_new(NULL);
+	for (offset = 0; offset < length; offset += piece) {
+		/* Pieces of varying size, ending in the middle of lines */
+		piece = MIN(1 + offset % 997, length - offset);
+		massifg_parser_feed(parser, contents + offset, piece);
+
+		data = massifg_parser_get_output_data(parser);
+		g_assert_cmpuint(g_list_length(data->snapshots), >=, num_snapshots);
+		num_snapshots = g_list_length(data->snapshots);
+		if (num_snapshots > 0) {
+			/* The last snapshot is already complete */
+			s = (MassifgSnapshot *)g_list_last(data->snapshots)->data;
+			e = (MassifgSnapshot *)g_list_nth_data(expected->snapshots, num_snapshots-1);
+			g_assert_cmpint(s->snapshot_no, ==, e->snapshot_no);
+			g_assert((s->heap_tree == NULL) == (e->heap_tree == NULL));
+			if (s->heap_tree) {
+				g_assert(heap_trees_equal(s->heap_tree, e->heap_tree));
+			}
+		}
+	}
+	data = massifg_parser_finish(parser, NULL);
+	massifg_parser_free(parser);
+	g_free(contents);
+
+	g_assert(data != NULL);
+	g_assert_cmpint(data->max_time, ==, expected->max_time);
+	g_assert_cmpint(data->max_mem_allocation, ==, expected->max_mem_allocation);
+	g_assert_cmpuint(g_list_length(data->snapshots), ==, g_list_length(expected->snapshots));
+	for (a = data->snapshots, b = expected->snapshots; a && b; a = a->next, b = b->next) {
+		MassifgSnapshot *sa = (MassifgSnapshot *)a->data;
+		MassifgSnapshot *sb = (MassifgSnapshot *)b->data;
+
+		g_assert_cmpint(sa->snapshot_no, ==, sb->snapshot_no);
+		g_assert_cmpint(sa->time, ==, sb->time);
+		g_assert_cmpint(sa->mem_heap_B, ==, sb->mem_heap_B);
+		g_assert((sa->heap_tree == NULL) == (sb->heap_tree == NULL));
+		if (sa->heap_tree) {
+			g_assert(heap_trees_equal(sa->heap_tree, sb->heap_tree));
+		}
+	}
+
+	massifg_output_data_unref(expected);
+	massifg_output_data_unref(data);
+
+	/* Nothing to parse */
+	parser = massifg_parser_new(NULL);
+	massifg_parser_feed(parser, "desc: (none)\n", -1);
+	g_assert(massifg_parser_finish(parser, NULL) == NULL);
+	massifg_parser_free(parser);
+}
+
+/* Generated output parses, and is the same every time for the same seed */
+void
+parser_generated(void) {
+	MassifgOutputData *data;
+	MassifgParser *parser;
+	MassifgSnapshot *s;
+	GNode *child;
+	GList *l;
+	gchar *output = NULL, *output_again = NULL;
+	gint64 children_mem_B;
+	guint num_trees = 0;
+	gint exit_status;
+	gchar *argv[] = {TEST_GENERATOR, "--snapshots=50", "--detailed-freq=4", "--depth=4",
+			"--fanout=3", "--labels=20", "--growth=sawtooth", "--seed=42", NULL};
+
+	g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, &output, NULL, &exit_status, NULL));
+	g_assert_cmpint(exit_status, ==, 0);
+	g_assert(g_spawn_sync(NULL, argv, NULL, 0, NULL, NULL, &output_again, NULL, &exit_status, NULL));
+	g_assert_cmpstr(output, ==, output_again);
+	g_free(output_again);
+
+	parser = massifg_parser_new(NULL);
+	massifg_parser_feed(parser, output, -1);
+	data = massifg_parser_finish(parser, NULL);
+	massifg_parser_free(parser);
+	g_free(output);
+	g_assert(data != NULL);
+
+	g_assert_cmpuint(g_list_length(data->snapshots), ==, 50);
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		g_assert((s->heap_tree != NULL) == (s->snapshot_no % 4 == 0));
+		if (!s->heap_tree)
+			continue;
+		num_trees++;
+
+		/* The root accounts for the whole heap, and the children for their parent */
+		g_assert_cmpint(((MassifgHeapTreeNode *)s->heap_tree->data)->total_mem_B, ==, s->mem_heap_B);
+		children_mem_B = 0;
+		for (child = s->heap_tree->children; child; child = child->next) {
+			children_mem_B += ((MassifgHeapTreeNode *)child->data)->total_mem_B;
+		}
+		g_assert_cmpint(children_mem_B, ==, s->mem_heap_B);
+	}
+	g_assert_cmpuint(num_trees, ==, 13);
+	g_assert_cmpuint(massifg_label_table_size(data->labels), <=, 20+1);
+
+	massifg_output_data_unref(data);
+}
+
+/* The memory stats add up, and shared subtrees are only counted once */
+void
+parser_memory_stats(void) {
+	MassifgOutputData *data;
+	MassifgMemoryStats stats;
+	MassifgSnapshot *s;
+	GList *l;
+	guint64 num_trees = 0;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+
+	massifg_output_data_get_memory_stats(data, &stats);
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (s->heap_tree)
+			num_trees++;
+	}
+
+	g_assert_cmpuint(stats.num_snapshots, ==, 68);
+	g_assert_cmpuint(stats.num_nodes, >=, num_trees);
+	g_assert_cmpuint(stats.num_nodes, <, stats.num_node_refs);
+	g_assert_cmpuint(stats.num_node_refs, ==, 21561);
+	g_assert_cmpuint(stats.num_links, ==, stats.num_nodes);
+	g_assert_cmpuint(stats.num_labels, ==, massifg_label_table_size(data->labels));
+	g_assert_cmpuint(stats.num_label_refs, ==, stats.num_node_refs);
+	g_assert_cmpuint(stats.num_series, ==, 0);
+	g_assert_cmpuint(stats.nodes_B, >=, stats.num_nodes*sizeof(MassifgHeapTreeNode));
+	g_assert_cmpuint(stats.labels_B, >, 0);
+	g_assert_cmpuint(stats.total_B, ==,
+			stats.snapshots_B + stats.nodes_B + stats.links_B + stats.labels_B);
+
+	massifg_output_data_unref(data);
+}
+
+/* With a memory budget the heap trees are spilled, and come back the same */
+#define MEMORY_BUDGET_B (64*1024)
+
+void
+parser_memory_budget(void) {
+	MassifgOutputData *expected, *data;
+	MassifgParser *parser;
+	MassifgMemoryStats stats;
+	MassifgSnapshot *s, *e, *pinned = NULL;
+	GNode *heap_tree, *pinned_tree = NULL;
+	GList *a, *b;
+	gchar *contents = NULL;
+	gsize length;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	expected = massifg_parse_file(path, NULL);
+	g_assert(g_file_get_contents(path, &contents, &length, NULL));
+	g_free(path);
+
+	parser = massifg_parser_new(NULL);
+	massifg_parser_set_memory_budget(parser, MEMORY_BUDGET_B);
+	massifg_parser_feed(parser, contents, length);
+	data = massifg_parser_finish(parser, NULL);
+	massifg_parser_free(parser);
+	g_free(contents);
+
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_assert_cmpuint(stats.num_spilled_trees, >, 0);
+	g_assert_cmpuint(stats.spill_file_B, >, 0);
+	g_assert_cmpuint(data->heap_trees_B, <=, MEMORY_BUDGET_B);
+
+	/* Every tree comes back, and a tree that is in use stays in memory */
+	for (a = data->snapshots, b = expected->snapshots; a && b; a = a->next, b = b->next) {
+		s = (MassifgSnapshot *)a->data;
+		e = (MassifgSnapshot *)b->data;
+		g_assert(massifg_snapshot_has_heap_tree(s) == (e->heap_tree != NULL));
+
+		heap_tree = massifg_output_data_get_heap_tree(data, s);
+		g_assert((heap_tree == NULL) == (e->heap_tree == NULL));
+		if (!heap_tree)
+			continue;
+		g_assert(heap_trees_equal(heap_tree, e->heap_tree));
+		if (!pinned) {
+			pinned = s;
+			pinned_tree = heap_tree;
+			continue;
+		}
+		massifg_output_data_release_heap_tree(data, s);
+		g_assert(pinned->heap_tree == pinned_tree);
+	}
+	g_assert(pinned != NULL);
+	massifg_output_data_release_heap_tree(data, pinned);
+	g_assert_cmpuint(data->heap_trees_B, <=, MEMORY_BUDGET_B);
+
+	/* The budget counts the nodes that are in memory */
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_assert_cmpuint(data->heap_trees_B, ==,
+			stats.num_nodes*(sizeof(MassifgHeapTreeNode) + sizeof(GNode)));
+
+	massifg_output_data_unref(expected);
+	massifg_output_data_unref(data);
+}
+
+/* The summary agrees with the fully parsed data */
+void
+parser_summary(void) {
+	MassifgOutputData *data;
+	MassifgSummary *summary;
+	MassifgSnapshot *s, *peak = NULL;
+	MassifgAllocator *allocator;
+	GNode *child;
+	GList *l;
+	gint64 total_mem_B, peak_mem_B = -1;
+	guint i, num_children;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	summary = massifg_summarize_file(path, 5, NULL);
+	g_free(path);
+	g_assert(summary != NULL);
+
+	g_assert_cmpstr(summary->cmd->str, ==, data->cmd->str);
+	g_assert_cmpstr(summary->time_unit->str, ==, data->time_unit->str);
+	g_assert_cmpint(summary->max_time, ==, data->max_time);
+	g_assert_cmpint(summary->num_snapshots, ==, g_list_length(data->snapshots));
+	g_assert_cmpint(summary->peak_mem_B, ==, data->max_mem_allocation);
+
+	/* The allocators are the largest children of the root of the largest heap tree */
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		total_mem_B = s->mem_heap_B + s->mem_heap_extra_B + s->mem_stacks_B;
+		if (s->heap_tree && total_mem_B > peak_mem_B) {
+			peak = s;
+			peak_mem_B = total_mem_B;
+		}
+	}
+	g_assert_cmpint(summary->peak_tree_snapshot_no, ==, peak->snapshot_no);
+	g_assert_cmpint(summary->peak_tree_mem_B, ==, peak_mem_B);
+
+	num_children = g_node_n_children(peak->heap_tree);
+	g_assert_cmpuint(summary->peak_allocators->len, ==, MIN(5, num_children));
+	for (i=0; i<summary->peak_allocators->len; i++) {
+		allocator = (MassifgAllocator *)g_ptr_array_index(summary->peak_allocators, i);
+		for (child = peak->heap_tree->children; child; child = child->next) {
+			if (g_strcmp0(((MassifgHeapTreeNode *)child->data)->label->str, allocator->label) == 0)
+				break;
+		}
+		g_assert(child != NULL);
+		g_assert_cmpint(((MassifgHeapTreeNode *)child->data)->total_mem_B, ==, allocator->mem_B);
+		if (i > 0) {
+			g_assert_cmpint(((MassifgAllocator *)g_ptr_array_index(summary->peak_allocators, i-1))->mem_B,
+					>=, allocator->mem_B);
+		}
+	}
+
+	massifg_summary_free(summary);
+	massifg_output_data_unref(data);
+
+	/* Bogus data */
+	path = get_test_file(TEST_INPUT_BOGUS);
+	g_assert(massifg_summarize_file(path, 5, NULL) == NULL);
+	g_free(path);
+}
+
+/* Files parsed together share their labels */
+void
+parser_parse_files(void) {
+	const gchar *filenames[3] = { NULL, NULL, NULL };
+	GPtrArray *datasets;
+	MassifgOutputData *a, *b;
+	MassifgHeapTreeNode *node;
+	GError *error = NULL;
+	GList *l;
+	guint i;
+
+	filenames[0] = get_test_file(TEST_INPUT_SHORT);
+	filenames[1] = get_test_file(TEST_INPUT_LONG);
+	datasets = massifg_parse_files(filenames, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(datasets->len, ==, 2);
+
+	a = (MassifgOutputData *)g_ptr_array_index(datasets, 0);
+	b = (MassifgOutputData *)g_ptr_array_index(datasets, 1);
+	g_assert(a->labels == b->labels);
+	g_assert(a->label_index != NULL && b->label_index != NULL);
+
+	/* The results are in the order of the files */
+	g_assert_cmpint(g_list_length(a->snapshots), ==, 2);
+	g_assert_cmpint(g_list_length(b->snapshots), >, 2);
+
+	/* Every label is interned in the shared table */
+	for (i=0; i<2; i++) {
+		a = (MassifgOutputData *)g_ptr_array_index(datasets, i);
+		for (l = a->snapshots; l; l = l->next) {
+			MassifgSnapshot *s = (MassifgSnapshot *)l->data;
+			if (!s->heap_tree)
+				continue;
+			node = (MassifgHeapTreeNode *)s->heap_tree->data;
+			g_assert(massifg_label_table_get(b->labels, node->label_id) == node->label);
+		}
+	}
+	g_ptr_array_free(datasets, TRUE);
+
+	/* A file that does not parse fails the whole set */
+	g_free((gchar *)filenames[1]);
+	filenames[1] = get_test_file(TEST_INPUT_BOGUS);
+	datasets = massifg_parse_files(filenames, &error);
+	g_assert(datasets == NULL);
+	g_assert(error != NULL);
+	g_error_free(error);
+
+	g_free((gchar *)filenames[0]);
+	g_free((gchar *)filenames[1]);
+}
+
 int
 main (int argc, char **argv) {
+	if (!g_thread_supported())
+		g_thread_init(NULL);
 	g_test_init(&argc, &argv, NULL);
 
 	g_test_add_func("/parser/heaptree/functest", parser_heaptree_functest);
 	g_test_add_func("/parser/heaptree/subtrees", parser_heaptree_subtrees);
+	g_test_add_func("/parser/heaptree/shared-subtrees", parser_heaptree_shared_subtrees);
+	g_test_add_func("/parser/heaptree/self-mem", parser_heaptree_self_mem);
+	g_test_add_func("/parser/heaptree/peak", parser_heaptree_peak);
 
 	g_test_add_func("/parser/functest", parser_functest_short);
 	g_test_add_func("/parser/nonexisting-file", parser_return_null_on_nonexisting_file);
 	g_test_add_func("/parser/bogus-data", parser_return_null_on_bogus_data);
 	g_test_add_func("/parser/max-values", parser_maxvalues);
+	g_test_add_func("/parser/parse-files", parser_parse_files);
+	g_test_add_func("/parser/feed", parser_feed);
+	g_test_add_func("/parser/summary", parser_summary);
+	g_test_add_func("/parser/generated", parser_generated);
+	g_test_add_func("/parser/memory-stats", parser_memory_stats);
+	g_test_add_func("/parser/memory-budget", parser_memory_budget);
 
 	g_test_add_func("/parser/internal/heaptree-attributes-1", parser_heaptree_attributes_1);
 	g_test_add_func("/parser/internal/heaptree-attributes-2", parser_heaptree_attributes_2);
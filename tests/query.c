@@ -0,0 +1,182 @@
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <massifg_parser.h>
+#include <massifg_query.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* Number of queries used in the performance test */
+#define PERF_NUM_QUERIES 1000
+
+/* Straightforward version of what a query computes for one heap tree */
+static gint64
+sum_matching(GNode *node, const gchar *folded_pattern, gint depth, gint max_depth) {
+	MassifgHeapTreeNode *n = NULL;
+	GNode *child = NULL;
+	gchar *folded_label = NULL;
+	gint64 sum = 0;
+
+	for (child = node->children; child; child = child->next) {
+		n = (MassifgHeapTreeNode *)child->data;
+		folded_label = g_ascii_strdown(n->label->str, -1);
+		if (strstr(folded_label, folded_pattern))
+			sum += n->total_mem_B;
+		else if (max_depth < 0 || depth < max_depth)
+			sum += sum_matching(child, folded_pattern, depth+1, max_depth);
+		g_free(folded_label);
+	}
+	return sum;
+}
+
+/* Check a query against sum_matching() for every snapshot in the time range */
+static void
+check_query(MassifgQuery *query, MassifgOutputData *data, gint64 time_start, gint64 time_end,
+		const gchar *pattern, gint max_depth) {
+	MassifgQuerySeries *series = massifg_query_series(query, time_start, time_end, pattern, max_depth);
+	MassifgSnapshot *s = NULL;
+	GNode *heap_tree = NULL;
+	gchar *folded_pattern = g_ascii_strdown(pattern ? pattern : "", -1);
+	GList *l = NULL;
+	gint64 total = 0;
+	guint num_snapshots = 0, i = 0;
+
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (!massifg_snapshot_has_heap_tree(s) || s->time < time_start || s->time > time_end)
+			continue;
+
+		heap_tree = massifg_output_data_get_heap_tree(data, s);
+		g_assert_cmpuint(i, <, series->num_snapshots);
+		g_assert_cmpint(series->snapshot_nos[i], ==, s->snapshot_no);
+		g_assert_cmpint(series->times[i], ==, s->time);
+		g_assert_cmpint(series->values[i], ==, sum_matching(heap_tree, folded_pattern, 1, max_depth));
+		massifg_output_data_release_heap_tree(data, s);
+		total += series->values[i];
+		i++;
+	}
+	g_assert_cmpuint(i, ==, series->num_snapshots);
+
+	g_assert_cmpint(massifg_query_total(query, time_start, time_end, pattern, max_depth, &num_snapshots), ==, total);
+	g_assert_cmpuint(num_snapshots, ==, series->num_snapshots);
+
+	g_free(folded_pattern);
+	massifg_query_series_free(series);
+}
+
+void
+query_functest(void) {
+	MassifgOutputData *data;
+	MassifgQuery *query;
+	MassifgSnapshot *s;
+	GList *l;
+	gint64 heap_total = 0;
+	gint64 mid_time;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+	query = massifg_query_new(data);
+	mid_time = data->max_time/2;
+
+	/* All labels at the first level is all of the heap */
+	for (l = data->snapshots; l; l = l->next) {
+		s = (MassifgSnapshot *)l->data;
+		if (s->heap_tree)
+			heap_total += ((MassifgHeapTreeNode *)s->heap_tree->data)->total_mem_B;
+	}
+	g_assert_cmpint(massifg_query_total(query, 0, G_MAXINT64, NULL, 1, NULL), ==, heap_total);
+
+	check_query(query, data, 0, G_MAXINT64, NULL, 1);
+	g_assert_cmpint(massifg_query_total(query, 0, G_MAXINT64, "gmem.c", -1, NULL), >, 0);
+	check_query(query, data, 0, G_MAXINT64, "gmem.c", -1);
+	check_query(query, data, 0, G_MAXINT64, "gmem.c", 2);
+	check_query(query, data, 0, mid_time, "GMEM.C", -1);
+	check_query(query, data, mid_time, G_MAXINT64, "Glib::ustring", 3);
+	check_query(query, data, mid_time, mid_time, "gmem.c", -1);
+	check_query(query, data, 0, G_MAXINT64, "g", -1);
+	check_query(query, data, 0, G_MAXINT64, "not there", -1);
+
+	/* An empty time range */
+	g_assert_cmpint(massifg_query_total(query, mid_time+1, mid_time, "gmem.c", -1, NULL), ==, 0);
+
+	massifg_query_free(query);
+	massifg_output_data_unref(data);
+}
+
+/* With a memory budget every tree is spilled as soon as it is released,
+ * and the results are the same as without one */
+void
+query_memory_budget(void) {
+	MassifgOutputData *data;
+	MassifgQuery *query;
+	gint64 mid_time;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	massifg_parser_set_default_memory_budget(1);
+	data = massifg_parse_file(path, NULL);
+	massifg_parser_set_default_memory_budget(0);
+	g_free(path);
+	query = massifg_query_new(data);
+	mid_time = data->max_time/2;
+
+	check_query(query, data, 0, G_MAXINT64, NULL, 1);
+	check_query(query, data, 0, G_MAXINT64, NULL, -1);
+	check_query(query, data, 0, G_MAXINT64, "gmem.c", -1);
+	check_query(query, data, 0, G_MAXINT64, "gmem.c", 2);
+	check_query(query, data, 0, mid_time, "GMEM.C", -1);
+	check_query(query, data, mid_time, G_MAXINT64, "Glib::ustring", 3);
+	check_query(query, data, 0, G_MAXINT64, "g", -1);
+	check_query(query, data, 0, G_MAXINT64, "a", -1);
+
+	massifg_query_free(query);
+	massifg_output_data_unref(data);
+}
+
+void
+query_perf(void) {
+	MassifgOutputData *data;
+	MassifgQuery *query;
+	gdouble elapsed;
+	gint64 total;
+	guint i;
+
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	data = massifg_parse_file(path, NULL);
+	g_free(path);
+	query = massifg_query_new(data);
+
+	g_test_timer_start();
+	massifg_query_total(query, 0, G_MAXINT64, "ustring", -1, NULL);
+	elapsed = g_test_timer_elapsed();
+	g_test_message("First query in %.6f s", elapsed);
+
+	/* Repeated queries over different time ranges only use the prefix sums */
+	g_test_timer_start();
+	for (i=0; i<PERF_NUM_QUERIES; i++) {
+		total = massifg_query_total(query, i*data->max_time/PERF_NUM_QUERIES,
+					G_MAXINT64, "ustring", -1, NULL);
+		g_assert_cmpint(total, >=, 0);
+	}
+	elapsed = g_test_timer_elapsed()/PERF_NUM_QUERIES;
+	g_test_minimized_result(elapsed, "Repeated query in %.9f s", elapsed);
+
+	massifg_query_free(query);
+	massifg_output_data_unref(data);
+}
+
+int
+main (int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/query/functest", query_functest);
+	g_test_add_func("/query/memory-budget", query_memory_budget);
+	if (g_test_perf())
+		g_test_add_func("/query/perf", query_perf);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
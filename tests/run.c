@@ -0,0 +1,114 @@
+
+
+#include <glib.h>
+
+#include <massifg_parser.h>
+#include <massifg_run.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* State of a run while the main loop runs */
+typedef struct {
+	GMainLoop *loop;
+	MassifgParser *parser;
+	guint num_pieces;
+	guint num_snapshots;
+} RunTest;
+
+/* Feed what massif has written so far to the parser, as a GIOFunc */
+static gboolean
+run_read_cb(GIOChannel *io_channel, GIOCondition condition, gpointer data) {
+	RunTest *test = (RunTest *)data;
+	MassifgOutputData *output_data = NULL;
+	gchar buffer[4096];
+	gsize bytes_read = 0;
+	GIOStatus io_status;
+
+	do {
+		io_status = g_io_channel_read_chars(io_channel, buffer, sizeof(buffer), &bytes_read, NULL);
+		massifg_parser_feed(test->parser, buffer, bytes_read);
+	} while (io_status == G_IO_STATUS_NORMAL);
+
+	/* Snapshots show up before massif is done */
+	output_data = massifg_parser_get_output_data(test->parser);
+	if (g_list_length(output_data->snapshots) > test->num_snapshots) {
+		test->num_snapshots = g_list_length(output_data->snapshots);
+		test->num_pieces++;
+	}
+
+	if (io_status == G_IO_STATUS_AGAIN) {
+		return TRUE;
+	}
+	g_assert_cmpint(io_status, ==, G_IO_STATUS_EOF);
+	g_main_loop_quit(test->loop);
+	return FALSE;
+}
+
+/* The output of massif is streamed into the parser while it runs */
+void
+run_functest(void) {
+	const gchar *argv[] = {"true", NULL};
+	MassifgOutputData *data, *expected;
+	GIOChannel *io_channel;
+	GError *error = NULL;
+	RunTest test;
+	GPid pid = 0;
+
+	gchar *script = get_test_file("fake-massif.sh");
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	g_setenv("MASSIFG_VALGRIND", script, TRUE);
+
+	io_channel = massifg_run_spawn(argv, &pid, &error);
+	g_assert_no_error(error);
+	g_assert(io_channel != NULL);
+	g_assert_cmpint(pid, >, 0);
+
+	test.loop = g_main_loop_new(NULL, FALSE);
+	test.parser = massifg_parser_new(NULL);
+	test.num_pieces = 0;
+	test.num_snapshots = 0;
+	g_io_add_watch(io_channel, G_IO_IN | G_IO_HUP, run_read_cb, &test);
+	g_main_loop_run(test.loop);
+
+	g_assert_cmpuint(test.num_pieces, >, 1);
+	data = massifg_parser_finish(test.parser, NULL);
+	expected = massifg_parse_file(path, NULL);
+	g_assert(data != NULL);
+	g_assert_cmpuint(g_list_length(data->snapshots), ==, g_list_length(expected->snapshots));
+	g_assert_cmpint(data->max_time, ==, expected->max_time);
+	g_assert_cmpint(data->max_mem_allocation, ==, expected->max_mem_allocation);
+
+	massifg_output_data_unref(data);
+	massifg_output_data_unref(expected);
+	massifg_parser_free(test.parser);
+	g_io_channel_unref(io_channel);
+	g_main_loop_unref(test.loop);
+	g_unsetenv("MASSIFG_VALGRIND");
+	g_free(script);
+	g_free(path);
+}
+
+/* Failing to start valgrind is reported */
+void
+run_spawn_failure(void) {
+	const gchar *argv[] = {"true", NULL};
+	GError *error = NULL;
+
+	g_setenv("MASSIFG_VALGRIND", "massifg-no-such-valgrind", TRUE);
+	g_assert(massifg_run_spawn(argv, NULL, &error) == NULL);
+	g_assert(error != NULL);
+	g_error_free(error);
+	g_unsetenv("MASSIFG_VALGRIND");
+}
+
+int
+main (int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/run/functest", run_functest);
+	g_test_add_func("/run/spawn-failure", run_spawn_failure);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
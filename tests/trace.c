@@ -0,0 +1,100 @@
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <massifg_parser.h>
+#include <massifg_analysis.h>
+#include <massifg_trace.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+#define TRACE_OUTPUT_PATH "tests/trace-output.json"
+
+/* Count the complete events with the given name in a trace */
+static guint
+count_events(const gchar *trace, const gchar *name) {
+	gchar *needle = g_strdup_printf("{\"name\":\"%s\",", name);
+	const gchar *event = trace;
+	guint count = 0;
+
+	while ((event = strstr(event, needle))) {
+		count++;
+		event++;
+	}
+	g_free(needle);
+	return count;
+}
+
+/* Tests */
+
+/* Parse a file and build the detailed table while tracing,
+ * and check that each phase wrote its spans */
+void
+trace_spans(void) {
+	gchar *path = get_test_file(TEST_INPUT_LONG);
+	MassifgOutputData *data = NULL;
+	MassifgGroupedUsage *usage = NULL;
+	gchar *trace = NULL;
+	guint num_trees = 0;
+	GList *l = NULL;
+
+	g_assert(massifg_trace_start(TRACE_OUTPUT_PATH, NULL));
+	g_assert(massifg_trace_enabled);
+	data = massifg_parse_file(path, NULL);
+	usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	massifg_trace_stop();
+	g_assert(!massifg_trace_enabled);
+
+	g_assert(g_file_get_contents(TRACE_OUTPUT_PATH, &trace, NULL, NULL));
+	g_assert(g_str_has_prefix(trace, "[\n{"));
+	g_assert(g_str_has_suffix(trace, "}\n]\n"));
+
+	for (l = data->snapshots; l; l = l->next) {
+		if (((MassifgSnapshot *)l->data)->heap_tree)
+			num_trees++;
+	}
+	g_assert_cmpuint(num_trees, >, 0);
+	g_assert_cmpuint(count_events(trace, "heap-tree"), ==, num_trees);
+	g_assert_cmpuint(count_events(trace, "open"), ==, 1);
+	g_assert_cmpuint(count_events(trace, "parse"), ==, 1);
+	g_assert_cmpuint(count_events(trace, "parse-finish"), ==, 1);
+	g_assert_cmpuint(count_events(trace, "detailed-table"), ==, 1);
+	g_free(trace);
+
+	/* Nothing is written once tracing has stopped */
+	massifg_analysis_grouped_usage_free(usage);
+	usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	g_assert(g_file_get_contents(TRACE_OUTPUT_PATH, &trace, NULL, NULL));
+	g_assert_cmpuint(count_events(trace, "detailed-table"), ==, 1);
+	g_free(trace);
+
+	g_unlink(TRACE_OUTPUT_PATH);
+	massifg_analysis_grouped_usage_free(usage);
+	massifg_output_data_unref(data);
+	g_free(path);
+}
+
+/* A trace file that can not be written is an error, and tracing stays disabled */
+void
+trace_start_error(void) {
+	GError *error = NULL;
+
+	g_assert(!massifg_trace_start("tests/no-such-directory/trace.json", &error));
+	g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+	g_assert(!massifg_trace_enabled);
+	g_error_free(error);
+}
+
+int
+main (int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/trace/spans", trace_spans);
+	g_test_add_func("/trace/start-error", trace_start_error);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}
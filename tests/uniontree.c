@@ -0,0 +1,252 @@
+
+#include <glib.h>
+
+#include <massifg_parser.h>
+#include <massifg_analysis.h>
+#include <massifg_union_tree.h>
+#include <massifg_utils.h>
+
+#include "common.h"
+
+/* Small enough that most heap trees of the test input are spilled */
+#define MEMORY_BUDGET_B (64*1024)
+
+/* Parse a test file, with or without the union tree */
+static MassifgOutputData *
+parse_test_file(const gchar *filename, gboolean union_tree, gsize budget_B) {
+	gchar *path = get_test_file(filename);
+	MassifgOutputData *data = NULL;
+
+	massifg_parser_set_default_build_union_tree(union_tree);
+	massifg_parser_set_default_memory_budget(budget_B);
+	data = massifg_parse_file(path, NULL);
+	massifg_parser_set_default_build_union_tree(FALSE);
+	massifg_parser_set_default_memory_budget(0);
+
+	g_assert(data != NULL);
+	g_free(path);
+	return data;
+}
+
+/* Check that the children of union_node have the values of the children of
+ * heap_node in snapshot i, summing children with the same label */
+static void
+check_children(GNode *union_node, GNode *heap_node, guint i) {
+	GHashTable *sums = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	GHashTable *counts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	MassifgHeapTreeNode *n = NULL;
+	GNode *union_child = NULL;
+	GNode *child = NULL;
+	gpointer key;
+	gint64 *sum = NULL;
+	guint count;
+
+	for (child = heap_node->children; child; child = child->next) {
+		n = (MassifgHeapTreeNode *)child->data;
+		key = GUINT_TO_POINTER(n->label_id);
+		sum = (gint64 *)g_hash_table_lookup(sums, key);
+		if (!sum) {
+			sum = g_new0(gint64, 1);
+			g_hash_table_insert(sums, key, sum);
+		}
+		*sum += n->total_mem_B;
+		count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, key));
+		g_hash_table_insert(counts, key, GUINT_TO_POINTER(count+1));
+	}
+
+	for (child = heap_node->children; child; child = child->next) {
+		n = (MassifgHeapTreeNode *)child->data;
+		key = GUINT_TO_POINTER(n->label_id);
+		union_child = massifg_union_node_find_child(union_node, n->label_id);
+		g_assert(union_child != NULL);
+		g_assert_cmpint(massifg_union_node_get_value((MassifgUnionNode *)union_child->data, i), ==,
+				*(gint64 *)g_hash_table_lookup(sums, key));
+
+		/* The children of siblings with the same label are merged too */
+		if (GPOINTER_TO_UINT(g_hash_table_lookup(counts, key)) == 1)
+			check_children(union_child, child, i);
+	}
+
+	g_hash_table_destroy(counts);
+	g_hash_table_destroy(sums);
+}
+
+/* Check that the values of a union node are in the order of the snapshots,
+ * and count them. Used as a GNodeTraverseFunc */
+static gboolean
+check_column(GNode *node, gpointer user_data) {
+	MassifgUnionNode *n = (MassifgUnionNode *)node->data;
+	guint64 *num_values = (guint64 *)user_data;
+	guint i;
+
+	g_assert_cmpuint(n->num_values, >, 0);
+	for (i=1; i<n->num_values; i++) {
+		g_assert_cmpuint(n->snapshots[i-1], <, n->snapshots[i]);
+	}
+	*num_values += n->num_values;
+	return FALSE;
+}
+
+/* Check the grouped usage computed from the union tree against the heap trees */
+static void
+check_group_usage(MassifgOutputData *trees_data, MassifgOutputData *union_data,
+		MassifgGroupBy group_by, const gboolean *label_mask) {
+	MassifgGroupedUsage *expected = massifg_analysis_group_usage(trees_data, group_by, label_mask);
+	MassifgGroupedUsage *usage = massifg_analysis_group_usage(union_data, group_by, label_mask);
+	gdouble *expected_values = NULL;
+	gdouble *values = NULL;
+	guint i, j;
+
+	g_assert_cmpuint(usage->num_snapshots, ==, expected->num_snapshots);
+	g_assert_cmpuint(usage->names->len, ==, expected->names->len);
+	for (i=0; i<usage->names->len; i++) {
+		g_assert_cmpstr(g_ptr_array_index(usage->names, i), ==, g_ptr_array_index(expected->names, i));
+		expected_values = (gdouble *)g_ptr_array_index(expected->series, i);
+		values = (gdouble *)g_ptr_array_index(usage->series, i);
+		for (j=0; j<usage->num_snapshots; j++) {
+			g_assert_cmpfloat(values[j], ==, expected_values[j]);
+		}
+	}
+
+	massifg_analysis_grouped_usage_free(usage);
+	massifg_analysis_grouped_usage_free(expected);
+}
+
+/* Tests */
+
+/* The column of every call path has its memory usage in every snapshot */
+void
+union_tree_columns(void) {
+	MassifgOutputData *data = parse_test_file(TEST_INPUT_LONG, TRUE, 0);
+	MassifgUnionTree *tree = data->union_tree;
+	MassifgUnionNode *root = NULL;
+	MassifgSnapshot *s = NULL;
+	MassifgMemoryStats stats;
+	guint num_snapshots = g_list_length(data->snapshots);
+	gdouble *series = g_new(gdouble, num_snapshots);
+	guint64 num_values = 0;
+	GList *l = NULL;
+	guint i;
+
+	g_assert(tree != NULL);
+	g_assert(tree->root != NULL);
+	root = (MassifgUnionNode *)tree->root->data;
+	massifg_union_node_get_series(root, series, num_snapshots);
+
+	for (l = data->snapshots, i = 0; l; l = l->next, i++) {
+		s = (MassifgSnapshot *)l->data;
+		if (!s->heap_tree) {
+			g_assert_cmpint(massifg_union_node_get_value(root, i), ==, 0);
+			g_assert_cmpfloat(series[i], ==, 0);
+			continue;
+		}
+		g_assert_cmpint(massifg_union_node_get_value(root, i), ==,
+				((MassifgHeapTreeNode *)s->heap_tree->data)->total_mem_B);
+		g_assert_cmpfloat(series[i], ==, ((MassifgHeapTreeNode *)s->heap_tree->data)->total_mem_B);
+		check_children(tree->root, s->heap_tree, i);
+	}
+
+	/* There is at most one value for each node in the heap trees */
+	g_node_traverse(tree->root, G_PRE_ORDER, G_TRAVERSE_ALL, -1, check_column, &num_values);
+	g_assert_cmpuint(num_values, ==, tree->num_values);
+	g_assert_cmpuint(g_node_n_nodes(tree->root, G_TRAVERSE_ALL), ==, tree->num_nodes);
+
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_assert_cmpuint(num_values, <=, stats.num_node_refs);
+	g_assert_cmpuint(stats.num_union_nodes, ==, tree->num_nodes);
+	g_assert_cmpuint(stats.union_tree_B, >=, num_values*(sizeof(guint) + sizeof(gint64)));
+	g_assert_cmpuint(stats.total_B, ==, stats.snapshots_B + stats.nodes_B + stats.links_B
+			+ stats.labels_B + stats.union_tree_B);
+
+	g_free(series);
+	massifg_output_data_unref(data);
+}
+
+/* The union tree is only built when asked for */
+void
+union_tree_optional(void) {
+	MassifgOutputData *data = parse_test_file(TEST_INPUT_LONG, FALSE, 0);
+	MassifgMemoryStats stats;
+
+	g_assert(data->union_tree == NULL);
+	massifg_output_data_get_memory_stats(data, &stats);
+	g_assert_cmpuint(stats.num_union_nodes, ==, 0);
+	g_assert_cmpuint(stats.union_tree_B, ==, 0);
+
+	massifg_output_data_unref(data);
+}
+
+/* The detailed table is the same when it is summed from the union tree */
+void
+union_tree_group_usage(void) {
+	MassifgOutputData *trees_data = parse_test_file(TEST_INPUT_LONG, FALSE, 0);
+	MassifgOutputData *union_data = parse_test_file(TEST_INPUT_LONG, TRUE, 0);
+	guint num_labels = massifg_label_table_size(union_data->labels);
+	gboolean *label_mask = g_new(gboolean, num_labels);
+	MassifgGroupBy group_by;
+	guint i;
+
+	for (i=0; i<num_labels; i++) {
+		label_mask[i] = i % 2;
+	}
+	for (group_by=0; group_by<MASSIFG_GROUP_BY_LAST; group_by++) {
+		check_group_usage(trees_data, union_data, group_by, NULL);
+		check_group_usage(trees_data, union_data, group_by, label_mask);
+	}
+
+	g_free(label_mask);
+	massifg_output_data_unref(union_data);
+	massifg_output_data_unref(trees_data);
+}
+
+/* With a memory budget the union tree is complete, and the detailed table
+ * does not read the spilled heap trees back */
+void
+union_tree_memory_budget(void) {
+	MassifgOutputData *trees_data = parse_test_file(TEST_INPUT_LONG, FALSE, 0);
+	MassifgOutputData *union_data = parse_test_file(TEST_INPUT_LONG, TRUE, 0);
+	MassifgOutputData *data = parse_test_file(TEST_INPUT_LONG, TRUE, MEMORY_BUDGET_B);
+	MassifgMemoryStats before, after;
+
+	g_assert_cmpuint(data->union_tree->num_nodes, ==, union_data->union_tree->num_nodes);
+	g_assert_cmpuint(data->union_tree->num_values, ==, union_data->union_tree->num_values);
+
+	massifg_output_data_get_memory_stats(data, &before);
+	g_assert_cmpuint(before.num_spilled_trees, >, 0);
+	check_group_usage(trees_data, data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	massifg_output_data_get_memory_stats(data, &after);
+	g_assert_cmpuint(after.num_spilled_trees, ==, before.num_spilled_trees);
+
+	massifg_output_data_unref(data);
+	massifg_output_data_unref(union_data);
+	massifg_output_data_unref(trees_data);
+}
+
+/* Data whose union tree has no heap trees in it has no groups */
+void
+union_tree_empty(void) {
+	MassifgOutputData *data = parse_test_file(TEST_INPUT_SHORT, TRUE, 0);
+	MassifgGroupedUsage *usage = NULL;
+
+	massifg_union_tree_free(data->union_tree);
+	data->union_tree = massifg_union_tree_new();
+	usage = massifg_analysis_group_usage(data, MASSIFG_GROUP_BY_FUNCTION, NULL);
+	g_assert_cmpuint(usage->names->len, ==, 0);
+
+	massifg_analysis_grouped_usage_free(usage);
+	massifg_output_data_unref(data);
+}
+
+int
+main (int argc, char **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/union-tree/columns", union_tree_columns);
+	g_test_add_func("/union-tree/optional", union_tree_optional);
+	g_test_add_func("/union-tree/group-usage", union_tree_group_usage);
+	g_test_add_func("/union-tree/memory-budget", union_tree_memory_budget);
+	g_test_add_func("/union-tree/empty", union_tree_empty);
+
+	massifg_utils_configure_debug_output();
+	return g_test_run();
+}